@@ -0,0 +1,246 @@
+#include "AABBTree.h"
+
+AABBTree::AABBTree(float margin)
+    : m_margin(margin)
+{
+
+}
+
+int AABBTree::allocateNode()
+{
+    if (m_freeList == Null)
+    {
+        m_nodes.push_back(Node());
+        return (int)m_nodes.size() - 1;
+    }
+
+    int node    = m_freeList;
+    m_freeList  = m_nodes[node].parent;
+    m_nodes[node] = Node();
+    return node;
+}
+
+void AABBTree::freeNode(int node)
+{
+    m_nodes[node].parent    = m_freeList;
+    m_nodes[node].height    = -1;
+    m_nodes[node].entity    = nullptr;
+    m_freeList              = node;
+}
+
+int AABBTree::insert(const AABB & box, Entity * entity)
+{
+    int leaf = allocateNode();
+    m_nodes[leaf].box       = AABB(box.min - Vec2(m_margin, m_margin), box.max + Vec2(m_margin, m_margin));
+    m_nodes[leaf].entity    = entity;
+    m_nodes[leaf].height    = 0;
+
+    insertLeaf(leaf);
+    m_leaves++;
+    return leaf;
+}
+
+void AABBTree::remove(int proxy)
+{
+    assert(proxy >= 0 && proxy < (int)m_nodes.size() && m_nodes[proxy].isLeaf());
+    removeLeaf(proxy);
+    freeNode(proxy);
+    m_leaves--;
+}
+
+bool AABBTree::move(int proxy, const AABB & box)
+{
+    // still inside the fat box, nothing to do
+    if (m_nodes[proxy].box.contains(box)) { return false; }
+
+    removeLeaf(proxy);
+    m_nodes[proxy].box = AABB(box.min - Vec2(m_margin, m_margin), box.max + Vec2(m_margin, m_margin));
+    insertLeaf(proxy);
+    return true;
+}
+
+void AABBTree::clear()
+{
+    m_nodes.clear();
+    m_root      = Null;
+    m_freeList  = Null;
+    m_leaves    = 0;
+}
+
+size_t AABBTree::size() const
+{
+    return m_leaves;
+}
+
+int AABBTree::height() const
+{
+    return m_root == Null ? 0 : m_nodes[m_root].height;
+}
+
+void AABBTree::insertLeaf(int leaf)
+{
+    if (m_root == Null)
+    {
+        m_root = leaf;
+        m_nodes[leaf].parent = Null;
+        return;
+    }
+
+    // descend to the sibling that grows the total perimeter the least
+    AABB leafBox = m_nodes[leaf].box;
+    int  index   = m_root;
+    while (!m_nodes[index].isLeaf())
+    {
+        int   left      = m_nodes[index].left;
+        int   right     = m_nodes[index].right;
+        float perimeter = m_nodes[index].box.perimeter();
+        float combined  = AABB::Union(m_nodes[index].box, leafBox).perimeter();
+
+        // cost of making a new parent here, and the inherited cost of pushing further down
+        float cost          = 2.0f * combined;
+        float inherited     = 2.0f * (combined - perimeter);
+
+        auto descendCost = [&](int child)
+        {
+            float grown = AABB::Union(leafBox, m_nodes[child].box).perimeter();
+            return m_nodes[child].isLeaf() ? grown + inherited : (grown - m_nodes[child].box.perimeter()) + inherited;
+        };
+
+        float costLeft  = descendCost(left);
+        float costRight = descendCost(right);
+
+        if (cost < costLeft && cost < costRight) { break; }
+        index = costLeft < costRight ? left : right;
+    }
+
+    // replace the sibling with a new parent holding both
+    int sibling     = index;
+    int oldParent   = m_nodes[sibling].parent;
+    int newParent   = allocateNode();
+    m_nodes[newParent].parent   = oldParent;
+    m_nodes[newParent].box      = AABB::Union(leafBox, m_nodes[sibling].box);
+    m_nodes[newParent].height   = m_nodes[sibling].height + 1;
+    m_nodes[newParent].left     = sibling;
+    m_nodes[newParent].right    = leaf;
+    m_nodes[sibling].parent     = newParent;
+    m_nodes[leaf].parent        = newParent;
+
+    if (oldParent == Null)
+    {
+        m_root = newParent;
+    }
+    else if (m_nodes[oldParent].left == sibling)
+    {
+        m_nodes[oldParent].left = newParent;
+    }
+    else
+    {
+        m_nodes[oldParent].right = newParent;
+    }
+
+    // walk back up refitting boxes and rebalancing
+    for (index = m_nodes[leaf].parent; index != Null; index = m_nodes[index].parent)
+    {
+        index = balance(index);
+
+        int left = m_nodes[index].left;
+        int right = m_nodes[index].right;
+        m_nodes[index].height   = 1 + std::max(m_nodes[left].height, m_nodes[right].height);
+        m_nodes[index].box      = AABB::Union(m_nodes[left].box, m_nodes[right].box);
+    }
+}
+
+void AABBTree::removeLeaf(int leaf)
+{
+    if (leaf == m_root)
+    {
+        m_root = Null;
+        return;
+    }
+
+    int parent      = m_nodes[leaf].parent;
+    int grandParent = m_nodes[parent].parent;
+    int sibling     = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+    if (grandParent == Null)
+    {
+        m_root = sibling;
+        m_nodes[sibling].parent = Null;
+        freeNode(parent);
+        return;
+    }
+
+    // splice the sibling into the parent's place
+    if (m_nodes[grandParent].left == parent)
+    {
+        m_nodes[grandParent].left = sibling;
+    }
+    else
+    {
+        m_nodes[grandParent].right = sibling;
+    }
+    m_nodes[sibling].parent = grandParent;
+    freeNode(parent);
+
+    for (int index = grandParent; index != Null; index = m_nodes[index].parent)
+    {
+        index = balance(index);
+
+        int left = m_nodes[index].left;
+        int right = m_nodes[index].right;
+        m_nodes[index].box      = AABB::Union(m_nodes[left].box, m_nodes[right].box);
+        m_nodes[index].height   = 1 + std::max(m_nodes[left].height, m_nodes[right].height);
+    }
+}
+
+// rotate node a up or down if its subtrees differ in height by more than one
+// returns the index of the node that now sits where a was
+int AABBTree::balance(int a)
+{
+    Node & A = m_nodes[a];
+    if (A.isLeaf() || A.height < 2) { return a; }
+
+    int b = A.left;
+    int c = A.right;
+    int heightDiff = m_nodes[c].height - m_nodes[b].height;
+
+    // rotate c up, or b up, mirroring each other
+    auto rotate = [this, a](int up, int other, bool upIsRight)
+    {
+        Node & A = m_nodes[a];
+        Node & U = m_nodes[up];
+        int f = U.left;
+        int g = U.right;
+
+        U.left      = a;
+        U.parent    = A.parent;
+        A.parent    = up;
+
+        if (U.parent != Null)
+        {
+            if (m_nodes[U.parent].left == a) { m_nodes[U.parent].left = up; }
+            else                             { m_nodes[U.parent].right = up; }
+        }
+        else
+        {
+            m_root = up;
+        }
+
+        // keep the taller grandchild under the rotated node
+        int keep    = m_nodes[f].height > m_nodes[g].height ? f : g;
+        int give    = keep == f ? g : f;
+        U.right     = keep;
+        if (upIsRight) { A.right = give; } else { A.left = give; }
+        m_nodes[give].parent = a;
+
+        A.box       = AABB::Union(m_nodes[other].box, m_nodes[give].box);
+        U.box       = AABB::Union(A.box, m_nodes[keep].box);
+        A.height    = 1 + std::max(m_nodes[other].height, m_nodes[give].height);
+        U.height    = 1 + std::max(A.height, m_nodes[keep].height);
+        return up;
+    };
+
+    if (heightDiff > 1)  { return rotate(c, b, true); }
+    if (heightDiff < -1) { return rotate(b, c, false); }
+    return a;
+}
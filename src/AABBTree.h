@@ -0,0 +1,130 @@
+#pragma once
+
+#include "Common.h"
+#include <cassert>
+
+class Entity;
+
+struct AABB
+{
+    Vec2 min;
+    Vec2 max;
+
+    AABB() {}
+    AABB(const Vec2 & mn, const Vec2 & mx) : min(mn), max(mx) {}
+
+    static AABB FromCenter(const Vec2 & center, const Vec2 & halfSize)
+    {
+        return AABB(center - halfSize, center + halfSize);
+    }
+
+    static AABB Union(const AABB & a, const AABB & b)
+    {
+        return AABB(Vec2(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y)),
+                    Vec2(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y)));
+    }
+
+    bool overlaps(const AABB & rhs) const
+    {
+        return min.x < rhs.max.x && rhs.min.x < max.x && min.y < rhs.max.y && rhs.min.y < max.y;
+    }
+
+    bool contains(const AABB & rhs) const
+    {
+        return min.x <= rhs.min.x && min.y <= rhs.min.y && rhs.max.x <= max.x && rhs.max.y <= max.y;
+    }
+
+    float perimeter() const
+    {
+        return 2.0f * ((max.x - min.x) + (max.y - min.y));
+    }
+};
+
+// Dynamic AABB tree (bounding volume hierarchy) over entities.
+// Leaves store a box fattened by a margin, so small moves do not touch the tree at
+// all and larger ones remove and reinsert a single leaf. Internal nodes are kept
+// balanced with AVL-style rotations, so queries stay O(log n + k) however unevenly
+// entities are spread over the world.
+class AABBTree
+{
+    static const int Null = -1;
+
+    struct Node
+    {
+        AABB        box;
+        Entity *    entity  = nullptr;
+        int         parent  = Null;     // doubles as the next pointer while on the free list
+        int         left    = Null;
+        int         right   = Null;
+        int         height  = -1;       // leaves are 0, free nodes -1
+
+        bool isLeaf() const { return left == Null; }
+    };
+
+    std::vector<Node>   m_nodes;
+    int                 m_root      = Null;
+    int                 m_freeList  = Null;
+    size_t              m_leaves    = 0;
+    float               m_margin    = 8.0f;
+
+    int  allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    int  balance(int node);
+
+public:
+
+    AABBTree(float margin = 8.0f);
+
+    // returns the proxy id used to move or remove the entity later
+    int  insert(const AABB & box, Entity * entity);
+    void remove(int proxy);
+
+    // update a proxy's box, returns true if the leaf had to be reinserted
+    bool move(int proxy, const AABB & box);
+
+    void clear();
+
+    size_t  size()      const;
+    int     height()    const;
+
+    const AABB & fatBox(int proxy) const { return m_nodes[proxy].box; }
+
+    // calls callback(Entity *) for every leaf whose fat box overlaps the query box
+    // the callback returns false to stop the query early
+    template <typename F>
+    void query(const AABB & box, F callback) const
+    {
+        // a balanced tree never comes near the local stack, a deeper one spills to the heap
+        int                 local[256];
+        std::vector<int>    spill;
+        int *               stack       = local;
+        size_t              capacity    = 256;
+        size_t              top         = 0;
+        if (m_root != Null) { stack[top++] = m_root; }
+
+        while (top > 0)
+        {
+            const Node & node = m_nodes[stack[--top]];
+            if (!node.box.overlaps(box)) { continue; }
+
+            if (node.isLeaf())
+            {
+                if (!callback(node.entity)) { return; }
+            }
+            else
+            {
+                if (top + 2 > capacity)
+                {
+                    if (stack == local) { spill.assign(local, local + top); }
+                    spill.resize(capacity * 2);
+                    stack       = spill.data();
+                    capacity    = spill.size();
+                }
+                stack[top++] = node.left;
+                stack[top++] = node.right;
+            }
+        }
+    }
+};
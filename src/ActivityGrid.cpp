@@ -0,0 +1,152 @@
+#include "ActivityGrid.h"
+#include "Components.h"
+#include <algorithm>
+#include <math.h>
+
+ActivityGrid::Room ActivityGrid::roomOf(const Vec2 & pos) const
+{
+    return Room((int)floor(pos.x / m_roomSize.x), (int)floor(pos.y / m_roomSize.y));
+}
+
+bool ActivityGrid::nearPlayer(const Room & room) const
+{
+    return !m_enabled || (abs(room.first - m_playerRoom.first) <= 1 && abs(room.second - m_playerRoom.second) <= 1);
+}
+
+void ActivityGrid::move(Entity * entity, const Room & to)
+{
+    auto & activity = entity->get<CActivity>();
+    auto & bucket   = m_rooms[Room(activity.roomX, activity.roomY)];
+    bucket.erase(std::find(bucket.begin(), bucket.end(), entity));
+
+    activity.roomX = to.first;
+    activity.roomY = to.second;
+    m_rooms[to].push_back(entity);
+}
+
+void ActivityGrid::sleep(Entity * entity)
+{
+    entity->get<CActivity>().level = Activity::Asleep;
+    entity->get<CTransform>().stop();
+    m_stats.slept++;
+}
+
+void ActivityGrid::reset(const Vec2 & roomSize)
+{
+    m_roomSize  = roomSize;
+    m_tick      = 0;
+    m_tracked   = 0;
+    m_rooms.clear();
+    m_active.clear();
+    m_stats     = ActivityStats();
+}
+
+void ActivityGrid::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+void ActivityGrid::insert(Entity * entity)
+{
+    auto & activity = entity->get<CActivity>();
+    auto room       = roomOf(entity->get<CTransform>().pos());
+
+    // new NPCs start asleep and are woken by the next update if they are near the player
+    activity.level      = Activity::Asleep;
+    activity.roomX      = room.first;
+    activity.roomY      = room.second;
+    activity.tracked    = true;
+    entity->get<CTransform>().stop();
+    m_rooms[room].push_back(entity);
+    m_tracked++;
+}
+
+void ActivityGrid::remove(Entity * entity)
+{
+    auto & activity = entity->get<CActivity>();
+    if (!activity.tracked) { return; }
+
+    auto & bucket = m_rooms[Room(activity.roomX, activity.roomY)];
+    bucket.erase(std::find(bucket.begin(), bucket.end(), entity));
+    activity.tracked = false;
+    m_tracked--;
+}
+
+void ActivityGrid::update(const Vec2 & playerPos)
+{
+    m_tick++;
+    m_stats.woken = 0;
+    m_stats.slept = 0;
+
+    // only NPCs that were active can have moved, removed ones are skipped
+    for (auto entity : m_active)
+    {
+        if (!entity->isActive()) { continue; }
+
+        auto & activity = entity->get<CActivity>();
+        auto room = roomOf(entity->get<CTransform>().pos());
+        if (room != Room(activity.roomX, activity.roomY)) { move(entity, room); }
+    }
+
+    // NPCs that are no longer in a room around the player fall asleep
+    m_playerRoom = roomOf(playerPos);
+    for (auto entity : m_active)
+    {
+        auto & activity = entity->get<CActivity>();
+        if (entity->isActive() && !nearPlayer(Room(activity.roomX, activity.roomY))) { sleep(entity); }
+    }
+
+    // gather the rooms around the player, in room order, and wake what sleeps there
+    m_active.clear();
+    auto visit = [&](const Room & room, std::vector<Entity *> & bucket)
+    {
+        auto level = room == m_playerRoom || !m_enabled ? Activity::Awake : Activity::Reduced;
+        for (auto entity : bucket)
+        {
+            auto & activity = entity->get<CActivity>();
+            if (activity.level == Activity::Asleep) { m_stats.woken++; }
+            activity.level = level;
+            m_active.push_back(entity);
+        }
+    };
+
+    if (m_enabled)
+    {
+        for (int y = m_playerRoom.second - 1; y <= m_playerRoom.second + 1; y++)
+        {
+            for (int x = m_playerRoom.first - 1; x <= m_playerRoom.first + 1; x++)
+            {
+                auto bucket = m_rooms.find(Room(x, y));
+                if (bucket != m_rooms.end()) { visit(bucket->first, bucket->second); }
+            }
+        }
+    }
+    else
+    {
+        for (auto & bucket : m_rooms) { visit(bucket.first, bucket.second); }
+    }
+
+    m_stats.awake   = 0;
+    m_stats.reduced = 0;
+    for (auto entity : m_active)
+    {
+        entity->get<CActivity>().level == Activity::Awake ? m_stats.awake++ : m_stats.reduced++;
+    }
+    m_stats.asleep = m_tracked - m_active.size();
+}
+
+bool ActivityGrid::thinks(const Entity & entity) const
+{
+    auto level = entity.get<CActivity>().level;
+    return level == Activity::Awake || (level == Activity::Reduced && (m_tick + entity.id()) % ReducedInterval == 0);
+}
+
+const std::vector<Entity *> & ActivityGrid::active() const
+{
+    return m_active;
+}
+
+const ActivityStats & ActivityGrid::getStats() const
+{
+    return m_stats;
+}
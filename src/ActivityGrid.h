@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Common.h"
+#include "Entity.h"
+#include <map>
+
+struct ActivityStats
+{
+    size_t awake    = 0;    // NPCs in the player's room, simulated every tick
+    size_t reduced  = 0;    // NPCs in the eight rooms around it, thinking every ReducedInterval ticks
+    size_t asleep   = 0;    // NPCs everywhere else, not visited at all
+    size_t woken    = 0;    // NPCs that woke up during the last update
+    size_t slept    = 0;    // NPCs that fell asleep during the last update
+};
+
+// Level of detail for NPCs by room.
+// NPCs are bucketed by the room they stand in and only the 3x3 rooms around the player
+// are visited each tick: the player's room is awake, the ring around it runs movement and
+// collision every tick but its expensive follow AI at a reduced rate, and every other room
+// sleeps, so the per-tick cost follows the player's surroundings, not the world population.
+// Buckets are visited in room order and the reduced phase comes from the entity id, so the
+// same input wakes and thinks in the same order every run.
+class ActivityGrid
+{
+    typedef std::pair<int, int> Room;
+
+    Vec2                                    m_roomSize      = { 1, 1 };
+    bool                                    m_enabled       = true;
+    Room                                    m_playerRoom;
+    size_t                                  m_tick          = 0;
+    size_t                                  m_tracked       = 0;
+    std::map<Room, std::vector<Entity *>>   m_rooms;
+    std::vector<Entity *>                   m_active;       // awake and reduced NPCs of this tick, in room order
+    ActivityStats                           m_stats;
+
+    Room roomOf(const Vec2 & pos) const;
+    bool nearPlayer(const Room & room) const;
+    void move(Entity * entity, const Room & to);
+    void sleep(Entity * entity);
+
+public:
+
+    static const size_t ReducedInterval = 4;
+
+    // forget every NPC, for a new level
+    void reset(const Vec2 & roomSize);
+
+    // when disabled every NPC is awake, for comparing against the full simulation
+    void setEnabled(bool enabled);
+
+    // entities need a CTransform and a CActivity
+    void insert(Entity * entity);
+    void remove(Entity * entity);
+
+    // moves last tick's active NPCs that walked into another room to its bucket, then
+    // classifies the rooms around the player; NPCs that fall asleep get their speed zeroed
+    // so the transform pool leaves them in place
+    void update(const Vec2 & playerPos);
+
+    // whether the entity runs its expensive AI this tick: always when awake, once every
+    // ReducedInterval ticks when reduced, staggered by id so they do not all think at once
+    bool thinks(const Entity & entity) const;
+
+    // call fn(Entity &, Ts &...) for every live awake or reduced NPC that has all of Ts
+    template <typename... Ts, typename F>
+    void forEach(F && fn)
+    {
+        for (auto entity : m_active)
+        {
+            if (entity->isActive() && entity->hasComponents<Ts...>())
+            {
+                fn(*entity, entity->get<Ts>()...);
+            }
+        }
+    }
+
+    const std::vector<Entity *> &   active() const;
+    const ActivityStats &           getStats() const;
+};
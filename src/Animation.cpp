@@ -47,6 +47,16 @@ const Vec2 & Animation::getSize() const
     return m_size;
 }
 
+size_t Animation::getFrameCount() const
+{
+    return m_frameCount;
+}
+
+size_t Animation::getSpeed() const
+{
+    return m_speed;
+}
+
 const std::string & Animation::getName() const
 {
     return m_name;
@@ -57,6 +67,26 @@ sf::Sprite & Animation::getSprite()
     return m_sprite;
 }
 
+const sf::Sprite & Animation::getSprite() const
+{
+    return m_sprite;
+}
+
+const sf::Texture * Animation::getTexture() const
+{
+    return m_sprite.getTexture();
+}
+
+const std::shared_ptr<const sf::Texture> & Animation::getTextureHandle() const
+{
+    return m_handle;
+}
+
+void Animation::setTextureHandle(const std::shared_ptr<const sf::Texture> & handle)
+{
+    m_handle = handle;
+}
+
 bool Animation::hasEnded() const
 {
     return m_currentFrame + 1 >= m_frameCount * m_speed;
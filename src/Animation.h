@@ -11,6 +11,7 @@ class Animation
     size_t      m_speed         = 0; // the speed to play this animation
     Vec2        m_size          = { 1, 1 }; // size of the animation frame
     std::string m_name = "none";
+    std::shared_ptr<const sf::Texture> m_handle; // keeps the texture resident, shared by every copy
 
 public:
 
@@ -22,5 +23,11 @@ public:
     bool hasEnded() const;
     const std::string & getName() const;
     const Vec2 & getSize() const;
+    size_t getFrameCount() const;
+    size_t getSpeed() const;
     sf::Sprite & getSprite();
+    const sf::Sprite & getSprite() const;
+    const sf::Texture * getTexture() const;
+    const std::shared_ptr<const sf::Texture> & getTextureHandle() const;
+    void setTextureHandle(const std::shared_ptr<const sf::Texture> & handle);
 };
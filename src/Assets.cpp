@@ -7,6 +7,13 @@ Assets::Assets()
 }
 
 void Assets::loadFromFile(const std::string & path)
+{
+    std::set<std::string> textures, animations;
+    m_path = path;
+    readFile(path, textures, animations);
+}
+
+void Assets::readFile(const std::string & path, std::set<std::string> & textures, std::set<std::string> & animations)
 {
     std::ifstream file(path);
     std::string str;
@@ -14,24 +21,46 @@ void Assets::loadFromFile(const std::string & path)
     {
         file >> str;
 
+        // entries identical to what is already loaded are skipped, which only matters on reload
         if (str == "Texture")
         {
             std::string name, path;
             file >> name >> path;
-            addTexture(name, path);
+            auto loaded = m_textureMap.find(name);
+            if (loaded == m_textureMap.end() || loaded->second.path != path)
+            {
+                addTexture(name, path);
+                textures.insert(name);
+            }
         }
         else if (str == "Animation")
         {
-            std::string name, texture;
-            size_t frames, speed;
-            file >> name >> texture >> frames >> speed;
-            addAnimation(name, texture, frames, speed);
+            AnimationDef def;
+            std::string name;
+            file >> name >> def.texture >> def.frameCount >> def.speed;
+            auto loaded = m_animationDefs.find(name);
+            if (loaded == m_animationDefs.end() || loaded->second != def)
+            {
+                addAnimation(name, def.texture, def.frameCount, def.speed);
+                animations.insert(name);
+            }
         }
         else if (str == "Font")
         {
             std::string name, path;
             file >> name >> path;
-            addFont(name, path);
+            auto loaded = m_fontPaths.find(name);
+            if (loaded == m_fontPaths.end() || loaded->second != path)
+            {
+                addFont(name, path);
+            }
+        }
+        else if (str == "Budget")
+        {
+            // texture budget in megabytes, 0 keeps everything resident
+            size_t megabytes = 0;
+            file >> megabytes;
+            setBudget(megabytes * 1024 * 1024);
         }
         else
         {
@@ -40,50 +69,232 @@ void Assets::loadFromFile(const std::string & path)
     }
 }
 
+std::vector<std::string> Assets::reload(const std::vector<std::string> & changedFiles)
+{
+    std::set<std::string> changed(changedFiles.begin(), changedFiles.end());
+    std::set<std::string> textures, animations;
+
+    if (changed.count(m_path))
+    {
+        readFile(m_path, textures, animations);
+    }
+
+    // image and font files edited in place
+    for (auto & texture : m_textureMap)
+    {
+        if (changed.count(texture.second.path) && !textures.count(texture.first))
+        {
+            addTexture(texture.first, texture.second.path, texture.second.smooth);
+            textures.insert(texture.first);
+        }
+    }
+    for (auto & font : m_fontPaths)
+    {
+        if (changed.count(font.second)) { addFont(font.first, font.second); }
+    }
+
+    // frame sizes come from the texture, so animations of a reloaded texture are rebuilt too
+    for (auto & def : m_animationDefs)
+    {
+        if (textures.count(def.second.texture) && !animations.count(def.first))
+        {
+            addAnimation(def.first, def.second.texture, def.second.frameCount, def.second.speed);
+            animations.insert(def.first);
+        }
+    }
+
+    return std::vector<std::string>(animations.begin(), animations.end());
+}
+
+std::vector<std::string> Assets::sourceFiles() const
+{
+    std::vector<std::string> files(1, m_path);
+    for (auto & texture : m_textureMap)     { files.push_back(texture.second.path); }
+    for (auto & font : m_fontPaths)         { files.push_back(font.second); }
+    return files;
+}
+
+bool Assets::loadTexture(TextureEntry & entry) const
+{
+    // decode first so a failed load leaves the texture that sprites already point at untouched
+    sf::Image image;
+    if (!image.loadFromFile(entry.path) || !entry.texture.loadFromImage(image))
+    {
+        std::cerr << "Could not load texture file: " << entry.path << std::endl;
+        return false;
+    }
+    entry.texture.setSmooth(entry.smooth);
+
+    auto size = entry.texture.getSize();
+    if (entry.bytes == 0) { m_stats.residentTextures++; }
+    m_stats.residentBytes = m_stats.residentBytes - entry.bytes + (size_t)size.x * size.y * 4;
+    entry.bytes = (size_t)size.x * size.y * 4;
+    return true;
+}
+
+TextureHandle Assets::acquire(TextureEntry & entry) const
+{
+    if (entry.bytes > 0)
+    {
+        m_stats.hits++;
+    }
+    else if (!m_deferLoads)
+    {
+        m_stats.misses++;
+        loadTexture(entry);
+    }
+    else if (!entry.pending)
+    {
+        // sprites keep pointing at the empty texture until the window thread loads it
+        m_stats.misses++;
+        entry.pending = true;
+        m_pending.push_back(&entry);
+        m_hasPending = true;
+    }
+    entry.lastUse = ++m_useCount;
+
+    // all handles of a texture share one count, made once so acquiring never allocates
+    // the deleter does nothing since the entry owns the texture
+    if (!entry.handle)
+    {
+        entry.handle = TextureHandle(&entry.texture, [](const sf::Texture *) {});
+    }
+    return entry.handle;
+}
+
 void Assets::addTexture(const std::string & textureName, const std::string & path, bool smooth)
 {
-    m_textureMap[textureName] = sf::Texture();
+    bool reload = m_textureMap.find(textureName) != m_textureMap.end();
+    auto & entry = m_textureMap[textureName];
+    auto previousPath = entry.path;
+    entry.path      = path;
+    entry.smooth    = smooth;
 
-    if (!m_textureMap[textureName].loadFromFile(path))
+    if (!loadTexture(entry))
     {
-        std::cerr << "Could not load texture file: " << path << std::endl;
-        m_textureMap.erase(textureName);
+        if (!reload) { m_textureMap.erase(textureName); }
+        else         { entry.path = previousPath; }
+        return;
     }
-    else
+
+    if (!reload)
     {
-        m_textureMap[textureName].setSmooth(smooth);
-        std::cout << "Loaded Texture: " << path << std::endl;
+        m_textureEntries[&entry.texture] = &entry;
+        m_stats.textures++;
     }
+    std::cout << (reload ? "Reloaded Texture: " : "Loaded Texture: ") << path << std::endl;
 }
 
-const sf::Texture & Assets::getTexture(const std::string & textureName) const
+TextureHandle Assets::getTexture(const std::string & textureName) const
 {
     assert(m_textureMap.find(textureName) != m_textureMap.end());
-    return m_textureMap.at(textureName);
+    return acquire(m_textureMap.at(textureName));
 }
 
 void Assets::addAnimation(const std::string & animationName, const std::string & textureName, size_t frameCount, size_t speed)
 {
-    m_animationMap[animationName] = Animation(animationName, getTexture(textureName), frameCount, speed);
+    // the texture has to be resident for its size, so it is loaded here even with deferred loads;
+    // that is safe since only the window thread adds or reloads animations.
+    // Assigned into the existing map node, so references to the animation stay valid
+    auto texture = getTexture(textureName);
+    auto & entry = m_textureMap.at(textureName);
+    if (entry.bytes == 0) { loadTexture(entry); }
+    m_animationMap[animationName] = Animation(animationName, *texture, frameCount, speed);
+    m_animationDefs[animationName] = { textureName, frameCount, speed };
 }
 
-const Animation & Assets::getAnimation(const std::string & animationName) const
+Animation Assets::getAnimation(const std::string & animationName) const
 {
     assert(m_animationMap.find(animationName) != m_animationMap.end());
-    return m_animationMap.at(animationName);
+    return getAnimation(m_animationMap.at(animationName));
+}
+
+Animation Assets::getAnimation(const Animation & animation) const
+{
+    Animation copy(animation);
+    auto entry = m_textureEntries.find(animation.getTexture());
+    if (entry != m_textureEntries.end())
+    {
+        copy.setTextureHandle(acquire(*entry->second));
+    }
+    return copy;
+}
+
+const Animation * Assets::findAnimation(const std::string & animationName) const
+{
+    auto animation = m_animationMap.find(animationName);
+    return animation != m_animationMap.end() ? &animation->second : nullptr;
+}
+
+void Assets::setBudget(size_t bytes)
+{
+    m_stats.budgetBytes = bytes;
+}
+
+void Assets::trim()
+{
+    if (m_stats.budgetBytes == 0 || m_stats.residentBytes <= m_stats.budgetBytes) { return; }
+
+    std::vector<TextureEntry *> idle;
+    for (auto & texture : m_textureMap)
+    {
+        if (texture.second.bytes > 0 && texture.second.handle.use_count() <= 1) { idle.push_back(&texture.second); }
+    }
+    std::sort(idle.begin(), idle.end(), [](const TextureEntry * a, const TextureEntry * b) { return a->lastUse < b->lastUse; });
+
+    for (auto entry : idle)
+    {
+        if (m_stats.residentBytes <= m_stats.budgetBytes) { break; }
+
+        // releasing the pixels keeps the object, sprites pointing at it stay valid
+        entry->texture = sf::Texture();
+        m_stats.residentBytes -= entry->bytes;
+        m_stats.residentTextures--;
+        m_stats.evictions++;
+        entry->bytes = 0;
+    }
+}
+
+void Assets::setDeferLoads(bool defer)
+{
+    m_deferLoads = defer;
+    if (!defer) { loadPending(); }
+}
+
+bool Assets::hasPendingLoads() const
+{
+    return m_hasPending;
+}
+
+void Assets::loadPending()
+{
+    for (auto entry : m_pending)
+    {
+        entry->pending = false;
+        if (entry->bytes == 0) { loadTexture(*entry); }
+    }
+    m_pending.clear();
+    m_hasPending = false;
+}
+
+const AssetStats & Assets::getStats() const
+{
+    return m_stats;
 }
 
 void Assets::addFont(const std::string & fontName, const std::string & path)
 {
-    m_fontMap[fontName] = sf::Font();
-    if (!m_fontMap[fontName].loadFromFile(path))
+    bool reload = m_fontMap.find(fontName) != m_fontMap.end();
+    sf::Font font;
+    if (!font.loadFromFile(path))
     {
         std::cerr << "Could not load font file: " << path << std::endl;
-        m_fontMap.erase(fontName);
     }
     else
     {
-        std::cout << "Loaded Font:    " << path << std::endl;
+        m_fontMap[fontName] = font;
+        m_fontPaths[fontName] = path;
+        std::cout << (reload ? "Reloaded Font:    " : "Loaded Font:    ") << path << std::endl;
     }
 }
 
@@ -2,12 +2,76 @@
 
 #include "Common.h"
 #include "Animation.h"
+#include <set>
+#include <unordered_map>
+#include <atomic>
 
+// keeps a texture resident while any copy of it is alive
+typedef std::shared_ptr<const sf::Texture> TextureHandle;
+
+struct AssetStats
+{
+    size_t residentBytes    = 0;    // pixels of resident textures, 4 bytes each
+    size_t budgetBytes      = 0;    // 0 for no budget
+    size_t residentTextures = 0;
+    size_t textures         = 0;
+    size_t hits             = 0;    // texture requests that found it resident
+    size_t misses           = 0;    // texture requests that had to load it again
+    size_t evictions        = 0;
+};
+
+// Asset registry with texture residency.
+// Every texture keeps its sf::Texture object for the lifetime of the Assets, so sprites
+// may point at it freely; only its pixels are evicted and reloaded. Animations handed out
+// carry a handle, and textures no handle refers to are evicted least recently used first
+// once the resident bytes exceed the budget.
+// Not thread-safe: the game uses it from the simulation thread, and from the window
+// thread only while the simulation is stopped between ticks. With deferred loads a
+// texture requested while evicted is only marked as needed, and the window thread,
+// the one that owns the GL context, loads it with loadPending().
 class Assets
 {
-    std::map<std::string, sf::Texture>      m_textureMap;
+    struct TextureEntry
+    {
+        sf::Texture                     texture;
+        std::string                     path;
+        bool                            smooth      = true;
+        size_t                          bytes       = 0;    // 0 while evicted
+        unsigned long long              lastUse     = 0;
+        TextureHandle                   handle;             // the entry's own reference, any other is a user
+        bool                            pending     = false;    // requested while evicted, waiting for loadPending
+    };
+
+    struct AnimationDef
+    {
+        std::string texture;
+        size_t      frameCount  = 0;
+        size_t      speed       = 0;
+
+        bool operator != (const AnimationDef & rhs) const { return texture != rhs.texture || frameCount != rhs.frameCount || speed != rhs.speed; }
+    };
+
+    // residency state is updated by const lookups, like a cache
+    mutable std::map<std::string, TextureEntry> m_textureMap;
     std::map<std::string, Animation>        m_animationMap;
     std::map<std::string, sf::Font>         m_fontMap;
+    std::unordered_map<const sf::Texture *, TextureEntry *> m_textureEntries;
+
+    // where every asset came from, so a changed file can be traced back to what it defines
+    std::string                             m_path;
+    std::map<std::string, AnimationDef>     m_animationDefs;
+    std::map<std::string, std::string>      m_fontPaths;
+
+    mutable AssetStats                      m_stats;
+    mutable unsigned long long              m_useCount = 0;
+
+    bool                                    m_deferLoads = false;
+    mutable std::vector<TextureEntry *>     m_pending;
+    mutable std::atomic<bool>               m_hasPending { false };
+
+    void readFile(const std::string & path, std::set<std::string> & textures, std::set<std::string> & animations);
+    bool loadTexture(TextureEntry & entry) const;
+    TextureHandle acquire(TextureEntry & entry) const;
 
     void addTexture(const std::string & textureName, const std::string & path, bool smooth = true);
     void addAnimation(const std::string & animationName, const std::string & textureName, size_t frameCount, size_t speed);
@@ -19,7 +83,33 @@ public:
 
     void loadFromFile(const std::string & path);
 
-    const sf::Texture & getTexture(const std::string & textureName) const;
-    const Animation &   getAnimation(const std::string & animationName) const;
+    // reload whatever the changed files define into the existing objects, so references
+    // and sprites handed out earlier stay valid; an asset list entry is only reloaded when
+    // it differs from the loaded one. Returns the animations that changed, sorted by name.
+    std::vector<std::string> reload(const std::vector<std::string> & changedFiles);
+
+    // the asset list and every image and font file it names
+    std::vector<std::string> sourceFiles() const;
+
+    // evict textures no handle refers to, least recently used first, until within budget
+    void setBudget(size_t bytes);
+    void trim();
+
+    // with deferred loads evicted textures are reloaded by loadPending() instead of on request,
+    // which has to run on the thread that owns the GL context while no tick is running
+    void setDeferLoads(bool defer);
+    bool hasPendingLoads() const;
+    void loadPending();
+    const AssetStats & getStats() const;
+
+    TextureHandle       getTexture(const std::string & textureName) const;
     const sf::Font &    getFont(const std::string & fontName) const;
-};
\ No newline at end of file
+
+    // a copy of the animation whose texture is resident and stays so while the copy lives
+    Animation           getAnimation(const std::string & animationName) const;
+    Animation           getAnimation(const Animation & animation) const;
+
+    // the registered animation without touching residency, nullptr if there is none;
+    // safe to call from several threads while nothing is being loaded
+    const Animation *   findAnimation(const std::string & animationName) const;
+};
@@ -0,0 +1,553 @@
+#include "BatchSimulation.h"
+#include "Assets.h"
+#include "Components.h"
+#include "Physics.h"
+#include <math.h>
+
+namespace
+{
+    float Sign(float value) { return (float)((value > 0) - (value < 0)); }
+
+    // Physics::EntityIntersect on a bare box
+    bool SegmentCrossesBox(const Vec2 & a, const Vec2 & b, const Vec2 & pos, const Vec2 & halfSize)
+    {
+        Vec2 points[4] =
+        {
+            Vec2(pos.x - halfSize.x, pos.y + halfSize.y),
+            pos + halfSize,
+            pos - halfSize,
+            Vec2(pos.x + halfSize.x, pos.y - halfSize.y)
+        };
+        for (int i = 0; i < 4; i++)
+        {
+            if (Physics::LineIntersect(a, b, points[i], points[(i + 1) % 4]).result) { return true; }
+        }
+        return false;
+    }
+}
+
+bool BatchLevel::load(const std::string & path, const Assets & assets, const Vec2 & roomSize)
+{
+    std::vector<LevelChunk> chunks;
+    if (!LevelParser::Parse(path, assets, chunks)) { return false; }
+
+    npcs.clear();
+    patrol.clear();
+    m_tiles.clear();
+
+    for (auto & chunk : chunks)
+    {
+        if (chunk.hasPlayer) { player = chunk.player; }
+
+        for (auto & record : chunk.records)
+        {
+            auto size       = record.animation->getSize();
+            auto roomOrigin = Vec2(roomSize.x * (float)record.roomX, roomSize.y * (float)record.roomY);
+            auto roomPos    = roomOrigin + Vec2((float)record.tileX, (float)record.tileY) * size.x;
+            auto halfSize   = size / 2;
+
+            if (record.type == LevelRecord::Tile)
+            {
+                Tile tile;
+                tile.pos            = roomPos + halfSize;
+                tile.halfSize       = halfSize;
+                tile.blockMove      = (record.layer & CollisionLayer::Tile) != 0;
+                tile.blockVision    = record.blockVision;
+                if (tile.blockMove || tile.blockVision) { m_tiles.push_back(tile); }
+                continue;
+            }
+
+            Npc npc;
+            npc.pos         = roomPos + halfSize;
+            npc.halfSize    = halfSize;
+            npc.speed       = record.speed;
+            npc.follow      = record.behaviour == LevelRecord::Follow;
+            if (record.behaviour == LevelRecord::Patrol)
+            {
+                npc.patrolBegin = (uint32_t)patrol.size();
+                npc.patrolCount = record.patrolCount;
+                for (uint32_t i = 0; i < record.patrolCount; i++)
+                {
+                    patrol.push_back(roomOrigin + chunk.patrol[record.patrolBegin + i] * size.x + halfSize);
+                }
+            }
+            npcs.push_back(npc);
+        }
+    }
+
+    auto right  = assets.findAnimation("SwordRight");
+    auto up     = assets.findAnimation("SwordUp");
+    swordRight  = right ? right->getSize() / 2 : Vec2(0, 0);
+    swordUp     = up ? up->getSize() / 2 : Vec2(0, 0);
+
+    // Bucket the tiles into the cells they touch, stored as one array of tile indices per cell
+    auto first  = [&](float v) { return (int)floor(v / m_cell); };
+    auto last   = [&](float v, int from) { return std::max(from, (int)ceil(v / m_cell) - 1); };
+
+    int maxX = 0, maxY = 0;
+    m_minX = m_minY = 0;
+    for (size_t i = 0; i < m_tiles.size(); i++)
+    {
+        auto & tile = m_tiles[i];
+        tile.cellX  = first(tile.pos.x - tile.halfSize.x);
+        tile.cellY  = first(tile.pos.y - tile.halfSize.y);
+        int x1      = last(tile.pos.x + tile.halfSize.x, tile.cellX);
+        int y1      = last(tile.pos.y + tile.halfSize.y, tile.cellY);
+        m_minX      = i ? std::min(m_minX, tile.cellX) : tile.cellX;
+        m_minY      = i ? std::min(m_minY, tile.cellY) : tile.cellY;
+        maxX        = i ? std::max(maxX, x1) : x1;
+        maxY        = i ? std::max(maxY, y1) : y1;
+    }
+    m_width     = m_tiles.empty() ? 0 : maxX - m_minX + 1;
+    m_height    = m_tiles.empty() ? 0 : maxY - m_minY + 1;
+
+    // counted once to size the cells, then filled
+    m_cellStart.assign((size_t)m_width * m_height + 1, 0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        std::vector<uint32_t> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+        for (size_t i = 0; i < m_tiles.size(); i++)
+        {
+            auto & tile = m_tiles[i];
+            int x1 = last(tile.pos.x + tile.halfSize.x, tile.cellX);
+            int y1 = last(tile.pos.y + tile.halfSize.y, tile.cellY);
+            for (int y = tile.cellY; y <= y1; y++)
+            {
+                for (int x = tile.cellX; x <= x1; x++)
+                {
+                    size_t cell = (size_t)(y - m_minY) * m_width + (x - m_minX);
+                    if (pass == 0)  { m_cellStart[cell + 1]++; }
+                    else            { m_cellTiles[fill[cell]++] = (uint32_t)i; }
+                }
+            }
+        }
+        if (pass == 0)
+        {
+            for (size_t c = 1; c < m_cellStart.size(); c++) { m_cellStart[c] += m_cellStart[c - 1]; }
+            m_cellTiles.resize(m_cellStart.back());
+        }
+    }
+    return true;
+}
+
+bool BatchLevel::cellRange(const AABB & area, int & x0, int & y0, int & x1, int & y1) const
+{
+    x0 = std::max(m_minX, (int)floor(area.min.x / m_cell));
+    y0 = std::max(m_minY, (int)floor(area.min.y / m_cell));
+    x1 = std::min(m_minX + m_width - 1, (int)floor(area.max.x / m_cell));
+    y1 = std::min(m_minY + m_height - 1, (int)floor(area.max.y / m_cell));
+    return x0 <= x1 && y0 <= y1;
+}
+
+bool BatchLevel::blocksVision(const Vec2 & a, const Vec2 & b) const
+{
+    // Walk the cells the segment passes through, a tile it crosses sits in one of them
+    Vec2 d      = b - a;
+    int x       = (int)floor(a.x / m_cell), y = (int)floor(a.y / m_cell);
+    int endX    = (int)floor(b.x / m_cell), endY = (int)floor(b.y / m_cell);
+    int stepX   = d.x > 0 ? 1 : -1;
+    int stepY   = d.y > 0 ? 1 : -1;
+    float nextX = d.x != 0 ? ((x + (stepX > 0)) * m_cell - a.x) / d.x : INFINITY;
+    float nextY = d.y != 0 ? ((y + (stepY > 0)) * m_cell - a.y) / d.y : INFINITY;
+    float cellX = d.x != 0 ? m_cell / fabsf(d.x) : INFINITY;
+    float cellY = d.y != 0 ? m_cell / fabsf(d.y) : INFINITY;
+
+    for (int steps = abs(endX - x) + abs(endY - y); steps >= 0; steps--)
+    {
+        if (x >= m_minX && x < m_minX + m_width && y >= m_minY && y < m_minY + m_height)
+        {
+            size_t cell = (size_t)(y - m_minY) * m_width + (x - m_minX);
+            for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++)
+            {
+                auto & tile = m_tiles[m_cellTiles[i]];
+                if (tile.blockVision && SegmentCrossesBox(a, b, tile.pos, tile.halfSize)) { return true; }
+            }
+        }
+
+        if (nextX < nextY)  { x += stepX; nextX += cellX; }
+        else                { y += stepY; nextY += cellY; }
+    }
+    return false;
+}
+
+size_t BatchLevel::tileCount() const
+{
+    return m_tiles.size();
+}
+
+double BatchStats::worldTicksPerSecond() const
+{
+    return stepMicros > 0 ? worlds * ticks / (stepMicros / 1000000.0) : 0.0;
+}
+
+const size_t BatchSimulation::SliceWorlds;
+
+BatchSimulation::BatchSimulation(const BatchLevel & level, size_t worlds, size_t threads)
+    : m_level(level)
+    , m_worlds(worlds)
+    , m_stride((worlds + SliceWorlds - 1) & ~(SliceWorlds - 1))
+{
+    size_t npcs = level.npcs.size() * m_stride;
+    for (auto field : { &m_px, &m_py, &m_pPrevX, &m_pPrevY, &m_pvx, &m_pvy, &m_facingX, &m_facingY, &m_swordX, &m_swordY })
+    {
+        field->resize(worlds);
+    }
+    for (auto field : { &m_nx, &m_ny, &m_nPrevX, &m_nPrevY, &m_nvx, &m_nvy })
+    {
+        field->resize(npcs);
+    }
+    m_swordTicks.resize(worlds);
+    m_swordUp.resize(worlds);
+    m_playerKilled.resize(worlds);
+    m_deaths.resize(worlds);
+    m_kills.resize(worlds);
+    m_leg.resize(npcs);
+    m_alive.resize(npcs);
+    reset();
+
+    // the calling thread takes the first slice of every step
+    if (threads == 0) { threads = std::max(1u, std::thread::hardware_concurrency()); }
+    threads = std::max<size_t>(1, std::min(threads, m_stride / SliceWorlds));
+    m_stats.worlds  = worlds;
+    m_stats.threads = threads;
+    for (size_t i = 1; i < threads; i++)
+    {
+        m_workers.emplace_back(&BatchSimulation::work, this, i);
+    }
+}
+
+BatchSimulation::~BatchSimulation()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (auto & worker : m_workers) { worker.join(); }
+}
+
+void BatchSimulation::reset()
+{
+    auto & player = m_level.player;
+    std::fill(m_px.begin(), m_px.end(), player.x);
+    std::fill(m_py.begin(), m_py.end(), player.y);
+    std::fill(m_pPrevX.begin(), m_pPrevX.end(), player.x);
+    std::fill(m_pPrevY.begin(), m_pPrevY.end(), player.y);
+    std::fill(m_pvx.begin(), m_pvx.end(), 0.0f);
+    std::fill(m_pvy.begin(), m_pvy.end(), 0.0f);
+    std::fill(m_facingX.begin(), m_facingX.end(), 0.0f);
+    std::fill(m_facingY.begin(), m_facingY.end(), 1.0f);
+    std::fill(m_swordTicks.begin(), m_swordTicks.end(), 0);
+    std::fill(m_deaths.begin(), m_deaths.end(), 0);
+    std::fill(m_kills.begin(), m_kills.end(), 0);
+
+    for (size_t k = 0; k < m_level.npcs.size(); k++)
+    {
+        auto row = k * m_stride;
+        auto pos = m_level.npcs[k].pos;
+        std::fill(m_nx.begin() + row, m_nx.begin() + row + m_worlds, pos.x);
+        std::fill(m_ny.begin() + row, m_ny.begin() + row + m_worlds, pos.y);
+        std::fill(m_nPrevX.begin() + row, m_nPrevX.begin() + row + m_worlds, pos.x);
+        std::fill(m_nPrevY.begin() + row, m_nPrevY.begin() + row + m_worlds, pos.y);
+    }
+    std::fill(m_nvx.begin(), m_nvx.end(), 0.0f);
+    std::fill(m_nvy.begin(), m_nvy.end(), 0.0f);
+    std::fill(m_leg.begin(), m_leg.end(), 0);
+    std::fill(m_alive.begin(), m_alive.end(), 1);
+    m_stats.ticks       = 0;
+    m_stats.stepMicros  = 0;
+}
+
+void BatchSimulation::step(const uint8_t * inputs)
+{
+    sf::Clock clock;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inputs    = inputs;
+        m_running   = m_workers.size();
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_finished.wait(lock, [&] { return m_running == 0; });
+    m_stats.ticks++;
+    m_stats.stepMicros += clock.getElapsedTime().asMicroseconds();
+}
+
+void BatchSimulation::work(size_t thread)
+{
+    // slices start on a multiple of SliceWorlds, so with every array starting on a cache line
+    // no two threads write the same one, whatever the width of the field
+    auto bound = [&](size_t i) { return i == m_stats.threads ? m_worlds : (m_worlds * i / m_stats.threads) & ~(SliceWorlds - 1); };
+
+    if (thread == 0)
+    {
+        tick(bound(0), bound(1));
+        return;
+    }
+
+    size_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_quit || m_generation != seen; });
+            if (m_quit) { return; }
+            seen = m_generation;
+        }
+
+        tick(bound(thread), bound(thread + 1));
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_running == 0) { m_finished.notify_one(); }
+    }
+}
+
+Vec2 BatchSimulation::resolveTiles(const Vec2 & prevPos, const Vec2 & pos, const Vec2 & halfSize) const
+{
+    // the sweep and push-out of GameState_Play::resolveTileCollisions
+    auto result = Physics::SlideMove(prevPos, halfSize, pos - prevPos, [&](const Vec2 & from, const Vec2 & to, auto && visit)
+    {
+        m_level.forEachTile(AABB::Union(AABB::FromCenter(from, halfSize), AABB::FromCenter(to, halfSize)), visit);
+    });
+
+    m_level.forEachTile(AABB::FromCenter(result, halfSize), [&](const Vec2 & tilePos, const Vec2 & tileHalfSize)
+    {
+        auto current    = Physics::Overlap(tilePos, tileHalfSize, result, halfSize);
+        auto previous   = Physics::Overlap(tilePos, tileHalfSize, prevPos, halfSize);
+        if (current.x > 0 && current.y > 0)
+        {
+            if (previous.x > 0)         { result.y += current.y * Sign(prevPos.y - result.y); }
+            else if (previous.y > 0)    { result.x += current.x * Sign(prevPos.x - result.x); }
+        }
+    });
+    return result;
+}
+
+void BatchSimulation::tick(size_t begin, size_t end)
+{
+    auto & level        = m_level;
+    auto & player       = level.player;
+    const uint8_t * in  = m_inputs;
+    const Vec2 playerHalf(player.cx / 2, player.cy / 2);
+
+    // Input: attacking with no sword out spawns one in front of the player, as spawnSword does
+    for (size_t w = begin; w < end; w++)
+    {
+        if ((in[w] & BatchInput::Attack) && m_swordTicks[w] == 0)
+        {
+            m_swordUp[w]    = m_facingY[w] != 0;
+            m_swordTicks[w] = SwordTicks;
+        }
+    }
+
+    // AI: one NPC of every world at a time, the rules of PatrolBehaviour and FollowBehaviour
+    for (size_t k = 0; k < level.npcs.size(); k++)
+    {
+        auto & npc      = level.npcs[k];
+        size_t row      = k * m_stride;
+        float * x       = &m_nx[row];
+        float * y       = &m_ny[row];
+        float * vx      = &m_nvx[row];
+        float * vy      = &m_nvy[row];
+        uint32_t * leg  = &m_leg[row];
+        uint8_t * alive = &m_alive[row];
+
+        if (npc.patrolCount > 0)
+        {
+            const Vec2 * points = &level.patrol[npc.patrolBegin];
+            for (size_t w = begin; w < end; w++)
+            {
+                if (!alive[w]) { continue; }
+                uint32_t next   = leg[w] + 1 == npc.patrolCount ? 0 : leg[w] + 1;
+                Vec2 velocity   = (points[next] - points[leg[w]]).sign() * npc.speed;
+                vx[w]           = velocity.x;
+                vy[w]           = velocity.y;
+                if ((Vec2(x[w], y[w]) + velocity).distSq(points[next]) <= 5.0f * 5.0f) { leg[w] = next; }
+            }
+        }
+        else if (npc.follow)
+        {
+            for (size_t w = begin; w < end; w++)
+            {
+                if (!alive[w]) { continue; }
+
+                // straight at the player while it is in sight, otherwise straight home
+                Vec2 pos(x[w], y[w]);
+                Vec2 playerPos(m_px[w], m_py[w]);
+                Vec2 direction = playerPos - pos;
+                if (level.blocksVision(pos, playerPos))
+                {
+                    direction = pos.distSq(npc.pos) > 5.0f * 5.0f ? npc.pos - pos : Vec2(0, 0);
+                }
+
+                float speedX = npc.speed;
+                float speedY = npc.speed;
+                if (fabsf(direction.x) > fabsf(direction.y))        { speedY = fabsf(speedY * (direction.y / direction.x)); }
+                else if (fabsf(direction.x) < fabsf(direction.y))   { speedX = fabsf(speedX * (direction.x / direction.y)); }
+                vx[w] = speedX * Sign(direction.x);
+                vy[w] = speedY * Sign(direction.y);
+            }
+        }
+    }
+
+    // Movement: the player's speed from its buttons as in sMovement, then every position integrated
+    for (size_t w = begin; w < end; w++)
+    {
+        bool up = (in[w] & BatchInput::Up) != 0, down = (in[w] & BatchInput::Down) != 0;
+        bool left = (in[w] & BatchInput::Left) != 0, right = (in[w] & BatchInput::Right) != 0;
+
+        if ((!up && !down) || left || right) { m_pvy[w] = 0; }
+        if ((!left && !right) || up || down) { m_pvx[w] = 0; }
+
+        if (left)           { m_pvx[w] = -player.speed; m_facingX[w] = -1; m_facingY[w] = 0; }
+        else if (right)     { m_pvx[w] = player.speed;  m_facingX[w] = 1;  m_facingY[w] = 0; }
+        else if (up)        { m_pvy[w] = -player.speed; m_facingX[w] = 0;  m_facingY[w] = -1; }
+        else if (down)      { m_pvy[w] = player.speed;  m_facingX[w] = 0;  m_facingY[w] = 1; }
+
+        m_pPrevX[w] = m_px[w];
+        m_pPrevY[w] = m_py[w];
+        m_px[w]     += m_pvx[w];
+        m_py[w]     += m_pvy[w];
+
+        // the sword keeps the size it was spawned with and follows the player's facing
+        float reach     = playerHalf.x + (m_swordUp[w] ? level.swordUp.x : level.swordRight.x);
+        m_swordX[w]     = m_px[w] + m_facingX[w] * reach;
+        m_swordY[w]     = m_py[w] + m_facingY[w] * reach;
+    }
+
+    for (size_t k = 0; k < level.npcs.size(); k++)
+    {
+        size_t row      = k * m_stride;
+        float * x       = &m_nx[row];
+        float * y       = &m_ny[row];
+        float * prevX   = &m_nPrevX[row];
+        float * prevY   = &m_nPrevY[row];
+        const float * vx = &m_nvx[row];
+        const float * vy = &m_nvy[row];
+        for (size_t w = begin; w < end; w++)
+        {
+            prevX[w]    = x[w];
+            prevY[w]    = y[w];
+            x[w]        += vx[w];
+            y[w]        += vy[w];
+        }
+    }
+
+    // Collision: the player and then every NPC against the tiles, as sCollision orders them
+    for (size_t w = begin; w < end; w++)
+    {
+        auto pos    = resolveTiles(Vec2(m_pPrevX[w], m_pPrevY[w]), Vec2(m_px[w], m_py[w]), playerHalf);
+        m_px[w]     = pos.x;
+        m_py[w]     = pos.y;
+        m_playerKilled[w] = 0;
+    }
+
+    for (size_t k = 0; k < level.npcs.size(); k++)
+    {
+        auto & npc      = level.npcs[k];
+        size_t row      = k * m_stride;
+        float * x       = &m_nx[row];
+        float * y       = &m_ny[row];
+        float * vx      = &m_nvx[row];
+        float * vy      = &m_nvy[row];
+        uint8_t * alive = &m_alive[row];
+
+        for (size_t w = begin; w < end; w++)
+        {
+            // an NPC standing still was already pushed out of the tiles when it stopped
+            if (!alive[w] || (vx[w] == 0 && vy[w] == 0)) { continue; }
+            auto pos    = resolveTiles(Vec2(m_nPrevX[row + w], m_nPrevY[row + w]), Vec2(x[w], y[w]), npc.halfSize);
+            x[w]        = pos.x;
+            y[w]        = pos.y;
+        }
+
+        // Contacts with the player and the sword, the same strict overlap test as Physics::GetOverlap
+        for (size_t w = begin; w < end; w++)
+        {
+            bool touchesPlayer  = playerHalf.x + npc.halfSize.x - fabsf(m_px[w] - x[w]) > 0
+                               && playerHalf.y + npc.halfSize.y - fabsf(m_py[w] - y[w]) > 0;
+            Vec2 swordHalf      = m_swordUp[w] ? level.swordUp : level.swordRight;
+            bool touchesSword   = swordHalf.x + npc.halfSize.x - fabsf(m_swordX[w] - x[w]) > 0
+                               && swordHalf.y + npc.halfSize.y - fabsf(m_swordY[w] - y[w]) > 0;
+
+            m_playerKilled[w]   |= alive[w] & touchesPlayer;
+            uint8_t killed      = alive[w] & touchesSword & (m_swordTicks[w] > 0);
+            m_kills[w]          += killed;
+            alive[w]            &= !killed;
+            vx[w]               = killed ? 0.0f : vx[w];
+            vy[w]               = killed ? 0.0f : vy[w];
+        }
+    }
+
+    // Events and lifespan: a killed player respawns at the start, the sword runs out
+    for (size_t w = begin; w < end; w++)
+    {
+        if (m_playerKilled[w])
+        {
+            m_deaths[w]++;
+            m_px[w]         = m_pPrevX[w] = player.x;
+            m_py[w]         = m_pPrevY[w] = player.y;
+            m_pvx[w]        = m_pvy[w] = 0;
+            m_facingX[w]    = 0;
+            m_facingY[w]    = 1;
+        }
+        if (m_swordTicks[w] > 0) { m_swordTicks[w]--; }
+    }
+}
+
+size_t BatchSimulation::worlds() const
+{
+    return m_worlds;
+}
+
+Vec2 BatchSimulation::playerPos(size_t world) const
+{
+    return Vec2(m_px[world], m_py[world]);
+}
+
+uint32_t BatchSimulation::deaths(size_t world) const
+{
+    return m_deaths[world];
+}
+
+uint32_t BatchSimulation::kills(size_t world) const
+{
+    return m_kills[world];
+}
+
+bool BatchSimulation::npcAlive(size_t npc, size_t world) const
+{
+    return m_alive[npc * m_stride + world] != 0;
+}
+
+Vec2 BatchSimulation::npcPos(size_t npc, size_t world) const
+{
+    return Vec2(m_nx[npc * m_stride + world], m_ny[npc * m_stride + world]);
+}
+
+uint64_t BatchSimulation::hash() const
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&](const void * data, size_t size)
+    {
+        auto bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++) { hash = (hash ^ bytes[i]) * 1099511628211ull; }
+    };
+    add(m_px.data(), m_px.size() * sizeof(float));
+    add(m_py.data(), m_py.size() * sizeof(float));
+    add(m_nx.data(), m_nx.size() * sizeof(float));
+    add(m_ny.data(), m_ny.size() * sizeof(float));
+    add(m_alive.data(), m_alive.size());
+    add(m_deaths.data(), m_deaths.size() * sizeof(uint32_t));
+    add(m_kills.data(), m_kills.size() * sizeof(uint32_t));
+    return hash;
+}
+
+const BatchStats & BatchSimulation::getStats() const
+{
+    return m_stats;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "Common.h"
+#include "AABBTree.h"
+#include "LevelParser.h"
+#include "MemoryArena.h"
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class Assets;
+
+// one world's buttons for one tick of BatchSimulation::step
+namespace BatchInput
+{
+    enum : uint8_t
+    {
+        Up      = 1 << 0,
+        Down    = 1 << 1,
+        Left    = 1 << 2,
+        Right   = 1 << 3,
+        Attack  = 1 << 4
+    };
+}
+
+// Read-only data of a level shared by every world of a batch: the tiles bucketed in a grid,
+// the NPCs with their patrol routes, the player and the sword sizes, all laid out the way
+// spawnLevelRecord, spawnPlayer and spawnSword lay out the entities.
+class BatchLevel
+{
+public:
+
+    struct Npc
+    {
+        Vec2        pos, halfSize;
+        float       speed       = 0;
+        bool        follow      = false;
+        uint32_t    patrolBegin = 0;    // index into patrol
+        uint32_t    patrolCount = 0;
+    };
+
+    std::vector<Npc>    npcs;
+    std::vector<Vec2>   patrol;
+    LevelPlayer         player;
+    Vec2                swordRight, swordUp;    // half sizes of the sword held sideways and up or down
+
+    bool load(const std::string & path, const Assets & assets, const Vec2 & roomSize);
+
+    // call fn(pos, halfSize) once for every movement-blocking tile in the cells the area touches
+    template <typename F>
+    void forEachTile(const AABB & area, F && fn) const
+    {
+        int x0, y0, x1, y1;
+        if (!cellRange(area, x0, y0, x1, y1)) { return; }
+        for (int y = y0; y <= y1; y++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                size_t cell = (size_t)(y - m_minY) * m_width + (x - m_minX);
+                for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++)
+                {
+                    auto & tile = m_tiles[m_cellTiles[i]];
+                    // a tile spanning several cells is only reported from the first one both ranges share
+                    if (tile.blockMove && x == std::max(tile.cellX, x0) && y == std::max(tile.cellY, y0))
+                    {
+                        fn(tile.pos, tile.halfSize);
+                    }
+                }
+            }
+        }
+    }
+
+    // true when the segment crosses an edge of a vision-blocking tile, as canSeePlayer tests it
+    bool blocksVision(const Vec2 & a, const Vec2 & b) const;
+
+    size_t tileCount() const;
+
+private:
+
+    struct Tile
+    {
+        Vec2    pos, halfSize;
+        int     cellX = 0, cellY = 0;   // first cell the tile touches
+        bool    blockMove   = false;
+        bool    blockVision = false;
+    };
+
+    float                   m_cell      = 64;
+    int                     m_minX      = 0, m_minY = 0;
+    int                     m_width     = 0, m_height = 0;
+    std::vector<Tile>       m_tiles;
+    std::vector<uint32_t>   m_cellStart;    // the tiles of cell i are m_cellTiles[m_cellStart[i], m_cellStart[i + 1])
+    std::vector<uint32_t>   m_cellTiles;
+
+    bool cellRange(const AABB & area, int & x0, int & y0, int & x1, int & y1) const;
+};
+
+struct BatchStats
+{
+    size_t      worlds      = 0;
+    size_t      threads     = 0;
+    size_t      ticks       = 0;
+    long long   stepMicros  = 0;    // wall time of all steps so far
+
+    double worldTicksPerSecond() const;
+};
+
+// Steps many independent copies of one level in lockstep, without windows, assets or entities.
+// The rules are those of GameState_Play's systems with every NPC awake, except that follow
+// NPCs walk straight at the player or their home instead of along the flow field and A* path.
+// Every field of the dynamic state is one array with NPC k of world w at k * stride + w, so
+// the movement and contact kernels run over all worlds of one NPC in a straight pass the
+// compiler vectorizes. step() splits the worlds over threads that live as long as the batch,
+// in slices of whole SliceWorlds, and every array starts on a cache line, so no two threads
+// ever write the same line.
+class BatchSimulation
+{
+    const BatchLevel &  m_level;
+    size_t              m_worlds;
+    size_t              m_stride;       // worlds rounded up to whole slices
+
+    // 64 worlds of the narrowest field, a byte each, fill one cache line
+    static const size_t SliceWorlds = 64;
+
+    // one entry per world
+    CacheLineVector<float>      m_px, m_py, m_pPrevX, m_pPrevY, m_pvx, m_pvy;
+    CacheLineVector<float>      m_facingX, m_facingY;
+    CacheLineVector<float>      m_swordX, m_swordY;
+    CacheLineVector<uint8_t>    m_swordTicks;       // ticks the sword has left, 0 without one
+    CacheLineVector<uint8_t>    m_swordUp;
+    CacheLineVector<uint8_t>    m_playerKilled;
+    CacheLineVector<uint32_t>   m_deaths, m_kills;
+
+    // one entry per NPC per world, each NPC's row m_stride entries long
+    CacheLineVector<float>      m_nx, m_ny, m_nPrevX, m_nPrevY, m_nvx, m_nvy;
+    CacheLineVector<uint32_t>   m_leg;              // patrol point the current leg starts from
+    CacheLineVector<uint8_t>    m_alive;
+
+    // worker threads, woken once per step
+    std::vector<std::thread>    m_workers;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_wake, m_finished;
+    const uint8_t *             m_inputs        = nullptr;
+    size_t                      m_generation    = 0;
+    size_t                      m_running       = 0;
+    bool                        m_quit          = false;
+    BatchStats                  m_stats;
+
+    void work(size_t thread);
+    void tick(size_t begin, size_t end);
+    Vec2 resolveTiles(const Vec2 & prevPos, const Vec2 & pos, const Vec2 & halfSize) const;
+
+public:
+
+    // the sword's 150 ms lifespan at 60 ticks per second
+    static const uint8_t SwordTicks = 9;
+
+    // threads 0 uses every core
+    BatchSimulation(const BatchLevel & level, size_t worlds, size_t threads = 0);
+    ~BatchSimulation();
+
+    // every world back to the start of the level
+    void reset();
+
+    // advance every world one tick, inputs holds one BatchInput mask per world
+    void step(const uint8_t * inputs);
+
+    size_t      worlds() const;
+    Vec2        playerPos(size_t world) const;
+    uint32_t    deaths(size_t world) const;
+    uint32_t    kills(size_t world) const;
+    bool        npcAlive(size_t npc, size_t world) const;
+    Vec2        npcPos(size_t npc, size_t world) const;
+
+    // FNV-1a of every world's state, equal for equal inputs whatever the thread count
+    uint64_t    hash() const;
+
+    const BatchStats & getStats() const;
+};
@@ -0,0 +1,143 @@
+#include "Behaviour.h"
+#include "Components.h"
+#include "Entity.h"
+#include "NavGrid.h"
+#include <math.h>
+
+Await Await::Now()
+{
+    return Await();
+}
+
+Await Await::NextTick(size_t now)
+{
+    Await await;
+    await.kind  = Kind::Tick;
+    await.tick  = now + 1;
+    return await;
+}
+
+Await Await::WaitTicks(size_t now, size_t ticks)
+{
+    Await await;
+    await.kind  = Kind::Timer;
+    await.tick  = now + ticks;
+    return await;
+}
+
+Await Await::MoveTo(const Vec2 & velocity, const Vec2 & target, float radius)
+{
+    Await await;
+    await.kind      = Kind::Arrive;
+    await.velocity  = velocity;
+    await.target    = target;
+    await.radius    = radius;
+    return await;
+}
+
+Await Await::UntilVisible()
+{
+    Await await;
+    await.kind  = Kind::Visible;
+    return await;
+}
+
+Await Await::Never()
+{
+    Await await;
+    await.kind  = Kind::Done;
+    return await;
+}
+
+Await PatrolBehaviour::resume(Entity & npc, BehaviourContext &)
+{
+    auto & patrol = npc.get<CPatrol>();
+    if (patrol.positions.empty()) { return Await::Never(); }
+
+    // resumed after arriving: the waypoint just reached is where the next leg starts
+    if (m_walking) {
+        patrol.currentPosition = m_next;
+    }
+    m_walking = true;
+
+    // head for the next position, straight along the axis between the two waypoints,
+    // and count it as reached once a step ends within 5 pixels of it
+    m_next          = (patrol.currentPosition + 1) % patrol.positions.size();
+    auto direction  = patrol.positions[m_next] - patrol.positions[patrol.currentPosition];
+    return Await::MoveTo(direction.sign() * patrol.speed, patrol.positions[m_next], 5);
+}
+
+namespace
+{
+    template <typename T> const TVec2<T> & PlayerPos(const BehaviourContext & context);
+    template <> const Vec2 & PlayerPos<float>(const BehaviourContext & context) { return context.playerPos; }
+    template <> const FixedVec2 & PlayerPos<Fixed>(const BehaviourContext & context) { return context.fixedPlayerPos; }
+
+    template <typename T>
+    Await Follow(Entity & npc, BehaviourContext & context)
+    {
+        auto & transform    = npc.get<CTransform>();
+        auto & followPlayer = npc.get<CFollowPlayer>();
+        auto & pos          = transform.position<T>();
+        bool follow         = context.canSeePlayer(npc);
+
+        // set goal to player (default behavior), following the shared flow field around obstacles
+        auto direction  = PlayerPos<T>(context) - pos;
+        bool home       = false;
+        Vec2 waypoint;
+        if (follow) {
+            followPlayer.homePath.clear();
+            if (context.navGrid->flowWaypoint(transform.pos(), waypoint)) {
+                direction = VecCast<T>(waypoint) - pos;
+            }
+        }
+        // set goal to home if vision is blocked, walking the A* path computed when sight was lost
+        else {
+            // stop heading to home if npc is within 5 pixels of home, so it does not oscillate around or overshoot it
+            if (pos.distSq(VecCast<T>(followPlayer.home)) > T(5.0f * 5.0f)) {
+                if (followPlayer.homePath.empty()) {
+                    followPlayer.homePathIndex = 0;
+                    if (!context.navGrid->findPath(transform.pos(), followPlayer.home, followPlayer.homePath)) {
+                        followPlayer.homePath.push_back(followPlayer.home);
+                    }
+                }
+                auto & path = followPlayer.homePath;
+                T speed     = T(followPlayer.speed);
+                while (followPlayer.homePathIndex + 1 < path.size() && pos.distSq(VecCast<T>(path[followPlayer.homePathIndex])) <= speed * speed) {
+                    followPlayer.homePathIndex++;
+                }
+                direction = VecCast<T>(path[followPlayer.homePathIndex]) - pos;
+            }
+            else {
+                direction *= T(0);
+                home = true;
+            }
+        }
+
+        // move towards goal with speed equal to the ratio of the vector to goal
+        T speedx = T(followPlayer.speed);
+        T speedy = T(followPlayer.speed);
+        // if x distance is larger, change y speed to the fraction of actual speed according to the ratio
+        if (Abs(direction.x) > Abs(direction.y)) {
+            speedy = Abs(speedy * (direction.y / direction.x));
+        }
+        // if y distance is larger, change x speed to the fraction of actual speed according to the ratio
+        else if (Abs(direction.x) < Abs(direction.y)) {
+            speedx = Abs(speedx * (direction.x / direction.y));
+        }
+
+        transform.velocity<T>() = TVec2<T>(speedx * T((direction.x > T(0)) - (direction.x < T(0))), speedy * T((direction.y > T(0)) - (direction.y < T(0))));
+        transform.syncFloat<T>();
+        if (transform.speed() != Vec2(0, 0)) {
+            npc.markChanged<CTransform>();
+        }
+
+        // standing at home nothing changes until the player comes into view
+        return home ? Await::UntilVisible() : Await::NextTick(context.tick);
+    }
+}
+
+Await FollowBehaviour::resume(Entity & npc, BehaviourContext & context)
+{
+    return context.deterministic ? Follow<Fixed>(npc, context) : Follow<float>(npc, context);
+}
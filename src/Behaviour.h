@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Common.h"
+#include "Fixed.h"
+#include <functional>
+
+class Entity;
+class NavGrid;
+
+// What a suspended behaviour waits for. The scheduler checks the condition itself and
+// only resumes the behaviour once it holds, so a waiting NPC costs a comparison per tick
+// (or nothing at all while it waits on a timer).
+struct Await
+{
+    enum class Kind : unsigned char
+    {
+        Ready,      // resume on the scheduler's next pass, the first state of every behaviour
+        Tick,       // resume on the next tick the NPC thinks on
+        Timer,      // resume once the scheduler reaches tick
+        Arrive,     // walk with velocity every tick, resume the tick after a step ends within radius of target
+        Visible,    // resume on a tick the NPC thinks on and can see the player
+        Done        // never resume again
+    };
+
+    Kind    kind        = Kind::Ready;
+    size_t  tick        = 0;
+    Vec2    velocity;
+    Vec2    target;
+    float   radius      = 0;
+
+    static Await Now();
+    static Await NextTick(size_t now);
+    static Await WaitTicks(size_t now, size_t ticks);
+    static Await MoveTo(const Vec2 & velocity, const Vec2 & target, float radius);
+    static Await UntilVisible();
+    static Await Never();
+};
+
+// what a behaviour may look at while it runs
+struct BehaviourContext
+{
+    size_t                          tick    = 0;
+    Vec2                            playerPos;
+    FixedVec2                       fixedPlayerPos;
+    bool                            deterministic = false;  // move in Fixed, see GameState_Play::setDeterministic
+    NavGrid *                       navGrid = nullptr;
+    std::function<bool(Entity &)>   canSeePlayer;
+};
+
+// An NPC script written as a resumable state machine: resume() runs from where the last
+// call stopped to the next suspension point and returns what to wait for. It stands in for
+// a C++20 coroutine, which the MSVC v141 toolset this project builds with does not have;
+// the state that would live in the coroutine frame lives in the object, which is
+// allocated from the level arena with the NPC's components.
+class Behaviour
+{
+public:
+    virtual ~Behaviour() {}
+
+    // what to wait for before the first resume
+    virtual Await start() { return Await::Now(); }
+    virtual Await resume(Entity & npc, BehaviourContext & context) = 0;
+};
+
+// Walks CPatrol::positions in a loop, one MoveTo per leg.
+class PatrolBehaviour : public Behaviour
+{
+    bool    m_walking   = false;    // false until the first leg starts
+    size_t  m_next      = 0;
+
+public:
+    Await resume(Entity & npc, BehaviourContext & context) override;
+};
+
+// Chases the player along the flow field while it can see them, otherwise walks the A*
+// path back to CFollowPlayer::home and waits there until the player shows up again.
+class FollowBehaviour : public Behaviour
+{
+public:
+    Await start() override { return Await::NextTick(0); }
+    Await resume(Entity & npc, BehaviourContext & context) override;
+};
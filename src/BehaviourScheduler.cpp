@@ -0,0 +1,137 @@
+#include "BehaviourScheduler.h"
+#include "ActivityGrid.h"
+#include "Components.h"
+#include <algorithm>
+#include <functional>
+
+// set the NPC walking with the await's velocity, true if this step ends within its radius of the target
+template <typename T>
+static bool Arrives(Entity & npc, const Await & await)
+{
+    auto & transform = npc.get<CTransform>();
+    transform.velocity<T>() = VecCast<T>(await.velocity);
+    transform.syncFloat<T>();
+
+    T radius = T(await.radius);
+    return (transform.position<T>() + transform.velocity<T>()).distSq(VecCast<T>(await.target)) <= radius * radius;
+}
+
+void BehaviourScheduler::reset()
+{
+    m_tick  = 0;
+    m_order = 0;
+    m_timers.clear();
+    m_removed.clear();
+    m_stats = BehaviourStats();
+}
+
+void BehaviourScheduler::remove(Entity * entity)
+{
+    // a timer set before the behaviour moved on to another wait may still be in the heap
+    if (entity->hasComponent<CBehaviour>() && !m_timers.empty()) {
+        m_removed.push_back(entity);
+    }
+}
+
+void BehaviourScheduler::suspend(Entity & npc, const Await & await)
+{
+    npc.get<CBehaviour>().await = await;
+    if (await.kind == Await::Kind::Timer) {
+        m_timers.push_back({ await.tick, m_order++, &npc });
+        std::push_heap(m_timers.begin(), m_timers.end(), std::greater<Timer>());
+    }
+}
+
+void BehaviourScheduler::run(Entity & npc, bool thinks, BehaviourContext & context)
+{
+    auto & behaviour = npc.get<CBehaviour>();
+
+    // a behaviour resumed this tick may finish several waits at once, the bound keeps a
+    // script that never suspends from stalling the tick
+    for (int step = 0; step < 4; step++) {
+        auto & await = behaviour.await;
+        switch (await.kind) {
+        case Await::Kind::Ready:
+            m_stats.resumed++;
+            suspend(npc, behaviour.behaviour->resume(npc, context));
+            continue;
+
+        case Await::Kind::Arrive: {
+            // the step is taken this tick and the behaviour picks its next leg on the next
+            npc.markChanged<CTransform>();
+            if (context.deterministic ? Arrives<Fixed>(npc, await) : Arrives<float>(npc, await)) {
+                await.kind = Await::Kind::Ready;
+            }
+            break;
+        }
+
+        case Await::Kind::Tick:
+            if (thinks && m_tick >= await.tick) {
+                await.kind = Await::Kind::Ready;
+                continue;
+            }
+            break;
+
+        case Await::Kind::Visible:
+            if (thinks && context.canSeePlayer(npc)) {
+                await.kind = Await::Kind::Ready;
+                continue;
+            }
+            break;
+
+        case Await::Kind::Timer:
+        case Await::Kind::Done:
+            break;
+        }
+
+        // while waiting the NPC keeps the speed it last chose, and the pool keeps moving it
+        if (await.kind != Await::Kind::Arrive && npc.get<CTransform>().speed() != Vec2(0, 0)) {
+            npc.markChanged<CTransform>();
+        }
+        m_stats.waiting++;
+        return;
+    }
+}
+
+void BehaviourScheduler::update(ActivityGrid & activity, BehaviourContext & context)
+{
+    m_tick++;
+    context.tick    = m_tick;
+    m_stats.resumed = 0;
+    m_stats.waiting = 0;
+
+    // drop the timers of removed entities before anything could touch them
+    if (!m_removed.empty()) {
+        std::sort(m_removed.begin(), m_removed.end());
+        m_timers.erase(std::remove_if(m_timers.begin(), m_timers.end(), [&](const Timer & timer) {
+            return std::binary_search(m_removed.begin(), m_removed.end(), timer.entity);
+        }), m_timers.end());
+        std::make_heap(m_timers.begin(), m_timers.end(), std::greater<Timer>());
+        m_removed.clear();
+    }
+
+    // expired timers only mark their behaviour ready, it resumes when its NPC is next visited
+    while (!m_timers.empty() && m_timers.front().tick <= m_tick) {
+        auto & await = m_timers.front().entity->get<CBehaviour>().await;
+        if (await.kind == Await::Kind::Timer && await.tick <= m_tick) {
+            await.kind = Await::Kind::Ready;
+        }
+        std::pop_heap(m_timers.begin(), m_timers.end(), std::greater<Timer>());
+        m_timers.pop_back();
+    }
+    m_stats.timers = m_timers.size();
+
+    activity.forEach<CBehaviour>([&](Entity & npc, CBehaviour &) {
+        run(npc, activity.thinks(npc), context);
+    });
+}
+
+size_t BehaviourScheduler::tick() const
+{
+    return m_tick;
+}
+
+const BehaviourStats & BehaviourScheduler::getStats() const
+{
+    return m_stats;
+}
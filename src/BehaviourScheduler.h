@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Common.h"
+#include "Behaviour.h"
+
+class ActivityGrid;
+
+struct BehaviourStats
+{
+    size_t resumed  = 0;    // behaviours resumed during the last update
+    size_t waiting  = 0;    // behaviours visited but left suspended during the last update
+    size_t timers   = 0;    // behaviours waiting on a timer
+};
+
+// Cooperative scheduler for NPC behaviours (components CBehaviour).
+// Every tick it visits the awake and reduced NPCs of the activity grid and checks what
+// each is suspended on: Arrive applies the walking velocity and tests the distance,
+// Tick and Visible wait for the NPC's thinking ticks, and only a satisfied condition
+// resumes the behaviour. Timers sit in a min-heap and are not visited until they expire.
+class BehaviourScheduler
+{
+    struct Timer
+    {
+        size_t      tick;
+        size_t      order;      // ties go in the order the timers were set, for determinism
+        Entity *    entity;
+
+        bool operator > (const Timer & rhs) const
+        {
+            return tick != rhs.tick ? tick > rhs.tick : order > rhs.order;
+        }
+    };
+
+    size_t                  m_tick      = 0;
+    size_t                  m_order     = 0;
+    std::vector<Timer>      m_timers;
+    std::vector<Entity *>   m_removed;      // entities to drop from m_timers on the next update
+    BehaviourStats          m_stats;
+
+    void run(Entity & npc, bool thinks, BehaviourContext & context);
+    void suspend(Entity & npc, const Await & await);
+
+public:
+
+    // forget every behaviour, for a new level
+    void reset();
+
+    // an entity removed by the entity manager, its timer is dropped on the next update
+    void remove(Entity * entity);
+
+    // fires expired timers, then runs every awake or reduced NPC's behaviour
+    void update(ActivityGrid & activity, BehaviourContext & context);
+
+    size_t                  tick() const;
+    const BehaviourStats &  getStats() const;
+};
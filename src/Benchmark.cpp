@@ -0,0 +1,1057 @@
+#include "Benchmark.h"
+#include "GameEngine.h"
+#include "EventBus.h"
+#include "Fixed.h"
+#include "Physics.h"
+#include "LevelParser.h"
+#include "ParticleSystem.h"
+#include "BatchSimulation.h"
+#include "Tilemap.h"
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <functional>
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+    #include <psapi.h>
+    #pragma comment(lib, "psapi.lib")
+#else
+    #include <sys/resource.h>
+#endif
+
+size_t Benchmark::PeakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        return (size_t)usage.ru_maxrss * 1024;
+    }
+    return 0;
+#endif
+}
+
+bool Benchmark::MapPreset(const std::string & name, LevelConfig & shape)
+{
+    shape = LevelConfig();
+    if (name == "uniform")      { shape.tileDensity = 0.2f; }
+    else if (name == "sparse")  { shape.tileDensity = 0.02f; }
+    else if (name == "dense")   { shape.tileDensity = 0.6f; }
+    else if (name == "lumpy")   { shape.tileDensity = 0.02f; shape.denseRooms = 0.1f; shape.denseTileDensity = 0.8f; }
+    else                        { return false; }
+    return true;
+}
+
+namespace
+{
+    // Columns are only ever added at the end, and every change bumps the schema. requested is the
+    // tiles and NPCs asked of the generator; since tiles stopped being entities the count of live
+    // entities is its own column, and generated_objects is what the generator actually wrote.
+    const int CsvSchema = 2;
+    const char * CsvHeader = "map,broadphase,requested,live_entities,rooms,ticks,load_ms,ai_us,movement_us,lifespan_us,collision_us,animation_us,tick_us,peak_mb,parse_mb_s,"
+                             "texture_mb,texture_hits,texture_misses,activity,activity_us,awake_npcs,reduced_npcs,asleep_npcs,collision_bodies,pair_tests,vision,fov_casts,"
+                             "tiles,tile_kb,generated_objects,schema";
+}
+
+int Benchmark::Run(const BenchmarkConfig & config)
+{
+    // Runs accumulate in one file for trend tracking, so the header is only written when starting
+    // a new file. A file written with a different header is moved aside rather than appended to,
+    // since its rows would not line up with the new columns.
+    std::string header;
+    std::ifstream existing(config.csvPath);
+    bool newFile = !std::getline(existing, header);
+    existing.close();
+    if (!newFile && header != CsvHeader)
+    {
+        std::string moved;
+        for (int n = 1; moved.empty() || std::ifstream(moved).good(); n++) { moved = config.csvPath + "." + std::to_string(n) + ".old"; }
+        if (std::rename(config.csvPath.c_str(), moved.c_str()) != 0)
+        {
+            std::cerr << "Could not move " << config.csvPath << " with an older header aside" << std::endl;
+            return 1;
+        }
+        std::cout << "Benchmark: " << config.csvPath << " has an older header, moved to " << moved << std::endl;
+        newFile = true;
+    }
+
+    std::ofstream csv(config.csvPath, std::ios::app);
+    if (!csv.good())
+    {
+        std::cerr << "Could not open benchmark output: " << config.csvPath << std::endl;
+        return 1;
+    }
+    if (newFile)
+    {
+        csv << CsvHeader << "\n";
+    }
+
+    GameEngine engine(config.assetsPath, true);
+
+    for (auto & map : config.maps)
+    {
+        LevelConfig shape;
+        if (!MapPreset(map, shape))
+        {
+            std::cerr << "Unknown benchmark map: " << map << std::endl;
+            return 1;
+        }
+        shape.seed = config.seed;
+
+        for (auto size : config.sizes)
+        {
+            auto level      = LevelGenerator::ForEntityCount(size, shape, config.npcFraction);
+            auto levelPath  = "benchmark_level_" + std::to_string(size) + ".txt";
+            size_t generated = 0;
+            if (!LevelGenerator::WriteFile(levelPath, level, &generated)) { return 1; }
+
+            for (auto broadPhase : config.broadPhases)
+            {
+                for (bool activity : config.activity)
+                {
+                    for (bool fieldOfView : config.fieldOfView)
+                    {
+                        auto name   = broadPhase == BroadPhase::Tree ? "tree" : "naive";
+                        auto vision = fieldOfView ? "fov" : "segment";
+                        std::cout << "Benchmark: " << map << " " << name << " activity " << (activity ? "on " : "off ") << vision << " " << generated
+                                  << " tiles and NPCs in " << level.roomsX << "x" << level.roomsY << " rooms" << std::endl;
+
+                        double totals[6] = { 0, 0, 0, 0, 0, 0 };
+                        long long loadTime = 0;
+                        double parseRate = 0;
+                        size_t entities = 0;
+                        ActivityStats npcs;
+                        double bodies = 0, pairTests = 0;
+                        size_t fovCasts = 0;
+                        TilemapStats tilemap;
+                        {
+                            GameState_Play play(engine, levelPath);
+                            play.setBroadPhase(broadPhase);
+                            play.setActivityEnabled(activity);
+                            play.setFieldOfViewEnabled(fieldOfView);
+                            loadTime = play.getSystemTimes().load;
+
+                            auto & parse = play.getParseStats();
+                            parseRate = parse.megabytesPerSecond();
+                            std::cout << "Benchmark: parsed " << parse.bytes / (1024.0 * 1024.0) << " MB on " << parse.threads
+                                      << " threads in " << parse.parseMicros / 1000.0 << " ms, " << parseRate << " MB/s" << std::endl;
+
+                            for (size_t t = 0; t < config.ticks; t++)
+                            {
+                                play.simulate();
+                                auto & times = play.getSystemTimes();
+                                totals[0] += times.ai;
+                                totals[1] += times.movement;
+                                totals[2] += times.lifespan;
+                                totals[3] += times.collision;
+                                totals[4] += times.animation;
+                                totals[5] += times.activity;
+                                bodies    += play.getCollisionStats().bodies;
+                                pairTests += play.getCollisionStats().tests;
+                            }
+                            entities = play.entityCount();
+                            npcs = play.getActivityStats();
+                            fovCasts = play.getFieldOfViewStats().builds;
+                            tilemap = play.getTilemapStats();
+                        }
+
+                        auto & assets = engine.getAssets().getStats();
+                        std::cout << "Benchmark: " << assets.residentTextures << " of " << assets.textures << " textures resident, "
+                                  << assets.residentBytes / (1024.0 * 1024.0) << " MB, " << assets.hits << " hits, " << assets.misses << " misses" << std::endl;
+                        std::cout << "Benchmark: " << npcs.awake << " awake, " << npcs.reduced << " reduced, " << npcs.asleep << " sleeping NPCs" << std::endl;
+
+                        double ticks = config.ticks ? (double)config.ticks : 1.0;
+                        double tick  = (totals[0] + totals[1] + totals[2] + totals[3] + totals[4] + totals[5]) / ticks;
+
+                        csv << map << "," << name << "," << size << "," << entities << "," << level.roomsX * level.roomsY << "," << config.ticks << ","
+                            << loadTime / 1000.0 << ","
+                            << totals[0] / ticks << "," << totals[1] / ticks << "," << totals[2] / ticks << ","
+                            << totals[3] / ticks << "," << totals[4] / ticks << "," << tick << ","
+                            << PeakMemory() / (1024.0 * 1024.0) << "," << parseRate << ","
+                            << assets.residentBytes / (1024.0 * 1024.0) << "," << assets.hits << "," << assets.misses << ","
+                            << (activity ? "on" : "off") << "," << totals[5] / ticks << ","
+                            << npcs.awake << "," << npcs.reduced << "," << npcs.asleep << ","
+                            << bodies / ticks << "," << pairTests / ticks << ","
+                            << vision << "," << fovCasts << ","
+                            << tilemap.tiles << "," << tilemap.bytes / 1024.0 << ","
+                            << generated << "," << CsvSchema << "\n";
+                        csv.flush();
+                    }
+                }
+            }
+
+            std::remove(levelPath.c_str());
+        }
+    }
+
+    return 0;
+}
+
+
+int Benchmark::RunEvents(size_t events)
+{
+    struct Event { size_t sequence; Vec2 pos; };
+    typedef EventBus<1024, Event> Bus;
+
+    Bus    bus;
+    auto & channel  = bus.channel<Event>();
+    bool   ordered  = true;
+
+    auto report = [&](const char * name, sf::Time time)
+    {
+        double seconds = std::max(time.asSeconds(), 1e-6f);
+        std::cout << "Events: " << name << " " << events << " events in " << time.asMilliseconds()
+                  << " ms, " << (size_t)(events / seconds) << " events/sec" << std::endl;
+    };
+
+    // single thread, publishing a full ring and draining it
+    {
+        sf::Clock clock;
+        size_t next = 0;
+        for (size_t sent = 0; sent < events; )
+        {
+            while (sent < events && channel.publish({ sent, Vec2() })) { sent++; }
+            channel.drain([&](const Event & e) { ordered &= e.sequence == next++; });
+        }
+        report("spsc single thread", clock.getElapsedTime());
+    }
+
+    // producer and consumer on separate threads, both yielding when the ring is full or empty
+    {
+        sf::Clock clock;
+        std::thread producer([&]()
+        {
+            for (size_t sent = 0; sent < events; )
+            {
+                if (channel.publish({ sent, Vec2() })) { sent++; }
+                else { std::this_thread::yield(); }
+            }
+        });
+
+        Event event;
+        for (size_t received = 0; received < events; )
+        {
+            if (channel.poll(event)) { ordered &= event.sequence == received++; }
+            else { std::this_thread::yield(); }
+        }
+        producer.join();
+        report("spsc two threads", clock.getElapsedTime());
+    }
+
+    // the same two-thread exchange through a locked deque
+    {
+        std::deque<Event>   queue;
+        std::mutex          mutex;
+        sf::Clock clock;
+        std::thread producer([&]()
+        {
+            for (size_t sent = 0; sent < events; sent++)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.push_back({ sent, Vec2() });
+            }
+        });
+
+        for (size_t received = 0; received < events; )
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!queue.empty())
+            {
+                ordered &= queue.front().sequence == received++;
+                queue.pop_front();
+            }
+        }
+        producer.join();
+        report("mutex deque two threads", clock.getElapsedTime());
+    }
+
+    if (!ordered)
+    {
+        std::cerr << "Events: events arrived out of order" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int Benchmark::RunComponents(size_t entities, size_t iterations)
+{
+    MemoryArena arena(1024 * 1024);
+    TransformPool pool;
+    EntityManager manager(&arena);
+    for (size_t i = 0; i < entities; i++)
+    {
+        auto e = manager.addEntity("npc");
+        e->addComponent<CTransform>(Vec2((float)i, (float)(i % 100)), &pool);
+        e->addComponent<CBoundingBox>(Vec2(64, 64), true, false);
+    }
+    manager.update();
+
+    // the sum is printed so the reads cannot be optimised away
+    float sum = 0;
+    auto run = [&](const char * name, std::function<void()> pass)
+    {
+        sf::Clock clock;
+        for (size_t i = 0; i < iterations; i++) { pass(); }
+        double ns = clock.getElapsedTime().asMicroseconds() * 1000.0 / ((double)entities * iterations);
+        std::cout << "Components: " << name << " " << ns << " ns/entity" << std::endl;
+    };
+
+    run("dynamic_pointer_cast", [&]()
+    {
+        // the access path before the compile-time registry, a reference-counted copy plus a checked cast
+        for (auto & e : manager.getEntities("npc"))
+        {
+            std::shared_ptr<Component> transform = e->getComponent<CTransform>();
+            std::shared_ptr<Component> box       = e->getComponent<CBoundingBox>();
+            sum += std::dynamic_pointer_cast<CTransform>(transform)->pos().x + std::dynamic_pointer_cast<CBoundingBox>(box)->halfSize.x;
+        }
+    });
+
+    run("getComponent", [&]()
+    {
+        for (auto & e : manager.getEntities("npc"))
+        {
+            sum += e->getComponent<CTransform>()->pos().x + e->getComponent<CBoundingBox>()->halfSize.x;
+        }
+    });
+
+    run("get", [&]()
+    {
+        for (auto & e : manager.getEntities("npc"))
+        {
+            sum += e->get<CTransform>().pos().x + e->get<CBoundingBox>().halfSize.x;
+        }
+    });
+
+    run("forEach", [&]()
+    {
+        manager.forEach<CTransform, CBoundingBox>("npc", [&](Entity &, CTransform & transform, CBoundingBox & box)
+        {
+            sum += transform.pos().x + box.halfSize.x;
+        });
+    });
+
+    std::cout << "Components: checksum " << sum << std::endl;
+    return 0;
+}
+
+int Benchmark::RunTransforms(size_t entities, size_t ticks)
+{
+    // what every transform used to be: its hot data inside a heap object with the cold fields
+    struct ObjectTransform
+    {
+        virtual ~ObjectTransform() {}
+        Vec2    pos, prevPos, speed;
+        Vec2    scale   = { 1, 1 };
+        Vec2    facing  = { 1, 0 };
+        float   angle   = 0;
+    };
+
+    MemoryArena     arena(1024 * 1024);
+    TransformPool   pool;
+    EntityManager   pooled(&arena);
+    std::vector<std::unique_ptr<ObjectTransform>> objects;
+    for (size_t i = 0; i < entities; i++)
+    {
+        Vec2 pos((float)i, (float)(i % 100));
+        Vec2 speed((float)(i % 3) - 1, (float)(i % 5) - 2);
+        objects.emplace_back(new ObjectTransform());
+        objects.back()->pos     = pos;
+        objects.back()->speed   = speed;
+        pooled.addEntity("npc")->addComponent<CTransform>(pos, speed, Vec2(1, 1), 0, &pool);
+    }
+    pooled.update();
+
+    auto report = [&](const char * name, sf::Time time, size_t bytes)
+    {
+        std::cout << "Transforms: " << name << " " << entities << " entities, "
+                  << time.asMicroseconds() / (double)std::max<size_t>(ticks, 1) << " us/tick, "
+                  << bytes << " bytes touched per entity" << std::endl;
+    };
+
+    // the loop every system used to run: a pointer, then the transform object
+    // counted as the pointer plus a cache line for the transform
+    sf::Clock clock;
+    for (size_t t = 0; t < ticks; t++)
+    {
+        for (auto & transform : objects)
+        {
+            transform->prevPos = transform->pos;
+            transform->pos += transform->speed;
+        }
+    }
+    report("component objects", clock.getElapsedTime(), sizeof(void *) + 64);
+
+    clock.restart();
+    for (size_t t = 0; t < ticks; t++)
+    {
+        pool.integrate();
+    }
+    report("pooled arrays", clock.getElapsedTime(), pool.bytesPerSlot());
+
+    // both paths must have produced the same positions
+    auto & b = pooled.getEntities("npc");
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        if (objects[i]->pos != b[i]->get<CTransform>().pos())
+        {
+            std::cerr << "Transforms: results differ at entity " << i << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "Transforms: sizeof(CTransform) " << sizeof(CTransform) << " bytes" << std::endl;
+    return 0;
+}
+
+int Benchmark::RunVec2(size_t points, size_t iterations)
+{
+    std::vector<Vec2> pos(points), speed(points), target(points);
+    for (size_t i = 0; i < points; i++)
+    {
+        pos[i]      = Vec2((float)(i % 1280), (float)(i % 768));
+        speed[i]    = Vec2((float)(i % 3) - 1, (float)(i % 5) - 2);
+        target[i]   = pos[i] + Vec2((float)(i % 7), (float)(i % 11));
+    }
+
+    // the counts are printed so the loops cannot be optimised away
+    size_t arrived = 0;
+    auto run = [&](const char * name, std::function<void()> pass)
+    {
+        sf::Clock clock;
+        for (size_t i = 0; i < iterations; i++) { pass(); }
+        double ns = clock.getElapsedTime().asMicroseconds() * 1000.0 / ((double)points * iterations);
+        std::cout << "Vec2: " << name << " " << ns << " ns/point" << std::endl;
+    };
+
+    run("patrol check dist", [&]()
+    {
+        for (size_t i = 0; i < points; i++) { arrived += (pos[i] + speed[i]).dist(target[i]) <= 5; }
+    });
+
+    run("patrol check distSq", [&]()
+    {
+        for (size_t i = 0; i < points; i++) { arrived += (pos[i] + speed[i]).distSq(target[i]) <= 5 * 5; }
+    });
+
+    run("movement per element", [&]()
+    {
+        for (size_t i = 0; i < points; i++) { pos[i] += speed[i]; }
+    });
+
+    run("movement batch", [&]()
+    {
+        Vec2Batch::Add(pos.data(), pos.data(), speed.data(), points);
+    });
+
+    run("clamp to room batch", [&]()
+    {
+        Vec2Batch::Clamp(pos.data(), pos.data(), Vec2(0, 0), Vec2(1280, 768), points);
+    });
+
+    std::cout << "Vec2: checksum " << arrived << " " << Vec2Batch::CountWithin(pos.data(), points, Vec2(640, 384), 200.0f) << std::endl;
+    return 0;
+}
+
+namespace
+{
+    uint64_t HashBytes(uint64_t hash, const void * data, size_t size)
+    {
+        auto bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++) { hash = (hash ^ bytes[i]) * 1099511628211ull; }
+        return hash;
+    }
+
+    // the same player input for every run: a direction held for a while, or none, and a sword swing now and then
+    std::vector<uint8_t> ScriptedInput(size_t ticks)
+    {
+        std::vector<uint8_t> inputs(ticks);
+        uint32_t seed = 12345;
+        auto random = [&]() { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return seed; };
+        uint8_t held = 0;
+        for (size_t t = 0; t < ticks; t++)
+        {
+            if (t % 45 == 0) { held = (uint8_t)(random() % 5); }
+            inputs[t] = held | (random() % 20 == 0 ? 8 : 0);
+        }
+        return inputs;
+    }
+
+    void ApplyInput(GameState_Play & play, uint8_t input)
+    {
+        uint8_t held = input & 7;
+        play.setPlayerInput(held == 1, held == 2, held == 3, held == 4, (input & 8) != 0);
+    }
+}
+
+int Benchmark::RunDeterminism(const std::vector<std::string> & levels, size_t ticks)
+{
+    GameEngine engine("assets.txt", true);
+
+    auto inputs = ScriptedInput(ticks);
+
+    typedef std::vector<std::pair<size_t, Vec2>> Positions;
+    auto run = [&](const std::string & level, bool deterministic, std::vector<Positions> & trace)
+    {
+        GameState_Play play(engine, level);
+        play.setDeterministic(deterministic);
+
+        uint64_t hash = 14695981039346656037ull;
+        trace.assign(ticks, Positions());
+        for (size_t t = 0; t < ticks; t++)
+        {
+            ApplyInput(play, inputs[t]);
+            play.simulate();
+            uint64_t tick = play.simulationHash();
+            hash = HashBytes(hash, &tick, sizeof(tick));
+            play.entityPositions(trace[t]);
+        }
+        return hash;
+    };
+
+    int result = 0;
+    for (auto & level : levels)
+    {
+        std::vector<Positions> floats, fixeds, again;
+        sf::Clock clock;
+        uint64_t floatHash  = run(level, false, floats);
+        long long floatMs   = clock.restart().asMilliseconds();
+        uint64_t fixedHash  = run(level, true, fixeds);
+        long long fixedMs   = clock.restart().asMilliseconds();
+
+        // the same entity in both runs, matched by id, since a kill in one run shifts every later spawn
+        float divergence = 0;
+        size_t unmatched = 0;
+        for (size_t t = 0; t < ticks; t++)
+        {
+            auto & a = floats[t];
+            auto & b = fixeds[t];
+            size_t i = 0, j = 0;
+            while (i < a.size() && j < b.size())
+            {
+                if (a[i].first < b[j].first)        { unmatched++; i++; }
+                else if (b[j].first < a[i].first)   { unmatched++; j++; }
+                else { divergence = std::max(divergence, a[i++].second.dist(b[j++].second)); }
+            }
+            unmatched += (a.size() - i) + (b.size() - j);
+        }
+
+        std::cout << "Determinism: " << level << " " << (fixeds.empty() ? 0 : fixeds.back().size()) << " entities, " << ticks
+                  << " ticks in " << floatMs << " ms float, " << fixedMs << " ms fixed" << std::endl;
+        std::cout << "Determinism: max float/fixed divergence " << divergence << " px, " << unmatched << " entity ticks in only one run" << std::endl;
+        std::cout << "Determinism: float trajectory hash " << std::hex << floatHash << ", fixed trajectory hash " << fixedHash << std::dec << std::endl;
+
+        // a second fixed run has to repeat the first bit for bit
+        if (run(level, true, again) != fixedHash)
+        {
+            std::cerr << "Determinism: " << level << " gave two different fixed-point runs" << std::endl;
+            result = 1;
+        }
+    }
+    return result;
+}
+
+int Benchmark::RunAllocations(const std::vector<std::string> & levels, size_t warmup, size_t ticks)
+{
+    GameEngine engine("assets.txt", true);
+    auto inputs = ScriptedInput(warmup + ticks);
+
+    // Containers, arenas and pools grow to their high-water marks while warming up, which takes
+    // a respawn or two and the busiest fights of the script; after that every tick of the
+    // simulation thread has to run without the heap
+    int result = 0;
+    for (auto & level : levels)
+    {
+        GameState_Play play(engine, level);
+        size_t total = 0, ticksAllocating = 0, firstTick = 0, worst = 0;
+        for (size_t t = 0; t < warmup + ticks; t++)
+        {
+            // a swing spawns the sword outside the tick, so the count spans both
+            size_t heapAllocations = GetHeapAllocationCount();
+            ApplyInput(play, inputs[t]);
+            play.tick();
+
+            size_t allocations = GetHeapAllocationCount() - heapAllocations;
+            if (t < warmup || allocations == 0) { continue; }
+            if (ticksAllocating++ == 0) { firstTick = t; }
+            total += allocations;
+            worst = std::max(worst, allocations);
+        }
+
+        std::cout << "Allocations: " << level << " " << play.entityCount() << " entities, " << ticks << " ticks after " << warmup << " warm-up ticks, "
+                  << total << " heap allocations in " << ticksAllocating << " ticks, at most " << worst << " in one tick, level arena "
+                  << play.getMemoryStats().levelBytes / 1024 << " KB" << std::endl;
+
+        if (total > 0)
+        {
+            std::cerr << "Allocations: " << level << " allocated on the heap after warming up, first at tick " << firstTick << std::endl;
+            result = 1;
+        }
+    }
+    return result;
+}
+
+namespace
+{
+    // the smallest scripts for measuring the scheduler itself: one waits on a long timer,
+    // one waits to see the player, one is resumed every tick like the old per-frame branches
+    class TimerBehaviour : public Behaviour
+    {
+    public:
+        Await resume(Entity & npc, BehaviourContext & context) override { return Await::WaitTicks(context.tick, 1000 + npc.id() % 1000); }
+    };
+
+    class VisibleBehaviour : public Behaviour
+    {
+    public:
+        Await resume(Entity &, BehaviourContext &) override { return Await::UntilVisible(); }
+    };
+
+    class PollBehaviour : public Behaviour
+    {
+    public:
+        Await resume(Entity &, BehaviourContext & context) override { return Await::NextTick(context.tick); }
+    };
+}
+
+int Benchmark::RunBehaviours(size_t behaviours, size_t ticks)
+{
+    auto run = [&](const char * name, std::function<std::shared_ptr<Behaviour>(MemoryArena &)> make)
+    {
+        MemoryArena         arena(1024 * 1024);
+        TransformPool       pool;
+        EntityManager       manager(&arena);
+        ActivityGrid        activity;
+        BehaviourScheduler  scheduler;
+
+        // every NPC awake, so the scheduler visits all of them
+        activity.reset(Vec2(1280, 768));
+        activity.setEnabled(false);
+        for (size_t i = 0; i < behaviours; i++)
+        {
+            auto npc = manager.addEntity("npc");
+            npc->addComponent<CTransform>(Vec2((float)(i % 1280), (float)(i % 768)), &pool);
+            npc->addComponent<CActivity>();
+            npc->addComponent<CBehaviour>(make(arena));
+        }
+        manager.update();
+        for (auto & npc : manager.getEntities("npc")) { activity.insert(npc.get()); }
+
+        BehaviourContext context;
+        context.canSeePlayer = [](Entity &) { return false; };
+
+        // the first update starts every behaviour, the measured ones find them all suspended;
+        // nothing moves between rooms, so the activity grid is only updated once
+        activity.update(Vec2(0, 0));
+        scheduler.update(activity, context);
+
+        size_t resumed = 0;
+        sf::Clock clock;
+        for (size_t t = 0; t < ticks; t++)
+        {
+            scheduler.update(activity, context);
+            resumed += scheduler.getStats().resumed;
+        }
+        double ns = clock.getElapsedTime().asMicroseconds() * 1000.0 / ((double)behaviours * std::max<size_t>(ticks, 1));
+        std::cout << "Behaviours: " << name << " " << behaviours << " behaviours, " << ns << " ns/behaviour/tick, "
+                  << resumed << " resumes, " << arena.bytesUsed() / behaviours << " arena bytes/NPC" << std::endl;
+    };
+
+    run("waiting on timers", [](MemoryArena & arena) { return std::allocate_shared<TimerBehaviour>(ArenaAllocator<TimerBehaviour>(&arena)); });
+    run("waiting until visible", [](MemoryArena & arena) { return std::allocate_shared<VisibleBehaviour>(ArenaAllocator<VisibleBehaviour>(&arena)); });
+    run("resumed every tick", [](MemoryArena & arena) { return std::allocate_shared<PollBehaviour>(ArenaAllocator<PollBehaviour>(&arena)); });
+    return 0;
+}
+
+int Benchmark::RunParticles(size_t particles, size_t ticks)
+{
+    // the frame layout of the explosion sheet, the pixels do not matter here
+    sf::Texture texture;
+    Animation   animation("Particle", texture, 8, 4);
+
+    // lives of 30 to 50 ticks, so a burst of a fortieth of the target per tick holds it steady
+    ParticleEmitter burst;
+    burst.count     = std::max<size_t>(1, particles / 40);
+    burst.speedMin  = 1;
+    burst.speedMax  = 4;
+    burst.lifeMin   = 30;
+    burst.lifeMax   = 50;
+    burst.drag      = 0.98f;
+
+    auto run = [&](const char * name, bool vectorized)
+    {
+        ParticleSystem system;
+        system.setVectorized(vectorized);
+        for (size_t t = 0; t < 60; t++)
+        {
+            system.emit(animation, Vec2((float)(t % 20) * 64, 384), burst);
+            system.update();
+        }
+
+        std::vector<sf::Vertex>     vertices;
+        std::vector<ParticleBatch>  batches;
+        AABB        view(Vec2(-1e6f, -1e6f), Vec2(1e6f, 1e6f));
+        long long   update = 0, draw = 0;
+        size_t      live = 0;
+        for (size_t t = 0; t < ticks; t++)
+        {
+            system.emit(animation, Vec2((float)(t % 20) * 64, 384), burst);
+            system.update();
+            update  += system.getStats().updateMicros;
+            live    += system.live();
+
+            sf::Clock clock;
+            vertices.clear();
+            batches.clear();
+            system.draw(view, vertices, batches);
+            draw += clock.getElapsedTime().asMicroseconds();
+        }
+
+        double n = (double)std::max<size_t>(ticks, 1);
+        std::cout << "Particles: " << name << " " << (size_t)(live / n) << " live, " << update / n << " us/tick update ("
+                  << update * 1000.0 / std::max<double>(live, 1) << " ns/particle), " << draw / n << " us/tick vertices, "
+                  << batches.size() << " draw calls" << std::endl;
+
+        // order independent sum of the final state
+        double sum = 0;
+        for (size_t i = 0; i < vertices.size(); i++) { sum += vertices[i].position.x + vertices[i].position.y; }
+        return sum;
+    };
+
+    double vectorized   = run("sse2", true);
+    double scalar       = run("scalar", false);
+    if (vectorized != scalar)
+    {
+        std::cerr << "Particles: the vectorized and scalar kernels differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int Benchmark::RunBatch(const std::string & levelPath, size_t worlds, size_t ticks)
+{
+    GameEngine engine("assets.txt", true);
+    BatchLevel level;
+    if (!level.load(levelPath, engine.getAssets(), Vec2((float)engine.windowSize().x, (float)engine.windowSize().y))) { return 1; }
+
+    // every world holds a random direction for a while and swings the sword now and then
+    std::vector<std::vector<uint8_t>> inputs(ticks, std::vector<uint8_t>(worlds));
+    uint32_t seed = 12345;
+    auto random = [&]() { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return seed; };
+    std::vector<uint8_t> held(worlds);
+    for (size_t t = 0; t < ticks; t++)
+    {
+        for (size_t w = 0; w < worlds; w++)
+        {
+            if (t % 30 == 0) { held[w] = (uint8_t)(1 << (random() % 4)); }
+            inputs[t][w] = held[w] | (random() % 16 == 0 ? BatchInput::Attack : 0);
+        }
+    }
+
+    auto run = [&](size_t threads)
+    {
+        BatchSimulation batch(level, worlds, threads);
+        for (auto & input : inputs) { batch.step(input.data()); }
+
+        uint64_t deaths = 0, kills = 0;
+        for (size_t w = 0; w < worlds; w++) { deaths += batch.deaths(w); kills += batch.kills(w); }
+
+        auto & stats = batch.getStats();
+        std::cout << "Batch: " << levelPath << " " << worlds << " worlds of " << level.npcs.size() << " NPCs on " << stats.threads << " threads, "
+                  << stats.worldTicksPerSecond() / 1000000.0 << " M world ticks/s, "
+                  << stats.worldTicksPerSecond() * level.npcs.size() / 1000000.0 << " M NPC ticks/s, "
+                  << deaths << " deaths, " << kills << " kills" << std::endl;
+        return batch.hash();
+    };
+
+    uint64_t single = run(1);
+    uint64_t all    = run(0);
+    if (single != all)
+    {
+        std::cerr << "Batch: the threaded run ended in a different state" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int Benchmark::RunTilemap(size_t width, size_t height)
+{
+    GameEngine engine("assets.txt", true);
+    auto & assets = engine.getAssets();
+
+    // rooms of the window's size in tiles, walled with rock and floored with black tiles
+    Tilemap tilemap;
+    auto rock   = tilemap.addType(assets.getAnimation("RockBM"), true, true, CollisionLayer::Tile, CollisionLayer::None);
+    auto ground = tilemap.addType(assets.getAnimation("Black"), false, false, CollisionLayer::None, CollisionLayer::None);
+    GridCell room((int)(engine.windowSize().x / tilemap.cellSize().x), (int)(engine.windowSize().y / tilemap.cellSize().y));
+
+    sf::Clock clock;
+    for (int y = 0; y < (int)height; y++)
+    {
+        for (int x = 0; x < (int)width; x++)
+        {
+            int rx = x % room.x, ry = y % room.y;
+            bool wall = rx == 0 || ry == 0 || rx == room.x - 1 || ry == room.y - 1;
+            tilemap.set(GridCell(x, y), wall ? rock : ground);
+        }
+    }
+    long long fill = clock.restart().asMicroseconds();
+    tilemap.compress();
+    long long compress = clock.restart().asMicroseconds();
+
+    auto stats = tilemap.stats();
+    std::cout << "Tilemap: " << width << "x" << height << " tiles, " << stats.chunks << " chunks, " << stats.denseChunks << " dense, "
+              << stats.runChunks << " runs, " << stats.bytes / (1024.0 * 1024.0) << " MB, " << stats.bytesPerTile() << " bytes/tile, filled in "
+              << fill / 1000.0 << " ms, compressed in " << compress / 1000.0 << " ms" << std::endl;
+
+    // the queries of a tick: tiles under a view, tiles touching a moving box, and a line of sight
+    uint32_t seed = 12345;
+    auto random = [&](float range) { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return (seed % 1000000) / 1000000.0f * range; };
+    Vec2 world(width * tilemap.cellSize().x, height * tilemap.cellSize().y);
+    Vec2 view((float)engine.windowSize().x, (float)engine.windowSize().y);
+    const size_t queries = 10000;
+
+    size_t visited = 0;
+    for (size_t q = 0; q < queries; q++)
+    {
+        Vec2 min(random(world.x - view.x), random(world.y - view.y));
+        tilemap.forEach(AABB(min, min + view), [&](const GridCell &, const TileType &) { visited++; });
+    }
+    double viewNs = clock.restart().asMicroseconds() * 1000.0 / queries;
+
+    size_t touched = 0;
+    for (size_t q = 0; q < queries; q++)
+    {
+        Vec2 min(random(world.x - 64), random(world.y - 64));
+        tilemap.forEach(AABB(min, min + Vec2(64, 64)), [&](const GridCell &, const TileType & type) { touched += type.blockMove; });
+    }
+    double boxNs = clock.restart().asMicroseconds() * 1000.0 / queries;
+
+    size_t blocked = 0;
+    for (size_t q = 0; q < queries; q++)
+    {
+        Vec2 a(random(world.x), random(world.y));
+        Vec2 b(std::min(world.x, a.x + random(view.x) - view.x / 2), std::min(world.y, a.y + random(view.y) - view.y / 2));
+        blocked += tilemap.blocksVision(a, b);
+    }
+    double sightNs = clock.restart().asMicroseconds() * 1000.0 / queries;
+
+    std::cout << "Tilemap: " << viewNs / 1000.0 << " us/view (" << visited / queries << " tiles), " << boxNs << " ns/box ("
+              << (double)touched / queries << " blocking), " << sightNs << " ns/line of sight (" << blocked * 100.0 / queries << "% blocked)" << std::endl;
+    return 0;
+}
+
+int Benchmark::RunCommands(size_t entities, size_t threads, size_t ticks)
+{
+    threads = std::max<size_t>(threads, 1);
+
+    // one run of the stress: every tick each worker spawns its share of particles and
+    // destroys its slice of the last tick's, adding and removing components on the way;
+    // returns a hash of the final entities to compare runs
+    auto run = [&](long long & recording, long long & playback, size_t & commands)
+    {
+        TransformPool pool;
+        EntityManager manager;
+        manager.reserveCommandBuffers(threads);
+
+        for (size_t t = 0; t < ticks; t++)
+        {
+            auto & previous = manager.getEntities("particle");
+            sf::Clock clock;
+            std::vector<std::thread> workers;
+            for (size_t w = 0; w < threads; w++)
+            {
+                workers.emplace_back([&, w]()
+                {
+                    auto & buffer = manager.commandBuffer(w);
+                    for (size_t i = w; i < previous.size(); i += threads)
+                    {
+                        if (i % 2) { buffer.destroy(previous[i].get()); }
+                        else       { buffer.removeComponent<CGravity>(previous[i].get()); }
+                    }
+                    for (size_t i = w; i < entities; i += threads)
+                    {
+                        auto particle = buffer.create("particle");
+                        buffer.addComponent<CTransform>(particle, Vec2((float)i, (float)t), &pool);
+                        buffer.addComponent<CGravity>(particle, 0.5f);
+                    }
+                });
+            }
+            for (auto & worker : workers) { worker.join(); }
+            recording += clock.getElapsedTime().asMicroseconds();
+
+            for (size_t w = 0; w < threads; w++) { commands += manager.commandBuffer(w).size(); }
+
+            clock.restart();
+            manager.update();
+            playback += clock.getElapsedTime().asMicroseconds();
+        }
+
+        uint64_t hash = 14695981039346656037ull;
+        for (auto & e : manager.getEntities())
+        {
+            float values[3] = { (float)e->id(), e->get<CTransform>().pos().x, e->hasComponent<CGravity>() ? 1.0f : 0.0f };
+            hash = HashBytes(hash, values, sizeof(values));
+        }
+        std::cout << "Commands: " << manager.getEntities().size() << " entities alive, hash " << std::hex << hash << std::dec << std::endl;
+        return hash;
+    };
+
+    long long recording = 0, playback = 0;
+    size_t commands = 0;
+    auto first  = run(recording, playback, commands);
+    auto second = run(recording, playback, commands);
+
+    std::cout << "Commands: " << threads << " threads, " << entities * ticks * 2 << " entities spawned, "
+              << commands << " commands, recorded at " << commands / std::max<double>((double)recording, 1) << " M/s, "
+              << "played back at " << commands / std::max<double>((double)playback, 1) << " M/s" << std::endl;
+
+    if (first != second)
+    {
+        std::cerr << "Commands: the two runs ended in different states" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int Benchmark::RunSweep(size_t cases)
+{
+    uint32_t seed = 12345;
+    auto random = [&](float low, float high) { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return low + (seed % 1000000) / 1000000.0f * (high - low); };
+
+    struct Box { Vec2 pos, halfSize; };
+    auto overlapping = [](const Vec2 & pos, const Vec2 & halfSize, const Box & box, float tolerance)
+    {
+        auto overlap = Physics::Overlap(pos, halfSize, box.pos, box.halfSize);
+        return overlap.x > tolerance && overlap.y > tolerance;
+    };
+
+    // The box is moved by a whole tick and by four quarter ticks against the same walls. Both must
+    // stay out of every wall along the whole path, and where the box stays against every face it hit,
+    // the remaining move slid the same way in both and they must end in the same place.
+    const float tolerance = 0.05f;
+    size_t compared = 0, slidOff = 0, tunnelled = 0, mismatched = 0;
+    float worst = 0;
+    sf::Clock clock;
+
+    for (size_t c = 0; c < cases; c++)
+    {
+        // thin walls and big blocks around the origin, and a box starting outside all of them
+        std::vector<Box> walls((size_t)random(1, 8));
+        for (auto & wall : walls)
+        {
+            bool thin = random(0, 1) < 0.5f;
+            wall.pos        = Vec2(random(-300, 300), random(-300, 300));
+            wall.halfSize   = thin ? (random(0, 1) < 0.5f ? Vec2(random(0.5f, 2), random(8, 200)) : Vec2(random(8, 200), random(0.5f, 2)))
+                                   : Vec2(random(4, 64), random(4, 64));
+        }
+
+        Box mover = { Vec2(), Vec2(random(2, 32), random(2, 32)) };
+        bool clear = false;
+        for (int attempt = 0; attempt < 100 && !clear; attempt++)
+        {
+            mover.pos   = Vec2(random(-400, 400), random(-400, 400));
+            clear       = std::none_of(walls.begin(), walls.end(), [&](const Box & wall) { return overlapping(mover.pos, mover.halfSize, wall, 0); });
+        }
+        if (!clear) { continue; }
+
+        // far enough per tick to cross any wall several times over
+        Vec2 delta(random(-900, 900), random(-900, 900));
+        if (random(0, 1) < 0.2f) { (random(0, 1) < 0.5f ? delta.x : delta.y) = 0; }
+
+        // every slide starts where the previous one stopped, so the path is the chain of those starts
+        std::vector<Vec2> path;
+        auto move = [&](const Vec2 & start, const Vec2 & step)
+        {
+            return Physics::SlideMove(start, mover.halfSize, step, [&](const Vec2 & from, const Vec2 &, auto && visit)
+            {
+                path.push_back(from);
+                for (auto & wall : walls) { visit(wall.pos, wall.halfSize); }
+            });
+        };
+
+        // the skin leaves the box just short of each face it hits, so the walls it stopped against
+        // are the ones it touches, give or take the skin, where a slide ended
+        auto touching = [&](const Vec2 & at, const Box & wall)
+        {
+            auto overlap = Physics::Overlap(at, mover.halfSize, wall.pos, wall.halfSize);
+            return overlap.x > -0.02f && overlap.y > -0.02f;
+        };
+
+        path.clear();
+        Vec2 once = move(mover.pos, delta);
+        path.push_back(once);
+        std::vector<size_t> hits;
+        for (size_t w = 0; w < walls.size(); w++)
+        {
+            if (std::any_of(path.begin() + 1, path.end(), [&](const Vec2 & at) { return touching(at, walls[w]); })) { hits.push_back(w); }
+        }
+        auto onceChain = path;
+
+        path.clear();
+        Vec2 quarters = mover.pos;
+        for (int q = 0; q < 4; q++) { quarters = move(quarters, delta / 4); path.push_back(quarters); }
+        auto quartersChain = path;
+
+        // walk both paths in steps shorter than the thinnest wall and fail on any overlap
+        auto tunnels = [&](const std::vector<Vec2> & chain)
+        {
+            for (size_t p = 1; p < chain.size(); p++)
+            {
+                Vec2 step   = chain[p] - chain[p - 1];
+                int samples = 1 + (int)(std::max(fabsf(step.x), fabsf(step.y)) / 0.25f);
+                for (int s = 0; s <= samples; s++)
+                {
+                    Vec2 at = chain[p - 1] + step * ((float)s / samples);
+                    for (auto & wall : walls)
+                    {
+                        if (overlapping(at, mover.halfSize, wall, tolerance)) { return true; }
+                    }
+                }
+            }
+            return false;
+        };
+        if (tunnels(onceChain) || tunnels(quartersChain))
+        {
+            if (tunnelled++ == 0)
+            {
+                std::cerr << "Sweep: case " << c << " box " << mover.halfSize.x << "x" << mover.halfSize.y << " at " << mover.pos.x << "," << mover.pos.y
+                          << " moving " << delta.x << "," << delta.y << " passed into a wall" << std::endl;
+            }
+            continue;
+        }
+
+        // a box that slid off the end of a face keeps its whole velocity only while quarter stepping
+        // touching an end of the face only is already off it
+        bool stayed = std::all_of(hits.begin(), hits.end(), [&](size_t w)
+        {
+            auto overlap = Physics::Overlap(once, mover.halfSize, walls[w].pos, walls[w].halfSize);
+            return touching(once, walls[w]) && std::max(overlap.x, overlap.y) > tolerance;
+        });
+        if (!stayed) { slidOff++; continue; }
+
+        compared++;
+        float difference = std::max(fabsf(once.x - quarters.x), fabsf(once.y - quarters.y));
+        worst = std::max(worst, difference);
+        if (difference > tolerance && mismatched++ == 0)
+        {
+            std::cerr << "Sweep: case " << c << " box " << mover.halfSize.x << "x" << mover.halfSize.y << " at " << mover.pos.x << "," << mover.pos.y
+                      << " moving " << delta.x << "," << delta.y << " ended at " << once.x << "," << once.y << " in one step and "
+                      << quarters.x << "," << quarters.y << " in four" << std::endl;
+        }
+    }
+
+    std::cout << "Sweep: " << cases << " cases in " << clock.getElapsedTime().asMilliseconds() << " ms, " << compared << " compared, "
+              << slidOff << " slid off a face, largest difference " << worst << " px, " << tunnelled << " tunnelled, "
+              << mismatched << " mismatched" << std::endl;
+    return tunnelled || mismatched ? 1 : 0;
+}
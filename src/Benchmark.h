@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Common.h"
+#include "GameState_Play.h"
+#include "LevelGenerator.h"
+
+struct BenchmarkConfig
+{
+    std::string         assetsPath  = "assets.txt";
+    std::string         csvPath     = "benchmark.csv";
+    std::vector<size_t> sizes       = { 1000, 10000, 100000, 1000000 };
+    size_t              ticks       = 60;
+    float               npcFraction = 0.01f;
+    unsigned            seed        = 1;
+
+    // map presets: uniform, sparse, dense, lumpy (mostly empty rooms with a few packed dungeons)
+    std::vector<std::string>    maps        = { "uniform" };
+    std::vector<BroadPhase>     broadPhases = { BroadPhase::Naive, BroadPhase::Tree };
+
+    // with activity off every NPC is simulated every tick, for comparing against room sleeping
+    std::vector<bool>           activity    = { true };
+
+    // with the field of view off NPCs test their line of sight against the blockers, for comparing
+    std::vector<bool>           fieldOfView = { true };
+};
+
+// Headless benchmark: for every map preset and size in the ladder a stress level is
+// generated, then loaded and simulated without a window once per broad phase, and
+// one CSV row is appended per run with the
+// load time, average tick time per system, the process's peak memory so far
+// (sizes should be run in ascending order for the peak column to be meaningful),
+// the level parser's throughput in MB/s, the texture residency counters so far, and
+// how many NPCs were awake, reduced and asleep on the last tick, the average number of
+// collision bodies and layer-filtered pair tests per tick, and how NPCs tested their line
+// of sight with how many times the player's field of view was cast, and the level's tile
+// count with the kilobytes its tilemap takes. Rows end with the schema version of the
+// columns; a file with a different header is moved aside and a new one started.
+namespace Benchmark
+{
+    int Run(const BenchmarkConfig & config);
+
+    // event bus throughput: pushes the given number of events through one channel on a
+    // single thread, then across two threads, and a mutex-guarded deque for comparison,
+    // printing events per second for each
+    int RunEvents(size_t events);
+
+    // component access hot path: reads CTransform and CBoundingBox from every entity
+    // through the old runtime-checked cast, getComponent, get and forEach, printing the
+    // time per entity for each
+    int RunComponents(size_t entities, size_t iterations);
+
+    // movement integration: moves the given number of entities for a number of ticks
+    // through their CTransform objects and through the pooled hot arrays, printing the
+    // time per tick and the bytes touched per entity for each
+    int RunTransforms(size_t entities, size_t ticks);
+
+    // vector math inner loops of sAI and sMovement over the given number of points: the patrol
+    // arrival check with dist and with distSq, and position updates per element and through
+    // Vec2Batch, printing the time per point for each
+    int RunVec2(size_t points, size_t iterations);
+
+    // behaviour scheduler overhead: the given number of NPCs suspended on a timer, suspended
+    // until they see the player, and resumed every tick, printing the time per behaviour per tick
+    int RunBehaviours(size_t behaviours, size_t ticks);
+
+    // command buffer stress: the given number of worker threads spawn the given number of
+    // entities per tick through their command buffers and destroy half of the last tick's,
+    // twice over, printing the recording and playback rates and failing if the two runs
+    // did not end in the same state
+    int RunCommands(size_t entities, size_t threads, size_t ticks);
+
+    // particle system: keeps about the given number of particles alive by emitting a burst every
+    // tick, with the SSE2 kernel and with the scalar one, printing the update and vertex building
+    // time per tick and per particle for each, and failing if the two ended in different states
+    int RunParticles(size_t particles, size_t ticks);
+
+    // batch simulation: steps the given number of worlds of a level in lockstep with random
+    // buttons per world, on one thread and on every core, printing world ticks per second for
+    // each and failing if the two ended in different states
+    int RunBatch(const std::string & level, size_t worlds, size_t ticks);
+
+    // tilemap storage: fills a map of the given size in tiles with walled rooms, compresses it
+    // and prints the bytes per tile and chunk counts, then the time of view, box and line of
+    // sight queries over it
+    int RunTilemap(size_t width, size_t height);
+
+    // swept tile collision fuzz: moves random boxes at speeds far above their size against random
+    // thin walls and blocks, once by a whole tick and again in four quarter steps, failing if
+    // either path ever overlaps a wall or the two end in different places where the box stayed
+    // against every face it hit
+    int RunSweep(size_t cases);
+
+    // steady-state allocation check: plays each level with scripted player input through the
+    // simulation thread's tick, and after the warm-up ticks counts every global operator new,
+    // failing if any tick of the measured ones allocated
+    int RunAllocations(const std::vector<std::string> & levels, size_t warmup, size_t ticks);
+
+    // deterministic mode check: plays each level through GameState_Play with the same scripted
+    // player input in float and in deterministic Fixed mode, printing the largest distance
+    // between the two trajectories of every entity and a hash of each, so the fixed hash can be
+    // compared between builds and machines, and failing if two fixed runs differ
+    int RunDeterminism(const std::vector<std::string> & levels, size_t ticks);
+
+    // level shape for a map preset name, false if the name is unknown
+    bool MapPreset(const std::string & name, LevelConfig & shape);
+
+    // peak resident memory of the process in bytes, 0 if unavailable
+    size_t PeakMemory();
+}
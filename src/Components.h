@@ -2,8 +2,12 @@
 
 #include <bitset>
 #include <array>
+#include <type_traits>
 #include "Animation.h"
 #include "Assets.h"
+#include "MemoryArena.h"
+#include "TransformPool.h"
+#include "Behaviour.h"
 
 class Component;
 class Entity;
@@ -18,27 +22,91 @@ public:
 
 class CTransform : public Component
 {
+    TransformPool * m_pool;
+    uint32_t        m_slot;
+
 public:
-    Vec2 pos        = { 0.0, 0.0 };
-    Vec2 prevPos    = { 0.0, 0.0 };
+    // cold
     Vec2 scale      = { 1.0, 1.0 };
-    Vec2 speed      = { 0.0, 0.0 };
     Vec2 facing     = { 1.0, 0.0 };
     float angle = 0;
+    int proxy = -1;     // leaf in the broad phase tree, -1 when not in the tree
+
+    // the hot data lives in the pool, so sMovement can integrate every transform at once
+    CTransform(const Vec2 & p, TransformPool * pool)
+        : CTransform(p, { 0, 0 }, { 1, 1 }, 0, pool) {}
+    CTransform(const Vec2 & p, const Vec2 & sp, const Vec2 & sc, float a, TransformPool * pool)
+        : m_pool(pool)
+        , m_slot(pool->allocate())
+        , scale(sc), angle(a)
+    {
+        pos() = prevPos() = p;
+        speed() = sp;
+        if (m_pool->isFixed())
+        {
+            fixedPos() = fixedPrevPos() = FixedVec2(Fixed(p.x), Fixed(p.y));
+            fixedSpeed() = FixedVec2(Fixed(sp.x), Fixed(sp.y));
+        }
+    }
+
+    CTransform(const CTransform &) = delete;
+    CTransform & operator = (const CTransform &) = delete;
+
+    ~CTransform()
+    {
+        m_pool->release(m_slot);
+    }
+
+    // hot, read and written every tick
+    Vec2 & pos()        { return m_pool->pos(m_slot); }
+    Vec2 & prevPos()    { return m_pool->prevPos(m_slot); }
+    Vec2 & speed()      { return m_pool->speed(m_slot); }
+
+    // the same in 16.16 fixed point, only in a fixed-point pool, which the systems move in
+    // deterministic mode while the floats above only follow it for drawing and the broad phase
+    FixedVec2 & fixedPos()      { return m_pool->fixedPos(m_slot); }
+    FixedVec2 & fixedPrevPos()  { return m_pool->fixedPrevPos(m_slot); }
+    FixedVec2 & fixedSpeed()    { return m_pool->fixedSpeed(m_slot); }
 
-    CTransform(const Vec2 & p = { 0, 0 })
-        : pos(p), angle(0) {}
-    CTransform(const Vec2 & p, const Vec2 & sp, const Vec2 & sc, float a)
-        : pos(p), prevPos(p), speed(sp), scale(sc), angle(a) {}
+    bool isFixed() const { return m_pool->isFixed(); }
 
+    // zero the speed in every scalar the transform keeps
+    void stop()
+    {
+        speed() = Vec2(0, 0);
+        if (isFixed()) { fixedSpeed() = FixedVec2(); }
+    }
+
+    // the hot data in the scalar the systems run on: float, or Fixed in deterministic mode
+    template <typename T> TVec2<T> & position();
+    template <typename T> TVec2<T> & previous();
+    template <typename T> TVec2<T> & velocity();
+
+    // after a system wrote the hot data in T, bring the floats up to date with it
+    template <typename T> void syncFloat();
 };
 
+template <> inline Vec2 &       CTransform::position<float>()   { return pos(); }
+template <> inline Vec2 &       CTransform::previous<float>()   { return prevPos(); }
+template <> inline Vec2 &       CTransform::velocity<float>()   { return speed(); }
+template <> inline FixedVec2 &  CTransform::position<Fixed>()   { return fixedPos(); }
+template <> inline FixedVec2 &  CTransform::previous<Fixed>()   { return fixedPrevPos(); }
+template <> inline FixedVec2 &  CTransform::velocity<Fixed>()   { return fixedSpeed(); }
+
+template <> inline void CTransform::syncFloat<float>() {}
+template <> inline void CTransform::syncFloat<Fixed>()
+{
+    pos()       = FloatCast(fixedPos());
+    prevPos()   = FloatCast(fixedPrevPos());
+    speed()     = FloatCast(fixedSpeed());
+}
+
 class CLifeSpan : public Component
 {
 public:
-    sf::Clock clock;
-    int lifespan = 0;
-    
+    int lifespan = 0;   // milliseconds, counted in 60Hz simulation ticks so replays and headless runs agree
+    int ticks = 0;      // simulated so far
+
     CLifeSpan(int l) : lifespan(l) {}
 };
 
@@ -55,6 +123,21 @@ public:
     CInput() {}
 };
 
+// Collision layers, one bit each. A box sits on the layers in its layer field and collides with
+// the boxes whose layer shares a bit with its mask; bits above Sword are free for level files.
+namespace CollisionLayer
+{
+    enum : uint32_t
+    {
+        None    = 0,
+        Tile    = 1 << 0,   // movement-blocking tiles
+        Player  = 1 << 1,
+        Npc     = 1 << 2,
+        Sword   = 1 << 3,
+        All     = 0xffffffff
+    };
+}
+
 class CBoundingBox : public Component
 {
 public:
@@ -62,8 +145,10 @@ public:
     Vec2 halfSize;
     bool blockMove = false;
     bool blockVision = false;
-    CBoundingBox(const Vec2 & s, bool m, bool v)
-        : size(s), blockMove(m), blockVision(v), halfSize(s.x / 2, s.y / 2) {}
+    uint32_t layer = CollisionLayer::None;
+    uint32_t mask = CollisionLayer::None;
+    CBoundingBox(const Vec2 & s, bool m, bool v, uint32_t l = CollisionLayer::None, uint32_t k = CollisionLayer::None)
+        : size(s), blockMove(m), blockVision(v), halfSize(s.x / 2, s.y / 2), layer(l), mask(k) {}
 };
 
 class CAnimation : public Component
@@ -104,6 +189,8 @@ class CFollowPlayer : public Component
 public:
     Vec2 home = { 0, 0 };
     float speed = 0;
+    std::vector<Vec2> homePath;     // A* waypoints back to home, empty while chasing
+    size_t homePathIndex = 0;
     CFollowPlayer(Vec2 p, float s)
         : home(p), speed(s) {}
     
@@ -112,8 +199,75 @@ public:
 class CPatrol : public Component
 {
 public:
-    std::vector<Vec2> positions;
+    ArenaVector<Vec2> positions;
     size_t currentPosition = 0;
     float speed = 0;
-    CPatrol(std::vector<Vec2> & pos, float s) : positions(pos), speed(s) {}
-};
\ No newline at end of file
+    CPatrol(float s, MemoryArena * arena = nullptr)
+        : positions(ArenaAllocator<Vec2>(arena)), speed(s) {}
+};
+
+class CBehaviour : public Component
+{
+public:
+    std::shared_ptr<Behaviour> behaviour;
+    Await await;        // what the behaviour is suspended on
+    CBehaviour(const std::shared_ptr<Behaviour> & b) : behaviour(b), await(b->start()) {}
+};
+
+// how much of the simulation an NPC gets, from its room relative to the player's room
+enum class Activity : unsigned char { Awake, Reduced, Asleep };
+
+class CActivity : public Component
+{
+public:
+    Activity level = Activity::Asleep;
+    int roomX = 0, roomY = 0;       // room whose bucket in the activity grid holds the entity
+    bool tracked = false;           // false until the activity grid has placed the entity
+    CActivity() {}
+};
+
+// Every component type, in id order. A component's type id is its index in this list,
+// known at compile time, so a new component only has to be appended here.
+template <typename... Ts> struct TypeList {};
+
+typedef TypeList<CTransform, CLifeSpan, CInput, CBoundingBox, CAnimation, CGravity,
+                 CState, CDraggable, CFollowPlayer, CPatrol, CActivity, CBehaviour> ComponentList;
+
+template <typename T, typename List> struct TypeIndex;
+
+template <typename T>
+struct TypeIndex<T, TypeList<>>
+{
+    static_assert(sizeof(T) == 0, "component type is missing from ComponentList");
+};
+
+template <typename T, typename... Ts>
+struct TypeIndex<T, TypeList<T, Ts...>> : std::integral_constant<size_t, 0> {};
+
+template <typename T, typename U, typename... Ts>
+struct TypeIndex<T, TypeList<U, Ts...>> : std::integral_constant<size_t, 1 + TypeIndex<T, TypeList<Ts...>>::value> {};
+
+template <typename List> struct TypeCount;
+
+template <typename... Ts>
+struct TypeCount<TypeList<Ts...>> : std::integral_constant<size_t, sizeof...(Ts)> {};
+
+static_assert(TypeCount<ComponentList>::value <= MaxComponents, "ComponentList has more types than MaxComponents");
+static_assert(MaxComponents <= 64, "component masks are 64 bits wide");
+
+typedef unsigned long long ComponentMask;
+
+template <typename T>
+constexpr size_t GetComponentTypeID()
+{
+    return TypeIndex<T, ComponentList>::value;
+}
+
+// bit set for each of the given component types, a system's signature
+template <typename... Ts> struct Signature;
+
+template <>
+struct Signature<> : std::integral_constant<ComponentMask, 0> {};
+
+template <typename T, typename... Ts>
+struct Signature<T, Ts...> : std::integral_constant<ComponentMask, (1ull << GetComponentTypeID<T>()) | Signature<Ts...>::value> {};
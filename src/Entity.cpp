@@ -1,12 +1,26 @@
 #include "Entity.h"
+#include "EntityManager.h"
 
-Entity::Entity(const size_t & id, const std::string & tag)
-    : m_tag (tag)
-    , m_id  (id)
+Entity::Entity(const size_t & id, const std::string & tag, MemoryArena * arena, EntityManager * manager)
+    : m_tag     (tag)
+    , m_id      (id)
+    , m_arena   (arena)
+    , m_manager (manager)
 {
 
 }
 
+void Entity::recordChange(size_t typeID)
+{
+    if (m_changed[typeID]) { return; }
+
+    m_changed.set(typeID);
+    if (m_manager)
+    {
+        m_manager->m_changed[typeID].push_back(this);
+    }
+}
+
 bool Entity::isActive() const 
 { 
     return m_active; 
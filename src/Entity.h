@@ -1,19 +1,8 @@
 #pragma once
 
 #include "Components.h"
-
-inline size_t GetComponentTypeID()
-{
-    static size_t lastID = 0;
-    return lastID++;
-}
-
-template <typename T>
-inline size_t GetComponentTypeID()
-{
-    static size_t typeID = GetComponentTypeID();
-    return typeID;
-}
+#include "MemoryArena.h"
+#include <cassert>
 
 class EntityManager;
 
@@ -24,10 +13,17 @@ class Entity
     bool                m_active    = true;
     std::string         m_tag       = "default";
     size_t              m_id        = 0;
+    MemoryArena *       m_arena     = nullptr;
+    EntityManager *     m_manager   = nullptr;
 
     std::array<std::shared_ptr<Component>, MaxComponents>   m_componentArray;
+    std::bitset<MaxComponents>                              m_changed;
+    ComponentMask                                           m_mask      = 0;    // one bit per component present
+
+    Entity(const size_t & id, const std::string & tag, MemoryArena * arena = nullptr, EntityManager * manager = nullptr);
 
-    Entity(const size_t & id, const std::string & tag);
+    // flag the component type as changed this tick and queue the entity on the manager's change list
+    void recordChange(size_t typeID);
 
 public:
 
@@ -39,27 +35,67 @@ public:
     template <typename T>
     bool hasComponent() const
     {
-        return m_componentArray[GetComponentTypeID<T>()].get() != nullptr;
+        return (m_mask & Signature<T>::value) != 0;
+    }
+
+    // true if the entity has every one of the given components
+    template <typename... Ts>
+    bool hasComponents() const
+    {
+        return (m_mask & Signature<Ts...>::value) == Signature<Ts...>::value;
     }
 
     template <typename T, typename... TArgs>
     std::shared_ptr<T> addComponent(TArgs&&... mArgs)
     {
-        std::shared_ptr<T> component = std::make_shared<T>(std::forward<TArgs>(mArgs)...);
+        // components (and their control blocks) live in the owning manager's arena
+        std::shared_ptr<T> component = std::allocate_shared<T>(ArenaAllocator<T>(m_arena), std::forward<TArgs>(mArgs)...);
         m_componentArray[GetComponentTypeID<T>()] = component;
+        m_mask |= Signature<T>::value;
+        recordChange(GetComponentTypeID<T>());
         return component;
     }
 
+    // the slot for T only ever holds a T, so no runtime type check is needed
     template<typename T>
     std::shared_ptr<T> getComponent()
     {
-        return std::dynamic_pointer_cast<T>(m_componentArray[GetComponentTypeID<T>()]);
+        return std::static_pointer_cast<T>(m_componentArray[GetComponentTypeID<T>()]);
+    }
+
+    // direct reference to a component the entity is known to have, without touching the reference count
+    template<typename T>
+    T & get()
+    {
+        assert(hasComponent<T>());
+        return *static_cast<T *>(m_componentArray[GetComponentTypeID<T>()].get());
+    }
+
+    template<typename T>
+    const T & get() const
+    {
+        assert(hasComponent<T>());
+        return *static_cast<const T *>(m_componentArray[GetComponentTypeID<T>()].get());
+    }
+
+    // systems call this after writing to a component so incremental systems can pick it up
+    template<typename T>
+    void markChanged()
+    {
+        recordChange(GetComponentTypeID<T>());
+    }
+
+    template<typename T>
+    bool isChanged() const
+    {
+        return m_changed[GetComponentTypeID<T>()];
     }
 
     template<typename T>
     void removeComponent()
     {
         m_componentArray[GetComponentTypeID<T>()] = std::shared_ptr<T>();
+        m_mask &= ~Signature<T>::value;
     }
 };
 
@@ -0,0 +1,79 @@
+#include "EntityCommandBuffer.h"
+#include "EntityManager.h"
+
+EntityCommandBuffer::EntityCommandBuffer()
+    : m_arena(16 * 1024)
+{
+
+}
+
+EntityCommandBuffer::~EntityCommandBuffer()
+{
+    clear();
+}
+
+Entity * EntityCommandBuffer::resolve(const Handle & handle) const
+{
+    return handle.entity ? handle.entity : m_created[handle.pending];
+}
+
+EntityCommandBuffer::Handle EntityCommandBuffer::create(const std::string & tag)
+{
+    Command command;
+    command.kind    = Command::Create;
+    command.tag     = tag;
+    m_commands.push_back(std::move(command));
+
+    Handle handle;
+    handle.pending = m_pending++;
+    return handle;
+}
+
+void EntityCommandBuffer::destroy(const Handle & entity)
+{
+    Command command;
+    command.kind    = Command::Destroy;
+    command.target  = entity;
+    m_commands.push_back(std::move(command));
+}
+
+void EntityCommandBuffer::playback(EntityManager & manager)
+{
+    m_created.clear();
+    for (auto & command : m_commands)
+    {
+        switch (command.kind)
+        {
+        case Command::Create:
+            // the manager holds the new entity until its next update adds it
+            m_created.push_back(manager.addEntity(command.tag).get());
+            break;
+        case Command::Destroy:
+            resolve(command.target)->destroy();
+            break;
+        case Command::Add:
+            command.construct->apply(*resolve(command.target));
+            break;
+        case Command::Remove:
+            command.remove(*resolve(command.target));
+            break;
+        }
+    }
+    clear();
+}
+
+void EntityCommandBuffer::clear()
+{
+    for (auto & command : m_commands)
+    {
+        if (command.construct) { command.construct->~Construct(); }
+    }
+    m_commands.clear();
+    m_pending = 0;
+    m_arena.reset();
+}
+
+size_t EntityCommandBuffer::size() const
+{
+    return m_commands.size();
+}
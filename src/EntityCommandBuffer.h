@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Common.h"
+#include "Entity.h"
+#include "MemoryArena.h"
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+class EntityManager;
+
+// Entity operations recorded by one thread during a tick and applied later, in record
+// order, by EntityManager::update() on the thread that owns the manager.
+// Recording only touches the buffer itself (its command list and its own arena for
+// component constructor arguments), so every worker records into its own buffer without
+// locks. An entity created through the buffer only exists once the buffer is played back;
+// until then the handle create() returns stands for it, within the same buffer only.
+class EntityCommandBuffer
+{
+public:
+
+    // an existing entity, or one this buffer will create
+    struct Handle
+    {
+        Entity *    entity  = nullptr;
+        size_t      pending = 0;        // index among this buffer's creates when entity is null
+
+        Handle() {}
+        Handle(Entity * e) : entity(e) {}
+    };
+
+private:
+
+    // builds a component from the recorded arguments, lives in m_arena
+    struct Construct
+    {
+        virtual ~Construct() {}
+        virtual void apply(Entity & entity) = 0;
+    };
+
+    template <typename T, typename... Args>
+    struct ConstructComponent : public Construct
+    {
+        std::tuple<typename std::decay<Args>::type...> args;
+
+        ConstructComponent(Args &&... a) : args(std::forward<Args>(a)...) {}
+
+        void apply(Entity & entity) override
+        {
+            apply(entity, std::index_sequence_for<Args...>());
+        }
+
+        template <size_t... Is>
+        void apply(Entity & entity, std::index_sequence<Is...>)
+        {
+            entity.addComponent<T>(std::get<Is>(args)...);
+        }
+    };
+
+    template <typename T>
+    static void RemoveComponent(Entity & entity)
+    {
+        entity.removeComponent<T>();
+    }
+
+    struct Command
+    {
+        enum Kind : unsigned char { Create, Destroy, Add, Remove };
+
+        Kind            kind;
+        Handle          target;
+        std::string     tag;                        // Create
+        Construct *     construct   = nullptr;      // Add
+        void         (* remove)(Entity &) = nullptr;// Remove
+    };
+
+    std::vector<Command>    m_commands;
+    std::vector<Entity *>   m_created;      // playback scratch, entities by pending index
+    size_t                  m_pending   = 0;
+    MemoryArena             m_arena;
+
+    Entity * resolve(const Handle & handle) const;
+
+public:
+
+    EntityCommandBuffer();
+    ~EntityCommandBuffer();
+
+    EntityCommandBuffer(const EntityCommandBuffer &) = delete;
+    EntityCommandBuffer & operator = (const EntityCommandBuffer &) = delete;
+
+    Handle create(const std::string & tag);
+    void destroy(const Handle & entity);
+
+    template <typename T, typename... Args>
+    void addComponent(const Handle & entity, Args &&... args)
+    {
+        typedef ConstructComponent<T, Args...> Type;
+        Command command;
+        command.kind        = Command::Add;
+        command.target      = entity;
+        command.construct   = new (m_arena.allocate(sizeof(Type), alignof(Type))) Type(std::forward<Args>(args)...);
+        m_commands.push_back(std::move(command));
+    }
+
+    template <typename T>
+    void removeComponent(const Handle & entity)
+    {
+        Command command;
+        command.kind    = Command::Remove;
+        command.target  = entity;
+        command.remove  = &RemoveComponent<T>;
+        m_commands.push_back(std::move(command));
+    }
+
+    // apply every command in record order through the manager, then clear the buffer
+    void playback(EntityManager & manager);
+
+    // drop every command without applying it
+    void clear();
+
+    size_t size() const;
+};
@@ -1,15 +1,35 @@
 #include "EntityManager.h"
 
-EntityManager::EntityManager()
+EntityManager::EntityManager(MemoryArena * arena)
+    : m_arena(arena)
 {
 
 }
 
 void EntityManager::update()
 {
+    // a new tick starts, forget what changed during the previous one
+    clearChanges();
+
+    // apply what the workers recorded last tick, so their new entities are added below
+    // and the ones they destroyed are removed with the rest
+    for (auto & buffer : m_commandBuffers)
+    {
+        buffer->playback(*this);
+    }
+
     // add all the entities that are pending
     for (auto e : m_entitiesToAdd)
     {
+        // components of a new entity count as changed on the tick it becomes visible
+        if (e->isActive())
+        {
+            for (size_t id = 0; id < MaxComponents; id++)
+            {
+                if (e->m_componentArray[id]) { e->recordChange(id); }
+            }
+        }
+
         // add it to the vector of all entities
         m_entities.push_back(e);
 
@@ -23,6 +43,12 @@ void EntityManager::update()
     m_entitiesToAdd.clear();
 
     // clean up dead entities in all vectors
+    // the ones leaving m_entities are held for one more tick in m_removed
+    m_removed.clear();
+    for (auto & e : m_entities)
+    {
+        if (!e->isActive()) { m_removed.push_back(e); }
+    }
     removeDeadEntities(m_entities);
     for (auto & kv : m_entityMap)
     {
@@ -33,6 +59,28 @@ void EntityManager::update()
     }
 }
 
+void EntityManager::clearChanges()
+{
+    for (auto & changed : m_changed)
+    {
+        for (auto e : changed)
+        {
+            e->m_changed.reset();
+        }
+        changed.clear();
+    }
+}
+
+std::array<size_t, MaxComponents> EntityManager::getChangedCounts() const
+{
+    std::array<size_t, MaxComponents> counts;
+    for (size_t id = 0; id < MaxComponents; id++)
+    {
+        counts[id] = m_changed[id].size();
+    }
+    return counts;
+}
+
 void EntityManager::removeDeadEntities(EntityVec & vec)
 {
     // use std::remove_if to remove dead entities
@@ -44,7 +92,11 @@ void EntityManager::removeDeadEntities(EntityVec & vec)
 std::shared_ptr<Entity> EntityManager::addEntity(const std::string & tag)
 {
     // creat the entity shared pointer
-    auto entity = std::shared_ptr<Entity>(new Entity(m_totalEntities++, tag));
+    // the entity and its control block are placed in the arena, so the deleter runs the destructor
+    // and hands the memory back to the arena for the next entity
+    ArenaAllocator<Entity> allocator(m_arena);
+    auto entity = std::shared_ptr<Entity>(new (allocator.allocate(1)) Entity(m_totalEntities++, tag, m_arena, this),
+        [allocator](Entity * e) mutable { e->~Entity(); allocator.deallocate(e, 1); }, allocator);
 
     // add it to the vector of entities that will be added on next update() call
     m_entitiesToAdd.push_back(entity);
@@ -53,6 +105,25 @@ std::shared_ptr<Entity> EntityManager::addEntity(const std::string & tag)
     return entity;
 }
 
+void EntityManager::reserveCommandBuffers(size_t count)
+{
+    while (m_commandBuffers.size() < count)
+    {
+        m_commandBuffers.push_back(std::unique_ptr<EntityCommandBuffer>(new EntityCommandBuffer()));
+    }
+}
+
+EntityCommandBuffer & EntityManager::commandBuffer(size_t index)
+{
+    assert(index < m_commandBuffers.size());
+    return *m_commandBuffers[index];
+}
+
+const EntityVec & EntityManager::getRemoved() const
+{
+    return m_removed;
+}
+
 EntityVec & EntityManager::getEntities()
 {
     return m_entities;
@@ -2,27 +2,83 @@
 
 #include "Common.h"
 #include "Entity.h"
+#include "EntityCommandBuffer.h"
 
 typedef std::vector<std::shared_ptr<Entity>> EntityVec;
 
+typedef std::vector<Entity *> EntityPtrVec;
+
 class EntityManager
 {
+    friend class Entity;
+
     EntityVec                           m_entities;
     EntityVec                           m_entitiesToAdd;
+    EntityVec                           m_removed;      // removed by the last update(), kept alive until the next
     std::map<std::string, EntityVec>    m_entityMap;
     size_t                              m_totalEntities = 0;
+    MemoryArena *                       m_arena = nullptr;
+
+    // entities whose component of each type changed since the last update()
+    std::array<EntityPtrVec, MaxComponents> m_changed;
+
+    // commands recorded by worker threads, played back by update() in buffer order
+    std::vector<std::unique_ptr<EntityCommandBuffer>> m_commandBuffers;
 
     // helper function to avoid repeated code
     void removeDeadEntities(EntityVec & vec);
+    void clearChanges();
 
 public:
 
-    EntityManager();
+    // entities and their components are allocated from arena when one is given
+    EntityManager(MemoryArena * arena = nullptr);
 
     void update();
 
     std::shared_ptr<Entity> addEntity(const std::string & tag);
 
+    // Per-thread command buffers for creating and destroying entities and adding and removing
+    // components from worker threads. Reserve them on the owning thread before the workers
+    // start, give each worker its own index, and update() applies them in index order, then
+    // record order, so the outcome does not depend on how the threads were scheduled.
+    void reserveCommandBuffers(size_t count);
+    EntityCommandBuffer & commandBuffer(size_t index);
+
     EntityVec & getEntities();
     EntityVec & getEntities(const std::string & tag);
+
+    // entities removed by the last update(), so systems holding raw references can drop them
+    const EntityVec & getRemoved() const;
+
+    // entities whose component T was added or written since the last update()
+    // entities spawned during the previous tick report all of their components as changed
+    template <typename T>
+    const EntityPtrVec & getChanged() const
+    {
+        return m_changed[GetComponentTypeID<T>()];
+    }
+
+    template <typename T>
+    size_t getChangedCount() const
+    {
+        return getChanged<T>().size();
+    }
+
+    // call fn(Entity &, Ts &...) for every live entity with the tag that has all of Ts,
+    // the component references are resolved by type id at compile time
+    template <typename... Ts, typename F>
+    void forEach(const std::string & tag, F && fn)
+    {
+        for (auto & e : getEntities(tag))
+        {
+            if (e->isActive() && e->hasComponents<Ts...>())
+            {
+                fn(*e, e->get<Ts>()...);
+            }
+        }
+    }
+
+    // number of changed entities for every component type id, for stats output
+    std::array<size_t, MaxComponents> getChangedCounts() const;
 };
\ No newline at end of file
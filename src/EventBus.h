@@ -0,0 +1,74 @@
+#pragma once
+
+#include "SpscQueue.h"
+#include <tuple>
+
+// One typed channel of the event bus: a preallocated lock-free ring with one producing
+// and one consuming thread. Publishing into a full channel drops the event and counts it.
+template <typename T, size_t Capacity>
+class EventChannel
+{
+    SpscQueue<T, Capacity>  m_queue;
+    std::atomic<size_t>     m_dropped { 0 };
+
+public:
+
+    bool publish(const T & event)
+    {
+        if (m_queue.push(event)) { return true; }
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    bool poll(T & event)
+    {
+        return m_queue.pop(event);
+    }
+
+    // hand every queued event to handler(const T &), returns how many there were
+    template <typename F>
+    size_t drain(F && handler)
+    {
+        T event;
+        size_t count = 0;
+        while (m_queue.pop(event))
+        {
+            handler(event);
+            count++;
+        }
+        return count;
+    }
+
+    size_t size()    const { return m_queue.size(); }
+    size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+};
+
+// Event bus with one channel per event type, all allocated up front.
+// Channels are picked by type at compile time, so publishing is a ring buffer write with
+// no lookup, lock or allocation. Each channel may be used from two threads at most:
+// whichever publishes and whichever drains.
+template <size_t Capacity, typename... Events>
+class EventBus
+{
+    std::tuple<EventChannel<Events, Capacity>...> m_channels;
+
+public:
+
+    template <typename T>
+    EventChannel<T, Capacity> & channel()
+    {
+        return std::get<EventChannel<T, Capacity>>(m_channels);
+    }
+
+    template <typename T>
+    bool publish(const T & event)
+    {
+        return channel<T>().publish(event);
+    }
+
+    template <typename T, typename F>
+    size_t drain(F && handler)
+    {
+        return channel<T>().drain(handler);
+    }
+};
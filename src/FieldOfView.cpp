@@ -0,0 +1,205 @@
+#include "FieldOfView.h"
+#include <math.h>
+
+// row and column step of the eight octants, transforming octant-local (dx, dy) into the grid
+static const int OctantXX[8] = { 1,  0,  0, -1, -1,  0,  0,  1 };
+static const int OctantXY[8] = { 0,  1, -1,  0,  0, -1,  1,  0 };
+static const int OctantYX[8] = { 0,  1,  1,  0,  0, -1, -1,  0 };
+static const int OctantYY[8] = { 1,  0,  0,  1, -1,  0,  0, -1 };
+
+void FieldOfView::build(const Vec2 & cellSize, const GridCell & roomCells, const GridCell & minRoom, const GridCell & maxRoom, const std::vector<GridCell> & opaqueCells)
+{
+    GridCell origin(minRoom.x * roomCells.x, minRoom.y * roomCells.y);
+    int width   = (maxRoom.x - minRoom.x + 1) * roomCells.x;
+    int height  = (maxRoom.y - minRoom.y + 1) * roomCells.y;
+
+    if (origin != m_origin || width != m_width || height != m_height || cellSize.x != m_cellSize.x || cellSize.y != m_cellSize.y)
+    {
+        m_explored.assign(std::max(0, width * height), 0);
+    }
+
+    m_cellSize  = cellSize;
+    m_origin    = origin;
+    m_width     = std::max(0, width);
+    m_height    = std::max(0, height);
+    m_opaque.assign(m_width * m_height, 0);
+    m_valid     = false;
+
+    for (auto & c : opaqueCells)
+    {
+        int i = index(c.x, c.y);
+        if (i >= 0) { m_opaque[i] = 1; }
+    }
+}
+
+void FieldOfView::setRadius(int cells)
+{
+    m_radius    = std::max(1, cells);
+    m_valid     = false;
+}
+
+int FieldOfView::index(int x, int y) const
+{
+    x -= m_origin.x;
+    y -= m_origin.y;
+    if (x < 0 || y < 0 || x >= m_width || y >= m_height) { return -1; }
+    return y * m_width + x;
+}
+
+bool FieldOfView::isOpaque(int x, int y) const
+{
+    int i = index(x, y);
+    return i >= 0 && m_opaque[i];
+}
+
+void FieldOfView::reveal(int x, int y)
+{
+    int size = 2 * m_radius + 1;
+    auto & stamp = m_visible[(y - m_center.y + m_radius) * size + (x - m_center.x + m_radius)];
+    if (stamp != m_stamp)
+    {
+        stamp = m_stamp;
+        m_stats.visible++;
+    }
+
+    int i = index(x, y);
+    if (i >= 0) { m_explored[i] = 1; }
+}
+
+void FieldOfView::castLight(int row, float start, float end, int xx, int xy, int yx, int yy)
+{
+    // start and end are the slopes of the octant still lit, narrowed by every opaque run found
+    if (start < end) { return; }
+
+    float newStart = 0;
+    for (int j = row; j <= m_radius; j++)
+    {
+        bool blocked = false;
+        for (int dx = -j, dy = -j; dx <= 0; dx++)
+        {
+            int x           = m_center.x + dx * xx + dy * xy;
+            int y           = m_center.y + dx * yx + dy * yy;
+            float leftSlope = (dx - 0.5f) / (dy + 0.5f);
+            float rightSlope= (dx + 0.5f) / (dy - 0.5f);
+
+            if (start < rightSlope) { continue; }
+            if (end > leftSlope)    { break; }
+
+            if (dx * dx + dy * dy <= m_radius * m_radius) { reveal(x, y); }
+
+            bool opaque = isOpaque(x, y);
+            if (blocked)
+            {
+                // still inside an opaque run, the lit part starts again after it
+                if (opaque) { newStart = rightSlope; continue; }
+                blocked = false;
+                start   = newStart;
+            }
+            else if (opaque && j < m_radius)
+            {
+                // an opaque run begins: the rows behind it are lit only up to its left edge
+                blocked = true;
+                castLight(j + 1, start, leftSlope, xx, xy, yx, yy);
+                newStart = rightSlope;
+            }
+        }
+        if (blocked) { break; }
+    }
+}
+
+void FieldOfView::cast()
+{
+    sf::Clock clock;
+
+    int size = 2 * m_radius + 1;
+    if (m_visible.size() != (size_t)(size * size)) { m_visible.assign(size * size, 0); m_stamp = 0; }
+
+    // a new stamp forgets the previous set without clearing the window
+    if (++m_stamp == 0)
+    {
+        std::fill(m_visible.begin(), m_visible.end(), 0);
+        m_stamp = 1;
+    }
+
+    m_stats.visible = 0;
+    reveal(m_center.x, m_center.y);
+    for (int octant = 0; octant < 8; octant++)
+    {
+        castLight(1, 1.0f, 0.0f, OctantXX[octant], OctantXY[octant], OctantYX[octant], OctantYY[octant]);
+    }
+
+    m_valid = true;
+    m_stats.builds++;
+    m_stats.castMicros = clock.getElapsedTime().asMicroseconds();
+}
+
+bool FieldOfView::update(const Vec2 & origin)
+{
+    GridCell cell = cellOf(origin);
+    if (m_valid && cell == m_center) { return false; }
+
+    m_center = cell;
+    cast();
+    return true;
+}
+
+GridCell FieldOfView::cellOf(const Vec2 & pos) const
+{
+    return GridCell((int)floor(pos.x / m_cellSize.x), (int)floor(pos.y / m_cellSize.y));
+}
+
+bool FieldOfView::isVisible(const GridCell & cell) const
+{
+    if (!m_valid) { return false; }
+
+    int x = cell.x - m_center.x + m_radius;
+    int y = cell.y - m_center.y + m_radius;
+    int size = 2 * m_radius + 1;
+    if (x < 0 || y < 0 || x >= size || y >= size) { return false; }
+    return m_visible[y * size + x] == m_stamp;
+}
+
+bool FieldOfView::isExplored(const GridCell & cell) const
+{
+    int i = index(cell.x, cell.y);
+    return i >= 0 && m_explored[i];
+}
+
+bool FieldOfView::canSee(const Vec2 & pos) const
+{
+    return isVisible(cellOf(pos));
+}
+
+void FieldOfView::drawFog(const AABB & view, std::vector<sf::Vertex> & vertices) const
+{
+    GridCell min = cellOf(view.min), max = cellOf(view.max);
+    const sf::Color dimmed(0, 0, 0, 160), black(0, 0, 0, 255);
+
+    for (int y = min.y; y <= max.y; y++)
+    {
+        float top = y * m_cellSize.y, bottom = top + m_cellSize.y;
+        for (int x = min.x; x <= max.x;)
+        {
+            // 0 visible, 1 explored, 2 never seen
+            auto shade = [&](int cx) { return isVisible(GridCell(cx, y)) ? 0 : isExplored(GridCell(cx, y)) ? 1 : 2; };
+            int kind = shade(x), end = x + 1;
+            while (end <= max.x && shade(end) == kind) { end++; }
+
+            if (kind != 0)
+            {
+                auto & color = kind == 1 ? dimmed : black;
+                float left = x * m_cellSize.x, right = end * m_cellSize.x;
+                vertices.push_back(sf::Vertex(sf::Vector2f(left, top), color));
+                vertices.push_back(sf::Vertex(sf::Vector2f(right, top), color));
+                vertices.push_back(sf::Vertex(sf::Vector2f(right, bottom), color));
+                vertices.push_back(sf::Vertex(sf::Vector2f(left, bottom), color));
+            }
+            x = end;
+        }
+    }
+}
+
+const FieldOfViewStats & FieldOfView::getStats() const
+{
+    return m_stats;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Common.h"
+#include "NavGrid.h"
+#include "AABBTree.h"
+
+struct FieldOfViewStats
+{
+    size_t      builds      = 0;    // times the visible set was cast, once per cell the origin entered
+    size_t      visible     = 0;    // cells in the last visible set
+    long long   castMicros  = 0;    // time of the last cast
+};
+
+// The player's field of view over the vision-blocking tiles, one cell per tile.
+// Recursive shadowcasting marks the cells visible from the origin's cell out to a radius, and
+// only when the origin has entered another cell. The result is stamped into a square window
+// around the origin, so whether a position is in view is one index and one compare instead
+// of a segment test against every blocker. Cells seen once stay explored for the fog overlay.
+class FieldOfView
+{
+    Vec2                        m_cellSize      = { 64, 64 };
+    GridCell                    m_origin;                       // cell at index 0 of m_opaque
+    int                         m_width         = 0;
+    int                         m_height        = 0;
+    std::vector<unsigned char>  m_opaque;
+    std::vector<unsigned char>  m_explored;
+
+    // visible set around m_center, a cell is visible when its stamp equals m_stamp
+    int                         m_radius        = 48;
+    GridCell                    m_center;
+    bool                        m_valid         = false;
+    std::vector<unsigned>       m_visible;
+    unsigned                    m_stamp         = 0;
+    FieldOfViewStats            m_stats;
+
+    int  index(int x, int y) const;
+    bool isOpaque(int x, int y) const;
+    void reveal(int x, int y);
+    void castLight(int row, float start, float end, int xx, int xy, int yx, int yy);
+    void cast();
+
+public:
+
+    // (re)build from the cells of vision-blocking tiles, explored cells are kept when the
+    // rooms stay the same so a hot reload does not bring the fog back
+    void build(const Vec2 & cellSize, const GridCell & roomCells, const GridCell & minRoom, const GridCell & maxRoom, const std::vector<GridCell> & opaqueCells);
+
+    // how far the player sees in cells, it should cover the rooms whose NPCs are awake
+    void setRadius(int cells);
+
+    // move the origin, returns true if the visible set had to be cast again
+    bool update(const Vec2 & origin);
+
+    GridCell cellOf(const Vec2 & pos) const;
+    bool     isVisible(const GridCell & cell) const;
+    bool     isExplored(const GridCell & cell) const;
+
+    // whether something standing at pos sees the origin's cell and is seen from it
+    bool     canSee(const Vec2 & pos) const;
+
+    // append darkening quads over the cells of the view that are not visible: explored ones
+    // are dimmed and the rest are black, runs of equal cells in a row share one quad
+    void drawFog(const AABB & view, std::vector<sf::Vertex> & vertices) const;
+
+    const FieldOfViewStats & getStats() const;
+};
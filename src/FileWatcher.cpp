@@ -0,0 +1,70 @@
+#include "FileWatcher.h"
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/types.h>
+    #include <sys/stat.h>
+#endif
+
+FileWatcher::FileState FileWatcher::Stat(const std::string & path)
+{
+    // the modification time is kept at the finest resolution the platform reports, so a
+    // same-size save within the same second as the last one is still seen
+    FileState state;
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info))
+    {
+        // FILETIME counts 100 ns intervals, too many since 1601 to scale to nanoseconds
+        state.modified  = (long long)(((unsigned long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+        state.size      = (long long)(((unsigned long long)info.nFileSizeHigh << 32) | info.nFileSizeLow);
+    }
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0)
+    {
+    #ifdef __APPLE__
+        state.modified  = (long long)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+    #else
+        state.modified  = (long long)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+    #endif
+        state.size      = (long long)info.st_size;
+    }
+#endif
+    return state;
+}
+
+void FileWatcher::watch(const std::string & path)
+{
+    if (m_files.find(path) == m_files.end())
+    {
+        m_files[path] = Stat(path);
+    }
+}
+
+void FileWatcher::watch(const std::vector<std::string> & paths)
+{
+    for (auto & path : paths) { watch(path); }
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+    std::vector<std::string> changed;
+    for (auto & file : m_files)
+    {
+        auto state = Stat(file.first);
+        if (state != file.second)
+        {
+            file.second = state;
+            changed.push_back(file.first);
+        }
+    }
+    return changed;
+}
+
+size_t FileWatcher::size() const
+{
+    return m_files.size();
+}
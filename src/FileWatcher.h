@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Common.h"
+#include <map>
+
+// Polls files for changes by modification time, at the finest resolution the platform
+// records, and size.
+// No OS notification is involved, so a poll costs one stat per watched file
+// and the caller decides how often that is worth doing.
+class FileWatcher
+{
+    struct FileState
+    {
+        long long modified  = 0;    // in the platform's finest unit, only ever compared
+        long long size      = -1;   // -1 while the file does not exist
+
+        bool operator != (const FileState & rhs) const { return modified != rhs.modified || size != rhs.size; }
+    };
+
+    std::map<std::string, FileState> m_files;
+
+    static FileState Stat(const std::string & path);
+
+public:
+
+    // start watching a file, one that is already watched keeps its last seen state
+    void watch(const std::string & path);
+    void watch(const std::vector<std::string> & paths);
+
+    // files whose time or size changed since the last poll, including ones that appeared or vanished
+    std::vector<std::string> poll();
+
+    size_t size() const;
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Vec2.h"
+#include <stdint.h>
+#include <limits>
+
+// 16.16 fixed-point number for deterministic simulation.
+// Every operation is integer arithmetic on the raw value, so results are bit-identical
+// across compilers, flags and evaluation order, unlike float. The range is +-32768
+// with a resolution of 1/65536; sums, products and quotients go through 64 bits, truncate,
+// and saturate instead of wrapping, so a far-away squared distance still compares as large.
+class Fixed
+{
+    int32_t m_raw = 0;
+
+    static constexpr int32_t Saturate(int64_t value) noexcept
+    {
+        return value > INT32_MAX ? INT32_MAX : value < -INT32_MAX ? -INT32_MAX : (int32_t)value;
+    }
+
+public:
+
+    static const int FractionBits = 16;
+    static const int32_t One = 1 << FractionBits;
+
+    constexpr Fixed() noexcept {}
+    constexpr Fixed(int value) noexcept : m_raw(value * One) {}
+
+    // floats are only converted at the edges (level data in, positions out for drawing)
+    explicit constexpr Fixed(float value) noexcept : m_raw((int32_t)(value * One)) {}
+    explicit constexpr Fixed(double value) noexcept : m_raw((int32_t)(value * One)) {}
+
+    static constexpr Fixed FromRaw(int32_t raw) noexcept { Fixed f; f.m_raw = raw; return f; }
+
+    constexpr int32_t raw() const noexcept { return m_raw; }
+    constexpr float toFloat() const noexcept { return (float)m_raw / One; }
+
+    constexpr Fixed operator - () const noexcept { return FromRaw(-m_raw); }
+    constexpr Fixed operator + (Fixed rhs) const noexcept { return FromRaw(Saturate((int64_t)m_raw + rhs.m_raw)); }
+    constexpr Fixed operator - (Fixed rhs) const noexcept { return FromRaw(Saturate((int64_t)m_raw - rhs.m_raw)); }
+
+    // the shift of a negative product relies on arithmetic right shift, which MSVC, GCC and Clang all use
+    constexpr Fixed operator * (Fixed rhs) const noexcept { return FromRaw(Saturate(((int64_t)m_raw * rhs.m_raw) >> FractionBits)); }
+    constexpr Fixed operator / (Fixed rhs) const noexcept { return FromRaw(Saturate(((int64_t)m_raw * One) / rhs.m_raw)); }
+
+    constexpr void operator += (Fixed rhs) noexcept { *this = *this + rhs; }
+    constexpr void operator -= (Fixed rhs) noexcept { *this = *this - rhs; }
+    constexpr void operator *= (Fixed rhs) noexcept { *this = *this * rhs; }
+    constexpr void operator /= (Fixed rhs) noexcept { *this = *this / rhs; }
+
+    constexpr bool operator == (Fixed rhs) const noexcept { return m_raw == rhs.m_raw; }
+    constexpr bool operator != (Fixed rhs) const noexcept { return m_raw != rhs.m_raw; }
+    constexpr bool operator <  (Fixed rhs) const noexcept { return m_raw <  rhs.m_raw; }
+    constexpr bool operator <= (Fixed rhs) const noexcept { return m_raw <= rhs.m_raw; }
+    constexpr bool operator >  (Fixed rhs) const noexcept { return m_raw >  rhs.m_raw; }
+    constexpr bool operator >= (Fixed rhs) const noexcept { return m_raw >= rhs.m_raw; }
+};
+
+// integer square root of the raw value scaled by 2^16, exact to the last bit
+inline Fixed Sqrt(Fixed value) noexcept
+{
+    if (value.raw() <= 0) { return Fixed(); }
+
+    uint64_t n = (uint64_t)value.raw() << Fixed::FractionBits;
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > n) { bit >>= 2; }
+    while (bit != 0)
+    {
+        if (n >= root + bit)
+        {
+            n       -= root + bit;
+            root     = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return Fixed::FromRaw((int32_t)root);
+}
+
+inline Fixed Abs(Fixed value) noexcept
+{
+    return value < Fixed() ? -value : value;
+}
+
+typedef TVec2<Fixed> FixedVec2;
+
+// a float vector (level data, nav grid waypoints) in the scalar a system runs on
+template <typename T>
+inline TVec2<T> VecCast(const Vec2 & v) noexcept
+{
+    return TVec2<T>(T(v.x), T(v.y));
+}
+
+// and back to float for whatever only draws or queries with it
+inline const Vec2 & FloatCast(const Vec2 & v) noexcept { return v; }
+inline Vec2 FloatCast(const FixedVec2 & v) noexcept { return Vec2(v.x.toFloat(), v.y.toFloat()); }
+
+// lets generic code ask for the largest and smallest value of its scalar
+namespace std
+{
+    template <>
+    class numeric_limits<Fixed>
+    {
+    public:
+        static const bool is_specialized = true;
+        static constexpr Fixed min() noexcept       { return Fixed::FromRaw(1); }
+        static constexpr Fixed max() noexcept       { return Fixed::FromRaw(INT32_MAX); }
+        static constexpr Fixed lowest() noexcept    { return Fixed::FromRaw(-INT32_MAX); }
+    };
+}
@@ -3,7 +3,8 @@
 #include "GameState_Play.h"
 #include "GameState_Menu.h"
 
-GameEngine::GameEngine(const std::string & path)
+GameEngine::GameEngine(const std::string & path, bool headless)
+    : m_headless(headless)
 {
     init(path);
 }
@@ -12,7 +13,9 @@ void GameEngine::init(const std::string & path)
 {
     m_assets.loadFromFile(path);
 
-    m_window.create(sf::VideoMode(1280, 768), "Game");
+    if (m_headless) { return; }
+
+    m_window.create(sf::VideoMode(m_windowSize.x, m_windowSize.y), "Game");
     m_window.setFramerateLimit(60);
 
     pushState(std::make_shared<GameState_Menu>(*this));
@@ -23,17 +26,35 @@ bool GameEngine::isRunning()
     return m_running & m_window.isOpen();
 }
 
+bool GameEngine::isHeadless() const
+{
+    return m_headless;
+}
+
 sf::RenderWindow & GameEngine::window()
 {
     return m_window;
 }
 
+const sf::Vector2u & GameEngine::windowSize() const
+{
+    return m_windowSize;
+}
+
 void GameEngine::run()
 {
     while (isRunning())
     {
         update();
     }
+
+    // destroy the states while the window and assets are still alive, which stops and joins
+    // the play state's simulation thread before anything it reads goes away
+    m_statesToPush.clear();
+    while (!m_states.empty())
+    {
+        m_states.pop_back();
+    }
 }
 
 void GameEngine::pushState(std::shared_ptr<GameState> state)
@@ -81,6 +102,11 @@ void GameEngine::quit()
 }
 
 const Assets & GameEngine::getAssets() const
+{
+    return m_assets;
+}
+
+Assets & GameEngine::assets()
 {
     return m_assets;
 }
\ No newline at end of file
@@ -11,12 +11,15 @@ class GameEngine
 
 protected:
 
-    std::vector<std::shared_ptr<GameState>> m_states;
-    std::vector<std::shared_ptr<GameState>> m_statesToPush;
+    // the window and assets are declared first so they outlive the states using them
     sf::RenderWindow                        m_window;
+    sf::Vector2u                            m_windowSize = { 1280, 768 };
     Assets                                  m_assets;
+    std::vector<std::shared_ptr<GameState>> m_states;
+    std::vector<std::shared_ptr<GameState>> m_statesToPush;
     size_t                                  m_popStates = 0;
     bool                                    m_running = true;
+    bool                                    m_headless = false;
 
     void init(const std::string & path);
     void update();
@@ -25,7 +28,9 @@ protected:
 
 public:
     
-    GameEngine(const std::string & path);
+    // a headless engine loads assets but opens no window and pushes no states,
+    // game states are then driven directly (used by the benchmarks)
+    GameEngine(const std::string & path, bool headless = false);
 
     void pushState(std::shared_ptr<GameState> state);
     void popState();
@@ -34,7 +39,10 @@ public:
     void run();
 
     sf::RenderWindow & window();
+    const sf::Vector2u & windowSize() const;
     bool isRunning();
+    bool isHeadless() const;
 
     const Assets & getAssets() const;
+    Assets & assets();
 };
\ No newline at end of file
@@ -6,11 +6,57 @@
 #include "Components.h"
 #include <math.h>
 
+// whether the boxes of two entities overlap, in the scalar the simulation runs on
+template <typename T>
+static bool Overlaps(Entity * a, Entity * b)
+{
+	auto overlap = Physics::Overlap(a->get<CTransform>().position<T>(), VecCast<T>(a->get<CBoundingBox>().halfSize),
+									b->get<CTransform>().position<T>(), VecCast<T>(b->get<CBoundingBox>().halfSize));
+	return overlap.x > T(0) && overlap.y > T(0);
+}
+
+// draw layer of each entity tag, anything unlisted draws on top
+static unsigned RenderLayer(const std::string & tag)
+{
+	if (tag == "tile")			{ return 0; }
+	if (tag == "npc")			{ return 1; }
+	if (tag == "player")		{ return 2; }
+	if (tag == "sword")			{ return 3; }
+	return 4;
+}
+
 GameState_Play::GameState_Play(GameEngine & game, const std::string & levelPath)
     : GameState(game)
+    , m_levelArena(256 * 1024)
+    , m_frameArena(64 * 1024)
+    , m_entityManager(&m_levelArena)
     , m_levelPath(levelPath)
+    , m_minimap(game.windowSize())
 {
     init(m_levelPath);
+
+    // with a window the simulation ticks on its own thread and this one only draws,
+    // a headless engine drives simulate() directly instead
+    if (!m_game.isHeadless())
+    {
+        m_watcher.watch(m_game.getAssets().sourceFiles());
+        m_watcher.watch(m_levelPath);
+
+        // the simulation thread only marks evicted textures it needs, this one loads them
+        m_game.assets().setDeferLoads(true);
+        m_simRunning = true;
+        m_simThread = std::thread(&GameState_Play::runSimulation, this);
+    }
+}
+
+GameState_Play::~GameState_Play()
+{
+    m_simRunning = false;
+    if (m_simThread.joinable())
+    {
+        m_simThread.join();
+        m_game.assets().setDeferLoads(false);
+    }
 }
 
 void GameState_Play::init(const std::string & levelPath)
@@ -20,81 +66,220 @@ void GameState_Play::init(const std::string & levelPath)
 
 void GameState_Play::loadLevel(const std::string & filename)
 {
-	// Input file
-	std::ifstream levelFile(filename);
+	// drop every entity of the previous level, then reclaim all of its memory in one shot
+	m_player.reset();
+	m_tree.clear();
+	m_minimapRooms.clear();
+	m_changedTileRooms.clear();
+	m_levelRooms.clear();
+	m_tilemap.clear();
+	m_entityManager = EntityManager(&m_levelArena);
+	m_transforms.clear();
+	m_transforms.setFixed(m_deterministic);
+	m_activity.reset(Vec2((float)m_game.windowSize().x, (float)m_game.windowSize().y));
+	m_behaviours.reset();
+	m_particles.clear();
+	m_fieldOfView = FieldOfView();
+	// last, since anything still holding level memory gives it back to the arena when released
+	m_levelArena.reset();
 
-	std::string animationName, token, aibehav;
-	Vec2 patrolPos;
-	int tileposX, tileposY, roomposX, roomposY, blockM, blockV, patrolPosNumber;
-	float followSpeed, patrolSpeed;
-	
-	while (levelFile.good()) {
-		levelFile >> token;
-
-		// Store player config values 
-		if (token == "Player") {
-			levelFile >> m_playerConfig.X >> m_playerConfig.Y
-				>> m_playerConfig.CX >> m_playerConfig.CY >> m_playerConfig.SPEED;
-		}
-		// Create a tile entity using the config values
-		if (token == "Tile") {
-			auto tile = m_entityManager.addEntity("tile");
-			levelFile >> animationName >> roomposX >> roomposY >> tileposX >> tileposY >> blockM >> blockV;
-			auto roomOrigin		= Vec2(m_game.window().getSize().x * (float)roomposX, m_game.window().getSize().y * (float)roomposY);
-			auto tilePos		= Vec2(tileposX, tileposY);
-			auto animation		= m_game.getAssets().getAnimation(animationName);
-			auto tileRoomPos	= roomOrigin + (tilePos * animation.getSize().x);
-
-			tile->addComponent<CAnimation>	(animation, true);
-			tile->addComponent<CBoundingBox>(animation.getSize(), blockM, blockV);
-			tile->addComponent<CTransform>	(tileRoomPos + tile->getComponent<CBoundingBox>()->halfSize);
-		}
-		// Create an NPC entity using the config values
-		if (token == "NPC") {
-			auto npc = m_entityManager.addEntity("npc");
-			levelFile >> animationName >> roomposX >> roomposY >> tileposX >> tileposY >> blockM >> blockV >> aibehav;
-			auto roomOrigin		= Vec2(m_game.window().getSize().x * (float)roomposX, m_game.window().getSize().y * (float)roomposY);
-			auto tilePos		= Vec2(tileposX, tileposY);
-			auto animation		= m_game.getAssets().getAnimation(animationName);
-			auto NPCRoomPos		= roomOrigin + (tilePos * animation.getSize().x);
-
-			npc->addComponent<CBoundingBox>	(m_game.getAssets().getAnimation(animationName).getSize(), blockM, blockV);
-			npc->addComponent<CTransform>	(NPCRoomPos + npc->getComponent<CBoundingBox>()->halfSize);
-			npc->addComponent<CAnimation>	(animation, true);
-			
-			// If the NPC is patrol-type
-			if (aibehav == "Patrol") {
-				levelFile >> patrolSpeed >> patrolPosNumber;
-				std::vector<Vec2> positions;
-
-				npc->addComponent<CPatrol>(positions, patrolSpeed);
-				
-				// Store the patrol positions in the vector included in the CPatrol component
-				for (auto i = 0; i < patrolPosNumber; i++) {
-					levelFile >> patrolPos.x >> patrolPos.y;
-					auto patrolRoomPos = roomOrigin + (patrolPos * animation.getSize().x);
-					npc->getComponent<CPatrol>()->positions.push_back(patrolRoomPos + npc->getComponent<CBoundingBox>()->halfSize);
-				}	
-			}
-			// If the NPC is a follow-type
-			if (aibehav == "Follow") {
-				levelFile >> followSpeed;
-				npc->addComponent<CFollowPlayer>(npc->getComponent<CTransform>()->pos, followSpeed);
-				npc->getComponent<CFollowPlayer>()->home = npc->getComponent<CTransform>()->pos;
-			}
+	sf::Clock loadClock;
+
+	// parse the whole file on worker threads first, then create entities in file order
+	std::vector<LevelChunk> chunks;
+	LevelParser::Parse(filename, m_game.getAssets(), chunks, &m_parseStats);
+
+	for (auto & chunk : chunks) {
+		// Store player config values, a later Player line overrides an earlier one
+		if (chunk.hasPlayer) {
+			m_playerConfig = { chunk.player.x, chunk.player.y, chunk.player.cx, chunk.player.cy, chunk.player.speed };
+		}
+
+		for (auto & record : chunk.records) {
+			auto & room = m_levelRooms[std::make_pair(record.roomX, record.roomY)];
+			room.hash = LevelParser::HashCombine(room.hash, LevelParser::Hash(record, chunk));
+			spawnLevelRecord(record, chunk, room);
 		}
+	}
+
+	// the tiles are all in, uniform chunks become runs
+	m_tilemap.compress();
+	buildNavGrid(m_tilemap.cellSize());
+	buildFieldOfView(m_tilemap.cellSize());
 
+	// the minimap's tile queues are made up front and sized for a room full of tiles, so
+	// walking into rooms it has not shown yet does not allocate
+	GridCell min, max;
+	roomCells(std::make_pair(0, 0), min, max);
+	m_minimapSpare.clear();
+	for (size_t i = 0; i < Minimap::KeepCount; i++) {
+		m_minimapSpare.push_back(std::make_shared<RenderQueue>());
+		m_minimapSpare.back()->reserve((size_t)(max.x - min.x + 1) * (max.y - min.y + 1), m_tilemap.typeCount());
 	}
 
     // spawn the player at the start of the game
     spawnPlayer();
+
+	m_systemTimes.load = loadClock.getElapsedTime().asMicroseconds();
+}
+
+void GameState_Play::reloadLevel(const std::string & filename)
+{
+	std::vector<LevelChunk> chunks;
+	if (!LevelParser::Parse(filename, m_game.getAssets(), chunks, &m_parseStats)) { return; }
+
+	// hash the rooms of the new file the same way loadLevel did
+	std::map<std::pair<int, int>, size_t> hashes;
+	for (auto & chunk : chunks) {
+		if (chunk.hasPlayer) {
+			m_playerConfig = { chunk.player.x, chunk.player.y, chunk.player.cx, chunk.player.cy, chunk.player.speed };
+		}
+		for (auto & record : chunk.records) {
+			auto & hash = hashes[std::make_pair(record.roomX, record.roomY)];
+			hash = LevelParser::HashCombine(hash, LevelParser::Hash(record, chunk));
+		}
+	}
+
+	// rooms that were edited, added or removed lose everything they spawned
+	std::set<std::pair<int, int>> changed;
+	for (auto & room : m_levelRooms) {
+		auto hash = hashes.find(room.first);
+		if (hash == hashes.end() || hash->second != room.second.hash) { changed.insert(room.first); }
+	}
+	for (auto & hash : hashes) {
+		if (m_levelRooms.find(hash.first) == m_levelRooms.end()) { changed.insert(hash.first); }
+	}
+	if (changed.empty()) { return; }
+
+	for (auto & key : changed) {
+		auto room = m_levelRooms.find(key);
+		if (room == m_levelRooms.end()) { continue; }
+		for (auto & entity : room->second.entities) {
+			if (auto e = entity.lock()) { e->destroy(); }
+		}
+		m_levelRooms.erase(room);
+	}
+	for (auto & key : changed) {
+		GridCell min, max;
+		roomCells(key, min, max);
+		m_tilemap.clear(min, max);
+		m_changedTileRooms.push_back(key);
+	}
+
+	// then spawn their new lines, still in file order
+	for (auto & chunk : chunks) {
+		for (auto & record : chunk.records) {
+			auto key = std::make_pair(record.roomX, record.roomY);
+			if (!changed.count(key)) { continue; }
+
+			auto & room = m_levelRooms[key];
+			room.hash = hashes[key];
+			spawnLevelRecord(record, chunk, room);
+		}
+	}
+
+	m_tilemap.compress();
+	buildNavGrid(m_tilemap.cellSize());
+	buildFieldOfView(m_tilemap.cellSize());
+	std::cout << "Reloaded " << changed.size() << " of " << hashes.size() << " rooms from " << filename << std::endl;
+}
+
+void GameState_Play::spawnLevelRecord(const LevelRecord & record, const LevelChunk & chunk, LevelRoom & room)
+{
+	auto roomSize		= m_game.windowSize();
+	auto roomOrigin		= Vec2(roomSize.x * (float)record.roomX, roomSize.y * (float)record.roomY);
+	auto tilePos		= Vec2(record.tileX, record.tileY);
+
+	// Write the tile's type into the tilemap, the type and its animation copy are made once per kind of tile
+	if (record.type == LevelRecord::Tile) {
+		auto id = m_tilemap.findType(record.animation->getName(), record.blockMove, record.blockVision, record.layer, record.mask);
+		if (id == 0) {
+			id = m_tilemap.addType(m_game.getAssets().getAnimation(*record.animation), record.blockMove, record.blockVision, record.layer, record.mask);
+		}
+		m_tilemap.set(m_tilemap.cellOf(roomOrigin + (tilePos * record.animation->getSize().x)), id);
+		return;
+	}
+
+	auto animation		= m_game.getAssets().getAnimation(*record.animation);
+	auto roomPos		= roomOrigin + (tilePos * animation.getSize().x);
+
+	// Create an NPC entity using the config values
+	auto npc = m_entityManager.addEntity("npc");
+	npc->addComponent<CBoundingBox>	(animation.getSize(), record.blockMove, record.blockVision, record.layer, record.mask);
+	npc->addComponent<CTransform>	(roomPos + npc->getComponent<CBoundingBox>()->halfSize, &m_transforms);
+	npc->addComponent<CAnimation>	(animation, true);
+	npc->addComponent<CActivity>	();
+	room.entities.push_back(npc);
+
+	// If the NPC is patrol-type
+	if (record.behaviour == LevelRecord::Patrol) {
+		auto patrol = npc->addComponent<CPatrol>(record.speed, &m_levelArena);
+		patrol->positions.reserve(record.patrolCount);
+
+		// Store the patrol positions in the vector included in the CPatrol component
+		for (uint32_t i = 0; i < record.patrolCount; i++) {
+			auto patrolRoomPos = roomOrigin + (chunk.patrol[record.patrolBegin + i] * animation.getSize().x);
+			patrol->positions.push_back(patrolRoomPos + npc->getComponent<CBoundingBox>()->halfSize);
+		}
+		npc->addComponent<CBehaviour>(std::allocate_shared<PatrolBehaviour>(ArenaAllocator<PatrolBehaviour>(&m_levelArena)));
+	}
+	// If the NPC is a follow-type
+	if (record.behaviour == LevelRecord::Follow) {
+		auto & pos = npc->getComponent<CTransform>()->pos();
+		npc->addComponent<CFollowPlayer>(pos, record.speed);
+		npc->getComponent<CFollowPlayer>()->home = pos;
+		npc->addComponent<CBehaviour>(std::allocate_shared<FollowBehaviour>(ArenaAllocator<FollowBehaviour>(&m_levelArena)));
+	}
+}
+
+void GameState_Play::buildNavGrid(const Vec2 & cellSize)
+{
+	// Build the navigation grid, one cell per tile and one room per window
+	auto roomSize = m_game.windowSize();
+	std::vector<GridCell> blockedCells;
+	m_tilemap.forEach([&](const GridCell & cell, const TileType & type) {
+		if (type.blockMove) { blockedCells.push_back(cell); }
+	});
+	m_navGrid.build(cellSize, GridCell((int)(roomSize.x / cellSize.x), (int)(roomSize.y / cellSize.y)), blockedCells);
+}
+
+void GameState_Play::buildFieldOfView(const Vec2 & cellSize)
+{
+	// The field of view covers every room of the level and reaches the far corners of the
+	// rooms around the player's, so every NPC that can think is inside it
+	auto roomSize = m_game.windowSize();
+	GridCell roomCells((int)(roomSize.x / cellSize.x), (int)(roomSize.y / cellSize.y));
+	GridCell minRoom, maxRoom;
+	if (!m_levelRooms.empty()) {
+		minRoom = maxRoom = GridCell(m_levelRooms.begin()->first.first, m_levelRooms.begin()->first.second);
+	}
+	for (auto & room : m_levelRooms) {
+		minRoom.x = std::min(minRoom.x, room.first.first);	minRoom.y = std::min(minRoom.y, room.first.second);
+		maxRoom.x = std::max(maxRoom.x, room.first.first);	maxRoom.y = std::max(maxRoom.y, room.first.second);
+	}
+	std::vector<GridCell> opaqueCells;
+	m_tilemap.forEach([&](const GridCell & cell, const TileType & type) {
+		if (type.blockVision) { opaqueCells.push_back(cell); }
+	});
+	m_fieldOfView.setRadius((int)ceil(sqrt((float)(4 * roomCells.x * roomCells.x + 4 * roomCells.y * roomCells.y))));
+	m_fieldOfView.build(cellSize, roomCells, minRoom, maxRoom, opaqueCells);
+}
+
+void GameState_Play::roomCells(const std::pair<int, int> & room, GridCell & min, GridCell & max) const
+{
+	auto roomSize	= m_game.windowSize();
+	auto & cellSize	= m_tilemap.cellSize();
+	int width		= (int)(roomSize.x / cellSize.x);
+	int height		= (int)(roomSize.y / cellSize.y);
+	min = GridCell(room.first * width, room.second * height);
+	max = GridCell(min.x + width - 1, min.y + height - 1);
 }
 
 void GameState_Play::spawnPlayer()
 {
     m_player = m_entityManager.addEntity("player");
-    m_player->addComponent<CTransform>	(Vec2(m_playerConfig.X, m_playerConfig.Y));
-	m_player->addComponent<CBoundingBox>(Vec2(m_playerConfig.CX, m_playerConfig.CY), 0, 0);
+    m_player->addComponent<CTransform>	(Vec2(m_playerConfig.X, m_playerConfig.Y), &m_transforms);
+	m_player->addComponent<CBoundingBox>(Vec2(m_playerConfig.CX, m_playerConfig.CY), 0, 0, CollisionLayer::Player, CollisionLayer::Tile | CollisionLayer::Npc);
     m_player->addComponent<CAnimation>	(m_game.getAssets().getAnimation("StandDown"), true);
     m_player->addComponent<CInput>		();
     
@@ -110,8 +295,8 @@ void GameState_Play::spawnSword(std::shared_ptr<Entity> entity)
 		std::string sword_animations[]	= {"SwordRight", "SwordUp"};
 
 		sword->addComponent<CAnimation>		(m_game.getAssets().getAnimation(sword_animations[eTransform->facing.y != 0]), true);
-		sword->addComponent<CBoundingBox>	(sword->getComponent<CAnimation>()->animation.getSize(), 0, 0);
-		sword->addComponent<CTransform>		(eTransform->pos + (eTransform->facing * (entity->getComponent<CBoundingBox>()->halfSize.x + sword->getComponent<CBoundingBox>()->halfSize.x)));
+		sword->addComponent<CBoundingBox>	(sword->getComponent<CAnimation>()->animation.getSize(), 0, 0, CollisionLayer::Sword, CollisionLayer::Npc);
+		sword->addComponent<CTransform>		(eTransform->pos() + (eTransform->facing * (entity->getComponent<CBoundingBox>()->halfSize.x + sword->getComponent<CBoundingBox>()->halfSize.x)), &m_transforms);
 		sword->addComponent<CLifeSpan>		(150);
 		if (eTransform->facing.x != 0) {
 			sword->getComponent<CTransform>()->scale.x = eTransform->facing.x;
@@ -123,137 +308,374 @@ void GameState_Play::spawnSword(std::shared_ptr<Entity> entity)
 	
 }
 
-void GameState_Play::update()
+void GameState_Play::simulate()
 {
+    // reloading is deferred to the top of the frame so no system still holds level memory
+    if (m_events.drain<ReloadEvent>([](const ReloadEvent &) {}) > 0)
+    {
+        init(m_levelPath);
+    }
+
+    m_frameArena.reset();
     m_entityManager.update();
+    sHotReload();
+
+    // bring the tree up to date with entities added and removed by the update
+    // so this tick's queries already see them; moved entities are refit after the systems
+    sBroadPhase();
+
+    // wake and put to sleep NPCs around the player before any system looks at them
+    sf::Clock activityClock;
+    sActivity();
+    m_systemTimes.activity = activityClock.getElapsedTime().asMicroseconds();
 
 	// Pause/resume functionality
     if (!m_paused)
     {
-        sAI();
-        sMovement();
-        sLifespan();
-        sCollision();
-        sAnimation();
+        sf::Clock clock;
+        sAI();          m_systemTimes.ai        = clock.restart().asMicroseconds();
+        sMovement();    m_systemTimes.movement  = clock.restart().asMicroseconds();
+        sLifespan();    m_systemTimes.lifespan  = clock.restart().asMicroseconds();
+        sCollision();   m_systemTimes.collision = clock.restart().asMicroseconds();
+        sAnimation();   m_systemTimes.animation = clock.restart().asMicroseconds();
+        sParticles();   m_systemTimes.particles = clock.restart().asMicroseconds();
     }
 
+    sEvents();
+
+    sBroadPhase();
+}
+
+const FrameMemoryStats & GameState_Play::getMemoryStats() const
+{
+    return m_memoryStats;
+}
+
+const RenderStats & GameState_Play::getRenderStats() const
+{
+    return m_renderStats;
+}
+
+const LevelParseStats & GameState_Play::getParseStats() const
+{
+    return m_parseStats;
+}
+
+const CollisionStats & GameState_Play::getCollisionStats() const
+{
+    return m_collisionStats;
+}
+
+const ActivityStats & GameState_Play::getActivityStats() const
+{
+    return m_activity.getStats();
+}
+
+const BehaviourStats & GameState_Play::getBehaviourStats() const
+{
+    return m_behaviours.getStats();
+}
+
+const FieldOfViewStats & GameState_Play::getFieldOfViewStats() const
+{
+    return m_fieldOfView.getStats();
+}
+
+TilemapStats GameState_Play::getTilemapStats() const
+{
+    return m_tilemap.stats();
+}
+
+void GameState_Play::setActivityEnabled(bool enabled)
+{
+    m_activity.setEnabled(enabled);
+}
+
+void GameState_Play::setFieldOfViewEnabled(bool enabled)
+{
+    m_useFieldOfView = enabled;
+}
+
+void GameState_Play::setDeterministic(bool enabled)
+{
+    if (enabled == m_deterministic) { return; }
+
+    // every transform is created again in the pool's new layout
+    m_deterministic = enabled;
+    init(m_levelPath);
+}
+
+void GameState_Play::setPlayerInput(bool up, bool down, bool left, bool right, bool attack)
+{
+    auto & input    = m_player->get<CInput>();
+    input.up        = up;
+    input.down      = down;
+    input.left      = left;
+    input.right     = right;
+    if (attack) { spawnSword(m_player); }
+}
+
+uint64_t GameState_Play::simulationHash()
+{
+    // FNV-1a over the entities in the manager's order
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](const void * data, size_t size) {
+        for (size_t i = 0; i < size; i++) { hash = (hash ^ static_cast<const unsigned char *>(data)[i]) * 1099511628211ull; }
+    };
+    for (auto & e : m_entityManager.getEntities()) {
+        if (!e->hasComponent<CTransform>()) { continue; }
+        auto & transform = e->get<CTransform>();
+        size_t id = e->id();
+        mix(&id, sizeof(id));
+        if (m_deterministic) {
+            int32_t raw[2] = { transform.fixedPos().x.raw(), transform.fixedPos().y.raw() };
+            mix(raw, sizeof(raw));
+        }
+        else {
+            mix(&transform.pos(), sizeof(transform.pos()));
+        }
+    }
+    return hash;
+}
+
+void GameState_Play::entityPositions(std::vector<std::pair<size_t, Vec2>> & positions)
+{
+    positions.clear();
+    for (auto & e : m_entityManager.getEntities()) {
+        if (e->hasComponent<CTransform>()) { positions.push_back(std::make_pair(e->id(), e->get<CTransform>().pos())); }
+    }
+    std::sort(positions.begin(), positions.end(), [](const std::pair<size_t, Vec2> & a, const std::pair<size_t, Vec2> & b) { return a.first < b.first; });
+}
+
+const SystemTimes & GameState_Play::getSystemTimes() const
+{
+    return m_systemTimes;
+}
+
+size_t GameState_Play::entityCount()
+{
+    return m_entityManager.getEntities().size();
+}
+
+void GameState_Play::update()
+{
+    // this is the thread that owns the window: forward its input to the simulation
+    // and draw whichever snapshot the simulation published last
+    forwardInput();
+    updateAssets();
+
+    auto & snapshot = m_snapshots.front();
+    snapshot.draw(m_game.window());
+    m_minimap.draw(m_game.window(), snapshot.minimap);
+    m_game.window().display();
+    m_renderStats = snapshot.sprites.stats();
+}
+
+void GameState_Play::tick()
+{
+    size_t heapAllocations = GetHeapAllocationCount();
+    simulate();
+
+    sf::Clock systemClock;
     sUserInput();
     sRender();
+    m_systemTimes.render = systemClock.getElapsedTime().asMicroseconds();
+
+    m_memoryStats.heapAllocations   = GetHeapAllocationCount() - heapAllocations;
+    m_memoryStats.scratchBytes      = m_frameArena.bytesUsed();
+    m_memoryStats.levelBytes        = m_levelArena.bytesUsed();
+}
+
+void GameState_Play::runSimulation()
+{
+    // tick at the 60Hz the window's frame limit used to impose, without waiting on it
+    const sf::Int64 tickMicros = 1000000 / 60;
+    sf::Clock clock;
+    sf::Int64 nextTick = 0;
+
+    while (m_simRunning)
+    {
+        {
+            // released between ticks so the window thread can reload assets
+            std::lock_guard<std::mutex> lock(m_simMutex);
+            tick();
+        }
+
+        nextTick += tickMicros;
+        sf::Int64 wait = nextTick - clock.getElapsedTime().asMicroseconds();
+        if (wait > 0)
+        {
+            sf::sleep(sf::microseconds(wait));
+        }
+        else if (wait < -4 * tickMicros)
+        {
+            // far behind, drop the backlog rather than running ticks back to back to catch up
+            nextTick = clock.getElapsedTime().asMicroseconds();
+        }
+    }
+}
+
+void GameState_Play::sActivity()
+{
+	// Forget NPCs removed by the last update and place the ones spawned since
+	for (auto & e : m_entityManager.getRemoved()) {
+		if (e->hasComponent<CActivity>()) {
+			m_activity.remove(e.get());
+		}
+		m_behaviours.remove(e.get());
+	}
+	for (auto e : m_entityManager.getChanged<CActivity>()) {
+		if (e->isActive() && !e->get<CActivity>().tracked) {
+			m_activity.insert(e);
+		}
+	}
+
+	m_activity.update(m_player->get<CTransform>().pos());
 }
 
 void GameState_Play::sMovement()
+{
+	if (m_deterministic) { moveEntities<Fixed>(); }
+	else { moveEntities<float>(); }
+}
+
+template <typename T>
+void GameState_Play::moveEntities()
 {
 	auto player_movement	= m_player->getComponent<CInput>();
 	auto player_transform	= m_player->getComponent<CTransform>();
 	auto player_facing		= m_player->getComponent<CTransform>()->facing;
+	auto & player_speed		= player_transform->velocity<T>();
 
 	// Stop moving in the y direction when there is no up/down input or the current input is left/right
 	if (!player_movement->up && !player_movement->down || player_movement->left || player_movement->right) {
-		player_transform->speed.y = 0;
+		player_speed.y = T(0);
 	}
 	// Stop moving in the x direction when there is no left/right input or the current input is up/down
 	if (!player_movement->left && !player_movement->right || player_movement->up || player_movement->down) {
-		player_transform->speed.x = 0;
+		player_speed.x = T(0);
 	}
 
 	// LEFT input
 	if (player_movement->left) {
-		player_transform->speed.x = -m_playerConfig.SPEED;
+		player_speed.x = -T(m_playerConfig.SPEED);
 		player_transform->scale.x = -1;
 		player_facing = Vec2(-1, 0);
 	}
 	// RIGHT input
 	else if (player_movement->right) {
-		player_transform->speed.x = m_playerConfig.SPEED;
+		player_speed.x = T(m_playerConfig.SPEED);
 		player_transform->scale.x = 1;
 		player_facing = Vec2(1, 0);
 	}
 	// UP input
 	else if (player_movement->up) {
-		player_transform->speed.y = -m_playerConfig.SPEED;
+		player_speed.y = -T(m_playerConfig.SPEED);
 		player_facing = Vec2(0, -1);
 	}
 	// DOWN input
 	else if (player_movement->down) {
-		player_transform->speed.y = m_playerConfig.SPEED;
+		player_speed.y = T(m_playerConfig.SPEED);
 		player_facing = Vec2(0, 1);
 	}
+	player_transform->syncFloat<T>();
 
-	player_transform->prevPos = player_transform->pos;
-	player_transform->pos += player_transform->speed;
+	// move the player and every NPC by the speed set this tick in one pass over the hot transform arrays
+	m_transforms.integrate();
+
+	// only flag the transform as changed when the player actually moved or turned
+	if (player_speed != TVec2<T>() || player_transform->facing != player_facing) {
+		m_player->markChanged<CTransform>();
+	}
 	m_player->getComponent<CTransform>()->facing = player_facing;
 
 	// update sword's position so that the sword moves with the player
 	for (auto sword : m_entityManager.getEntities("sword")) {
-		sword->getComponent<CTransform>()->pos = (player_transform->pos + (player_transform->facing * (m_player->getComponent<CBoundingBox>()->halfSize.x + sword->getComponent<CBoundingBox>()->halfSize.x)));
+		auto sword_transform	= sword->getComponent<CTransform>();
+		auto reach				= T(m_player->getComponent<CBoundingBox>()->halfSize.x) + T(sword->getComponent<CBoundingBox>()->halfSize.x);
+		auto sword_pos			= player_transform->position<T>() + (VecCast<T>(player_transform->facing) * reach);
+		if (sword_transform->position<T>() != sword_pos) {
+			sword_transform->position<T>() = sword_pos;
+			sword_transform->syncFloat<T>();
+			sword->markChanged<CTransform>();
+		}
 	}
 }
 
 void GameState_Play::sAI()
 {
-	auto npcs = m_entityManager.getEntities("npc");
+	auto & player_transform	= m_player->get<CTransform>();
 
-	for (auto npc : npcs) {
-		// Patrol NPC :
-		// Move the NPC from current position to the next position using the positions vector in the CPatrol component
-		// When the last patrol position has been reached, go to the first position and repeat
-		if (npc->hasComponent<CPatrol>()) {
-			auto patrol			= npc->getComponent<CPatrol>();
-			auto transform		= npc->getComponent<CTransform>();
-			auto nextPosition	= (patrol->currentPosition + 1) % int(patrol->positions.size());
-			auto direction		= patrol->positions[nextPosition] - patrol->positions[patrol->currentPosition];
-
-			transform->pos	+= Vec2(patrol->speed * ((direction.x > 0) - (direction.x < 0)), patrol->speed * ((direction.y > 0) - (direction.y < 0)));
-			if (transform->pos.dist(patrol->positions[nextPosition]) <= 5) {
-				patrol->currentPosition = nextPosition;
+	// Rebuild the flow field toward the player only when the player has entered a new cell
+	m_navGrid.updateFlowField(player_transform.pos());
+
+	// Cast the player's field of view again only when the player has entered a new cell
+	m_fieldOfView.update(player_transform.pos());
+
+	// Without the field of view or the tree, gather the vision-blocking entities once per frame into scratch memory
+	ArenaVector<Entity *> blockers(&m_frameArena);
+	if (!m_useFieldOfView && m_broadPhase == BroadPhase::Naive) {
+		blockers.reserve(m_entityManager.getEntities().size());
+		for (auto & entity : m_entityManager.getEntities()) {
+			if (entity->hasComponent<CBoundingBox>() && entity->getComponent<CBoundingBox>()->blockVision) {
+				blockers.push_back(entity.get());
 			}
 		}
-		// Follow NPC
-		// If there are no vision-blocking entities in the way, set goal of NPC to player, otherwise set goal to home using the Vec2 in CFollowPlayer component
-		if (npc->hasComponent<CFollowPlayer>()) {
-			auto followPlayer		= npc->getComponent<CFollowPlayer>();
-			auto transform			= npc->getComponent<CTransform>();
-			auto player_transform	= m_player->getComponent<CTransform>();
-			bool follow				= true;
-			
-			// Check for vision-blocking entities
-			for (auto entity : m_entityManager.getEntities()) {
-				if (entity->hasComponent<CBoundingBox>() && entity->getComponent<CBoundingBox>()->blockVision) {
-					if (Physics::EntityIntersect(transform->pos, player_transform->pos, entity)) {
-						follow = false;
-						break;
-					}
-				}
-			}
+	}
 
-			// set goal to player (default behavior)
-			auto direction	= player_transform->pos - transform->pos;
-			// set goal to home if vision is blocked
-			if (!follow) {
-				if (transform->pos.dist(followPlayer->home) > 5.0f) {		// stop heading to home if npc is within 5 pixels of home. This prevents the NPC from oscilating around or overshooting the target
-					direction = followPlayer->home - transform->pos;
-				}
-				else {
-					direction *= 0;
-				}
-			}
-			
-			// move towards goal with speed equal to the ratio of the vector to goal
-			float speedx = followPlayer->speed;
-			float speedy = followPlayer->speed;
-			// if x distance is larger, change y speed to the fraction of actual speed according to the ratio
-			if (abs(direction.x) > abs(direction.y)) {
-				speedy = abs(speedy * ((float)direction.y / (float)direction.x));
+	// Patrol and follow NPCs run their behaviours, resumed only when what they wait for happens
+	BehaviourContext context;
+	context.playerPos		= player_transform.pos();
+	if (m_deterministic) {
+		context.fixedPlayerPos	= player_transform.fixedPos();
+	}
+	context.deterministic	= m_deterministic;
+	context.navGrid			= &m_navGrid;
+	context.canSeePlayer	= [&](Entity & npc) { return canSeePlayer(npc, blockers); };
+	m_behaviours.update(m_activity, context);
+}
+
+bool GameState_Play::canSeePlayer(Entity & npc, const ArenaVector<Entity *> & blockers)
+{
+	auto & transform		= npc.get<CTransform>();
+	auto & player_transform	= m_player->get<CTransform>();
+	bool visible			= true;
+
+	// The NPC sees the player when it stands in a cell the player sees, one lookup in the cached set,
+	// and deterministic mode always looks it up since it only compares integer cells
+	if (m_useFieldOfView || m_deterministic) {
+		return m_fieldOfView.canSee(transform.pos());
+	}
+
+	// Tiles are walked cell by cell along the line of sight
+	if (m_tilemap.blocksVision(transform.pos(), player_transform.pos())) {
+		return false;
+	}
+
+	// Then the vision-blocking entities
+	// with the tree only the entities around the line of sight are tested
+	auto isBlocker = [&](Entity * entity) {
+		return Physics::EntityIntersect(transform.pos(), player_transform.pos(), entity);
+	};
+	if (m_broadPhase == BroadPhase::Tree) {
+		AABB sight(Vec2(std::min(transform.pos().x, player_transform.pos().x), std::min(transform.pos().y, player_transform.pos().y)),
+				   Vec2(std::max(transform.pos().x, player_transform.pos().x), std::max(transform.pos().y, player_transform.pos().y)));
+		m_tree.query(sight, [&](Entity * entity) {
+			if (entity->hasComponent<CBoundingBox>() && entity->getComponent<CBoundingBox>()->blockVision && isBlocker(entity)) {
+				visible = false;
 			}
-			// if y distance is larger, change x speed to the fraction of actual speed according to the ratio
-			else if (abs(direction.x) < abs(direction.y)) {
-				speedx = abs(speedx * ((float)direction.x / (float)direction.y));
+			return visible;
+		});
+	}
+	else {
+		for (auto entity : blockers) {
+			if (isBlocker(entity)) {
+				visible = false;
+				break;
 			}
-			
-			transform->prevPos	 = transform->pos;
-			transform->pos		+= Vec2(speedx * ((direction.x > 0) - (direction.x < 0)), speedy * ((direction.y > 0) - (direction.y < 0)));
 		}
 	}
+	return visible;
 }
 
 void GameState_Play::sLifespan()
@@ -262,7 +684,7 @@ void GameState_Play::sLifespan()
 	for (auto e : m_entityManager.getEntities()) {
 		if (e->hasComponent<CLifeSpan>()) {
 			auto lifespan = e->getComponent<CLifeSpan>();
-			if (lifespan->clock.getElapsedTime().asMilliseconds() >= lifespan->lifespan) {
+			if (++lifespan->ticks * 1000 >= lifespan->lifespan * 60) {
 				e->destroy();
 			}
 		}
@@ -271,70 +693,233 @@ void GameState_Play::sLifespan()
 
 void GameState_Play::sCollision()
 {
-	auto tiles				= m_entityManager.getEntities("tile");
-	auto player_transform	= m_player->getComponent<CTransform>();
+	// Sleeping NPCs neither move nor can reach the player, only the ones around the player are tested
+	auto & npcs = m_activity.active();
+
+	// Tiles never move: every other body is swept against the tiles on the layers in its mask
+	auto resolveTiles = [&](Entity * entity) {
+		if (m_deterministic) { resolveTileCollisions<Fixed>(entity); }
+		else { resolveTileCollisions<float>(entity); }
+	};
+	resolveTiles(m_player.get());
+	for (auto npc : npcs) {
+		resolveTiles(npc);
+	}
 
-	// Check tile collisions
-	for (auto tile : tiles) {
+	// The moving bodies, in the order their contacts are handled
+	ArenaVector<Entity *> bodies(&m_frameArena);
+	bodies.reserve(npcs.size() + 2);
+	bodies.push_back(m_player.get());
+	for (auto & sword : m_entityManager.getEntities("sword")) {
+		bodies.push_back(sword.get());
+	}
+	bodies.insert(bodies.end(), npcs.begin(), npcs.end());
 
-		// Tile with player
-		auto current_overlap	= Physics::GetOverlap(tile, m_player);
-		auto previous_overlap	= Physics::GetPreviousOverlap(tile, m_player);
+	// Collect the overlapping pairs where b's layer is in a's mask. The layer test comes before any
+	// geometry, so bodies whose mask only holds Tile (every NPC by default) cost one AND per pair.
+	ArenaVector<std::pair<Entity *, Entity *>> contacts(&m_frameArena);
+	m_collisionStats = CollisionStats();
+	m_collisionStats.bodies = bodies.size();
+	for (auto a : bodies) {
+		auto mask = a->get<CBoundingBox>().mask & ~CollisionLayer::Tile;
+		if (!mask) { continue; }
 
-		if (current_overlap.x > 0 && current_overlap.y > 0 && tile->getComponent<CBoundingBox>()->blockMove) {
-			float delta_y = player_transform->prevPos.y - player_transform->pos.y;
-			float delta_x = player_transform->prevPos.x - player_transform->pos.x;
+		for (auto b : bodies) {
+			if (b == a || !(b->get<CBoundingBox>().layer & mask)) { continue; }
 
-			// If player came from above/below the tile
-			if (previous_overlap.x > 0) {
-				player_transform->pos.y += current_overlap.y * ((delta_y > 0) - (delta_y < 0));
-			}
-			// If player came from left/right of the tile
-			else if (previous_overlap.y > 0) {
-				player_transform->pos.x += current_overlap.x * ((delta_x > 0) - (delta_x < 0));
+			m_collisionStats.tests++;
+			if (m_deterministic ? Overlaps<Fixed>(a, b) : Overlaps<float>(a, b)) {
+				contacts.push_back(std::make_pair(a, b));
 			}
 		}
+	}
+	m_collisionStats.contacts = contacts.size();
 
-		// Check NPC collisions
-		for (auto npc : m_entityManager.getEntities("npc")) {
+	// Respond by layer, deaths are raised as events and handled by sEvents
+	bool playerKilled = false;
+	for (auto & contact : contacts) {
+		auto a		= contact.first;
+		auto b		= contact.second;
+		auto layerA	= a->get<CBoundingBox>().layer;
+		auto layerB	= b->get<CBoundingBox>().layer;
 
-			auto npc_transform		= npc->getComponent<CTransform>();
-			current_overlap			= Physics::GetOverlap(tile, npc);
-			previous_overlap		= Physics::GetPreviousOverlap(tile, npc);
-			auto player_npc_overlap = Physics::GetOverlap(npc, m_player);
+		// Player with NPC
+		if ((layerA & CollisionLayer::Player) && (layerB & CollisionLayer::Npc) && !playerKilled) {
+			m_events.publish(PlayerKilledEvent{ a->get<CTransform>().pos() });
+			playerKilled = true;
+		}
 
-			// Player with NPC
-			if (player_npc_overlap.x > 0 && player_npc_overlap.y > 0) {
-				m_player->destroy();
-				spawnPlayer();
-			}
+		// Sword with NPC: destroy the NPC, its explosion is spawned when the event is handled
+		if ((layerA & CollisionLayer::Sword) && (layerB & CollisionLayer::Npc) && b->isActive()) {
+			m_events.publish(NpcKilledEvent{ b->get<CTransform>().pos() });
+			b->destroy();
+		}
+	}
+}
 
-			// Tile with NPC
-			if (current_overlap.x > 0 && current_overlap.y > 0 && tile->getComponent<CBoundingBox>()->blockMove) {
-				float delta_y = npc_transform->prevPos.y - npc_transform->pos.y;
-				float delta_x = npc_transform->prevPos.x - npc_transform->pos.x;
+void GameState_Play::sEvents()
+{
+	// most ticks nobody died, and looking the animation up would count as a texture request
+	if (m_events.channel<NpcKilledEvent>().size() == 0 && m_events.channel<PlayerKilledEvent>().size() == 0) { return; }
 
-				if (previous_overlap.x > 0) {
-					npc_transform->pos.y += current_overlap.y * ((delta_y > 0) - (delta_y < 0));
-				}
-				else if (previous_overlap.y > 0) {
-					npc_transform->pos.x += current_overlap.x * ((delta_x > 0) - (delta_x < 0));
-				}
+	// Explosions are particles: one playing the whole animation where the NPC died, and a burst
+	// of small, short-lived ones flying off it. Hits only get the burst.
+	auto explosion = m_game.getAssets().getAnimation("Explosion");
+	ParticleEmitter blast;
+	blast.scaleMin		= 0.8f;
+	blast.scaleMax		= 0.8f;
+	ParticleEmitter debris;
+	debris.count		= 12;
+	debris.speedMin		= 2;
+	debris.speedMax		= 6;
+	debris.lifeMin		= 12;
+	debris.lifeMax		= 24;
+	debris.scaleMin		= 0.15f;
+	debris.scaleMax		= 0.3f;
+	debris.drag			= 0.9f;
+
+	// NPC killed: explode where it died
+	m_events.drain<NpcKilledEvent>([&](const NpcKilledEvent & e) {
+		m_particles.emit(explosion, e.pos, blast);
+		m_particles.emit(explosion, e.pos, debris);
+	});
+
+	// Player killed: burst where it was hit, then respawn at the level's start position
+	m_events.drain<PlayerKilledEvent>([&](const PlayerKilledEvent & e) {
+		m_particles.emit(explosion, e.pos, debris);
+		m_player->destroy();
+		spawnPlayer();
+	});
+}
+
+void GameState_Play::sParticles()
+{
+	m_particles.update();
+}
+
+template <typename T>
+void GameState_Play::resolveTileCollisions(Entity * entity)
+{
+	auto transform	= entity->getComponent<CTransform>();
+	auto & pos		= transform->position<T>();
+	auto & prevPos	= transform->previous<T>();
+	auto boxSize	= entity->getComponent<CBoundingBox>()->halfSize;
+	auto halfSize	= VecCast<T>(boxSize);
+
+	// Push the entity back out of a movement-blocking tile along the axis it came in on
+	auto resolve = [&](const TVec2<T> & tilePos, const TVec2<T> & tileHalfSize) {
+		auto current_overlap	= Physics::Overlap(tilePos, tileHalfSize, pos, halfSize);
+		auto previous_overlap	= Physics::Overlap(tilePos, tileHalfSize, prevPos, halfSize);
+
+		if (current_overlap.x > T(0) && current_overlap.y > T(0)) {
+			T delta_y = prevPos.y - pos.y;
+			T delta_x = prevPos.x - pos.x;
+
+			// If entity came from above/below the tile
+			if (previous_overlap.x > T(0)) {
+				pos.y += current_overlap.y * T((delta_y > T(0)) - (delta_y < T(0)));
+				entity->markChanged<CTransform>();
+			}
+			// If entity came from left/right of the tile
+			else if (previous_overlap.y > T(0)) {
+				pos.x += current_overlap.x * T((delta_x > T(0)) - (delta_x < T(0)));
+				entity->markChanged<CTransform>();
 			}
+		}
+	};
 
-			// Sword with NPC
-			for (auto sword : m_entityManager.getEntities("sword")) {
-				auto sword_npc_overlap = Physics::GetOverlap(npc, sword);
-
-				// destroy the NPC and play the explosion animation
-				if (sword_npc_overlap.x > 0 && sword_npc_overlap.y > 0) {
-					auto explosion = m_entityManager.addEntity("explosions");
-					explosion->addComponent<CAnimation>(m_game.getAssets().getAnimation("Explosion"), false);
-					explosion->addComponent<CTransform>(npc_transform->pos);
-					explosion->getComponent<CTransform>()->scale *= 0.8;
-					npc->destroy();
-				}
+	// Visit every tile on a layer in the entity's mask that could touch the given box,
+	// straight from the tilemap cells under it whatever the broad phase
+	auto mask			= entity->get<CBoundingBox>().mask;
+	auto forEachTile	= [&](const AABB & area, auto && fn) {
+		m_tilemap.forEach(area, [&](const GridCell & cell, const TileType & type) {
+			if (type.layer & mask) {
+				fn(VecCast<T>(m_tilemap.tileCenter(cell, type)), VecCast<T>(type.halfSize));
 			}
+		});
+	};
+
+	// Sweep the box from prevPos to pos and stop at the earliest tile it would hit, then slide
+	// the rest of the move along that tile's face. This stays correct however far the entity
+	// moved this tick, instead of relying on the step being smaller than a tile.
+	auto start		= Physics::SlideMove(prevPos, halfSize, pos - prevPos,
+		[&](const TVec2<T> & from, const TVec2<T> & to, auto && visit) {
+			forEachTile(AABB::Union(AABB::FromCenter(FloatCast(from), boxSize), AABB::FromCenter(FloatCast(to), boxSize)), visit);
+		});
+
+	if (start != pos) {
+		pos = start;
+		entity->markChanged<CTransform>();
+	}
+
+	// Anything that was already overlapping before the move (spawned or pushed inside a tile)
+	// is pushed back out along the axis it came in on
+	forEachTile(AABB::FromCenter(FloatCast(pos), boxSize), resolve);
+	transform->syncFloat<T>();
+}
+
+bool GameState_Play::entityBounds(Entity * entity, AABB & box)
+{
+	if (!entity->hasComponent<CTransform>()) { return false; }
+	auto transform = entity->getComponent<CTransform>();
+
+	if (entity->hasComponent<CBoundingBox>()) {
+		box = AABB::FromCenter(transform->pos(), entity->getComponent<CBoundingBox>()->halfSize);
+		return true;
+	}
+	// entities without a bounding box are still culled by the size of their sprite
+	if (entity->hasComponent<CAnimation>()) {
+		auto size = entity->getComponent<CAnimation>()->animation.getSize();
+		box = AABB::FromCenter(transform->pos(), Vec2(size.x * fabsf(transform->scale.x), size.y * fabsf(transform->scale.y)) / 2);
+		return true;
+	}
+	return false;
+}
+
+void GameState_Play::sBroadPhase()
+{
+	if (m_broadPhase != BroadPhase::Tree) { return; }
+
+	// Drop the leaves of entities removed this tick
+	for (auto & e : m_entityManager.getRemoved()) {
+		if (e->hasComponent<CTransform>() && e->getComponent<CTransform>()->proxy >= 0) {
+			m_tree.remove(e->getComponent<CTransform>()->proxy);
+			e->getComponent<CTransform>()->proxy = -1;
+		}
+	}
+
+	// Insert new entities and refit only the ones that moved; static tiles are never touched again
+	AABB box;
+	for (auto e : m_entityManager.getChanged<CTransform>()) {
+		if (!e->isActive() || !entityBounds(e, box)) { continue; }
+
+		auto transform = e->getComponent<CTransform>();
+		if (transform->proxy < 0) {
+			transform->proxy = m_tree.insert(box, e);
+		}
+		else {
+			m_tree.move(transform->proxy, box);
+		}
+	}
+}
+
+void GameState_Play::setBroadPhase(BroadPhase broadPhase)
+{
+	m_broadPhase = broadPhase;
+	m_tree.clear();
+
+	for (auto & e : m_entityManager.getEntities()) {
+		if (e->hasComponent<CTransform>()) {
+			e->getComponent<CTransform>()->proxy = -1;
+		}
+	}
+
+	if (m_broadPhase != BroadPhase::Tree) { return; }
+
+	AABB box;
+	for (auto & e : m_entityManager.getEntities()) {
+		if (e->isActive() && entityBounds(e.get(), box)) {
+			e->getComponent<CTransform>()->proxy = m_tree.insert(box, e.get());
 		}
 	}
 }
@@ -346,53 +931,49 @@ void GameState_Play::sAnimation()
 	bool hasSword			= m_entityManager.getEntities("sword").size() > 0;
 	auto animation			= "StandDown";
 
-	// If player is stationary
-	if (player_transform->pos == player_transform->prevPos) {
+	// If player is attacking
+	if (hasSword) {
 		if (player_transform->facing.x == 0) {
-			if (player_transform->facing.y > 0) {
-				animation = "StandDown";
-			}
-			else {
-				animation = "StandUp";
-			}
+			animation = player_transform->facing.y > 0 ? "AtkDown" : "AtkUp";
 		}
 		else {
-			animation = "StandRight";
+			animation = "AtkRight";
 		}
-		player_animation->animation = m_game.getAssets().getAnimation(animation);
 	}
-	// If player is moving
-	else {
+	// If player is stationary
+	else if (player_transform->pos() == player_transform->prevPos()) {
 		if (player_transform->facing.x == 0) {
-			if (player_transform->facing.y > 0 && player_animation->animation.getName() != "RunDown") {
-				player_animation->animation = m_game.getAssets().getAnimation("RunDown");
-			}
-			else if (player_transform->facing.y < 0 && player_animation->animation.getName() != "RunUp"){
-				player_animation->animation = m_game.getAssets().getAnimation("RunUp");
-			}
+			animation = player_transform->facing.y > 0 ? "StandDown" : "StandUp";
 		}
-		else if (player_transform->facing.y == 0 && player_animation->animation.getName() != "RunRight") {
-			player_animation->animation = m_game.getAssets().getAnimation("RunRight");
+		else {
+			animation = "StandRight";
 		}
 	}
-	// If player is attacking
-	if (hasSword) {
+	// If player is moving
+	else {
 		if (player_transform->facing.x == 0) {
-			if (player_transform->facing.y > 0) {
-				animation = "AtkDown";
-			}
-			else {
-				animation = "AtkUp";
-			}
+			animation = player_transform->facing.y > 0 ? "RunDown" : "RunUp";
 		}
 		else {
-			animation = "AtkRight";
+			animation = "RunRight";
 		}
+	}
+
+	// Only swap the animation when the selection differs, so the sprite is not rebuilt every tick
+	if (player_animation->animation.getName() != animation) {
 		player_animation->animation = m_game.getAssets().getAnimation(animation);
+		m_player->markChanged<CAnimation>();
 	}
 
+	// Tiles of one type share their animation, so they all advance in one step
+	m_tilemap.update();
+
 	// Update all animations and destroy entities with a non-repeating animation that has ended
+	// Sleeping NPCs keep their current frame
 	for (auto entity : m_entityManager.getEntities()) {
+		if (entity->hasComponent<CActivity>() && entity->get<CActivity>().level == Activity::Asleep) {
+			continue;
+		}
 		if (entity->hasComponent<CAnimation>()) {
 			entity->getComponent<CAnimation>()->animation.update();
 			if (!entity->getComponent<CAnimation>()->repeat && entity->getComponent<CAnimation>()->animation.hasEnded()) {
@@ -403,10 +984,10 @@ void GameState_Play::sAnimation()
 	
 }
 
-void GameState_Play::sUserInput()
+void GameState_Play::forwardInput()
 {
-    auto pInput = m_player->getComponent<CInput>();
-
+    // closing the window and leaving the state are engine operations and stay on this
+    // thread, everything else goes to the simulation
     sf::Event event;
     while (m_game.window().pollEvent(event))
     {
@@ -414,21 +995,119 @@ void GameState_Play::sUserInput()
         {
             m_game.quit();
         }
+        else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Escape)
+        {
+            m_game.popState();
+        }
+        else if (event.type == sf::Event::KeyPressed || event.type == sf::Event::KeyReleased)
+        {
+            if (!m_events.publish(event))
+            {
+                std::cerr << "Input queue full, dropping key event\n";
+            }
+        }
+    }
+}
+
+void GameState_Play::updateAssets()
+{
+    auto & assets = m_game.assets();
+
+    // evicted textures the last ticks asked for are loaded every frame, between ticks
+    if (assets.hasPendingLoads())
+    {
+        std::lock_guard<std::mutex> lock(m_simMutex);
+        assets.loadPending();
+    }
+
+    // a stat per watched file twice a second, the simulation is only stopped when something changed
+    if (m_watchClock.getElapsedTime().asMilliseconds() < 500) { return; }
+    m_watchClock.restart();
+
+    // textures are reloaded and evicted on this thread, the one that draws them, while no tick
+    // is running; trimming alone is not worth waiting for the simulation and retries next time
+    auto changed = m_watcher.poll();
+    std::unique_lock<std::mutex> lock(m_simMutex, std::defer_lock);
+    if (!changed.empty())       { lock.lock(); }
+    else if (!lock.try_lock())  { return; }
+
+    if (!changed.empty())
+    {
+        for (auto & name : assets.reload(changed))
+        {
+            m_reloadedAnimations.push_back(name);
+        }
+        m_levelChanged |= std::find(changed.begin(), changed.end(), m_levelPath) != changed.end();
+
+        // the asset list may name files that were not watched yet
+        m_watcher.watch(assets.sourceFiles());
+    }
+
+    // entities release their handles when removed, and the snapshots published since no longer
+    // draw them, so textures without handles can go
+    assets.trim();
+}
+
+void GameState_Play::sHotReload()
+{
+	// entities copy their animation, so the ones playing a reloaded animation take the new copy;
+	// replacing the component marks it changed, which resyncs the sprite
+	if (!m_reloadedAnimations.empty()) {
+		std::sort(m_reloadedAnimations.begin(), m_reloadedAnimations.end());
+		for (auto & e : m_entityManager.getEntities()) {
+			if (!e->hasComponent<CAnimation>()) { continue; }
+
+			auto & current = e->get<CAnimation>();
+			if (std::binary_search(m_reloadedAnimations.begin(), m_reloadedAnimations.end(), current.animation.getName())) {
+				bool repeat = current.repeat;
+				e->addComponent<CAnimation>(m_game.getAssets().getAnimation(current.animation.getName()), repeat);
+			}
+		}
+
+		// tile types hold one copy each, and every room's minimap may show them
+		bool tilesReloaded = false;
+		for (auto & name : m_reloadedAnimations) {
+			tilesReloaded |= m_tilemap.reloadAnimation(name, m_game.getAssets().getAnimation(name));
+		}
+		if (tilesReloaded) {
+			for (auto & room : m_levelRooms) {
+				m_changedTileRooms.push_back(room.first);
+			}
+		}
+		m_reloadedAnimations.clear();
+	}
+
+	if (m_levelChanged) {
+		m_levelChanged = false;
+		reloadLevel(m_levelPath);
+	}
+}
+
+void GameState_Play::sUserInput()
+{
+    auto pInput = m_player->getComponent<CInput>();
+
+    // events arrive from the window thread through m_events
+    sf::Event event;
+    while (m_events.channel<sf::Event>().poll(event))
+    {
         // this event is triggered when a key is pressed
         if (event.type == sf::Event::KeyPressed)
         {
             switch (event.key.code)
             {
-                case sf::Keyboard::Escape:  { m_game.popState(); break; }
                 case sf::Keyboard::W:       { pInput->up = true; break; }
                 case sf::Keyboard::A:       { pInput->left = true; break; }
                 case sf::Keyboard::S:       { pInput->down = true; break; }
                 case sf::Keyboard::D:       { pInput->right = true; break; }
-                case sf::Keyboard::Z:       { init(m_levelPath); break; }
+                case sf::Keyboard::Z:       { m_events.publish(ReloadEvent()); break; }
                 case sf::Keyboard::R:       { m_drawTextures = !m_drawTextures; break; }
                 case sf::Keyboard::F:       { m_drawCollision = !m_drawCollision; break; }
                 case sf::Keyboard::Y:       { m_follow = !m_follow; break; }
                 case sf::Keyboard::P:       { setPaused(!m_paused); break; }
+                case sf::Keyboard::M:       { m_drawMinimap = !m_drawMinimap; break; }
+                case sf::Keyboard::V:       { m_drawFog = !m_drawFog; break; }
+                case sf::Keyboard::B:       { setBroadPhase(m_broadPhase == BroadPhase::Tree ? BroadPhase::Naive : BroadPhase::Tree); break; }
                 case sf::Keyboard::Space:   { spawnSword(m_player); break; }
             }
         }
@@ -449,16 +1128,15 @@ void GameState_Play::sUserInput()
 
 void GameState_Play::sRender()
 {
-    m_game.window().clear(sf::Color(255, 192, 122));
+	// build this tick's frame in the snapshot the render thread is not drawing
+	auto & snapshot		= m_snapshots.back();
+	snapshot.clear();
+	snapshot.clearColor	= sf::Color(255, 192, 122);
 
     // set the window view 
-	auto playerPosition = m_player->getComponent<CTransform>()->pos;
-	auto windowSize		= m_game.window().getSize();
-	unsigned int size	= 100;
-	sf::View view		= m_game.window().getView();
-	sf::View minimap	(sf::FloatRect(view.getCenter().x, view.getCenter().y, size, m_game.window().getSize().y*size / m_game.window().getSize().x));
-	minimap.setViewport (sf::FloatRect(1.f - (1.f*minimap.getSize().x) / m_game.window().getSize().x - 0.02f, 1.f - (1.f*minimap.getSize().y) / m_game.window().getSize().y - 0.02f, (1.f*minimap.getSize().x) / m_game.window().getSize().x, (1.f*minimap.getSize().y) / m_game.window().getSize().y));
-	minimap.zoom(4.f);
+	auto playerPosition = m_player->getComponent<CTransform>()->pos();
+	auto windowSize		= m_game.windowSize();
+	sf::View view		(sf::FloatRect(0, 0, (float)windowSize.x, (float)windowSize.y));
 
 	if (m_follow) {
 		view.setCenter(playerPosition.x, playerPosition.y);
@@ -466,85 +1144,258 @@ void GameState_Play::sRender()
 	else {
 		view.setCenter(floor(playerPosition.x / windowSize.x) * windowSize.x + windowSize.x / 2.0f, floor(playerPosition.y / windowSize.y) * windowSize.y + windowSize.y / 2.0f);
 	}
-	
-	m_game.window().setView(view);
-	drawMap();
 
-	// Attempt at creating a minimap
-	/*
-	m_game.window().setView(minimap);
-	drawMap();
-    */
+	snapshot.view = view;
+	syncSpriteTransforms();
+	drawMap(snapshot);
+	sMinimap(snapshot);
 
-    m_game.window().display();
+	m_snapshots.publish();
+}
+
+void GameState_Play::syncSpriteTransforms()
+{
+	// Sprites keep their transform between frames, so only entities whose transform
+	// or animation changed this tick need their sprite updated
+	auto sync = [](Entity * e) {
+		if (!e->hasComponent<CAnimation>() || !e->hasComponent<CTransform>()) { return; }
+		auto transform	= e->getComponent<CTransform>();
+		auto & sprite	= e->getComponent<CAnimation>()->animation.getSprite();
+		sprite.setRotation(transform->angle);
+		sprite.setPosition(transform->pos().x, transform->pos().y);
+		sprite.setScale(transform->scale.x, transform->scale.y);
+	};
+
+	for (auto e : m_entityManager.getChanged<CTransform>()) {
+		sync(e);
+	}
+	for (auto e : m_entityManager.getChanged<CAnimation>()) {
+		if (!e->isChanged<CTransform>()) {
+			sync(e);
+		}
+	}
 }
 
-void GameState_Play::drawMap() {
-	// draw all Entity textures / animations
+void GameState_Play::sMinimap(RenderSnapshot & snapshot)
+{
+	auto roomSize	= m_game.windowSize();
+	auto roomOf		= [&](const Vec2 & pos) { return std::make_pair((int)floor(pos.x / roomSize.x), (int)floor(pos.y / roomSize.y)); };
+
+	auto center		= roomOf(m_player->getComponent<CTransform>()->pos());
+
+	// drop the tile queues of rooms whose tiles were loaded, reloaded or hot reloaded, and of
+	// rooms too far from the player to be shown soon, so only a few rooms are ever kept
+	auto & dirty = m_changedTileRooms;
+	std::sort(dirty.begin(), dirty.end());
+	auto & rooms = m_minimapRooms;
+	for (size_t i = 0; i < rooms.size();) {
+		auto & room = rooms[i];
+		bool far	= abs(room.x - center.first) > Minimap::KeepRadius || abs(room.y - center.second) > Minimap::KeepRadius;
+		if (far || std::binary_search(dirty.begin(), dirty.end(), std::make_pair(room.x, room.y))) {
+			if (m_minimapSpare.size() < Minimap::KeepCount) { m_minimapSpare.push_back(std::move(room.tiles)); }
+			if (&room != &rooms.back()) { room = std::move(rooms.back()); }
+			rooms.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+	dirty.clear();
+
+	if (!m_drawMinimap) { return; }
+
+	// the window thread re-bakes a room whenever its queue changes, so a queue is only reused
+	// once neither the minimap nor a snapshot still holds it
+	auto tilesOf = [&](int x, int y) -> const std::shared_ptr<RenderQueue> & {
+		for (auto & room : rooms) {
+			if (room.x == x && room.y == y) { return room.tiles; }
+		}
+
+		std::shared_ptr<RenderQueue> tiles;
+		for (auto & spare : m_minimapSpare) {
+			if (spare.use_count() == 1) {
+				tiles = std::move(spare);
+				spare = std::move(m_minimapSpare.back());
+				m_minimapSpare.pop_back();
+				break;
+			}
+		}
+		GridCell min, max;
+		roomCells(std::make_pair(x, y), min, max);
+		if (!tiles) { tiles = std::make_shared<RenderQueue>(); }
+
+		// sized for a room full of tiles, so a reused queue never grows
+		tiles->clear();
+		tiles->reserve((size_t)(max.x - min.x + 1) * (max.y - min.y + 1), m_tilemap.typeCount());
+		uint64_t depth = 0;
+		m_tilemap.forEach(min, max, [&](const GridCell & cell, const TileType & type) {
+			sf::Sprite sprite(type.animation.getSprite());
+			auto pos = m_tilemap.tileCenter(cell, type);
+			sprite.setPosition(pos.x, pos.y);
+			tiles->submit(0, depth++, sprite);
+		});
+		rooms.push_back({ x, y, std::move(tiles) });
+		return rooms.back().tiles;
+	};
+
+	// the player's room and its eight neighbours
+	auto & frame	= snapshot.minimap;
+	frame.area		= sf::FloatRect((float)(center.first - 1) * roomSize.x, (float)(center.second - 1) * roomSize.y, 3.0f * roomSize.x, 3.0f * roomSize.y);
+
+	for (int y = center.second - 1; y <= center.second + 1; y++) {
+		for (int x = center.first - 1; x <= center.first + 1; x++) {
+			auto & tiles = tilesOf(x, y);
+			if (!tiles->empty()) {
+				frame.rooms.push_back({ x, y, tiles });
+			}
+		}
+	}
+
+	auto quad = [&](const Vec2 & min, const Vec2 & max, const sf::Color & color) {
+		frame.markers.push_back(sf::Vertex(sf::Vector2f(min.x, min.y), color));
+		frame.markers.push_back(sf::Vertex(sf::Vector2f(max.x, min.y), color));
+		frame.markers.push_back(sf::Vertex(sf::Vector2f(max.x, max.y), color));
+		frame.markers.push_back(sf::Vertex(sf::Vector2f(min.x, max.y), color));
+	};
+	auto half	= m_tilemap.cellSize() / 2;
+	auto marker = [&](const Vec2 & pos, const sf::Color & color) {
+		quad(pos - half, pos + half, color);
+	};
+
+	// background first, the minimap draws it under the baked rooms
+	Vec2 areaMin(frame.area.left, frame.area.top);
+	quad(areaMin, areaMin + Vec2(frame.area.width, frame.area.height), sf::Color(40, 40, 40, 200));
+
+	AABB areaBox(areaMin, areaMin + Vec2(frame.area.width, frame.area.height));
+	if (m_broadPhase == BroadPhase::Tree) {
+		m_tree.query(areaBox, [&](Entity * e) {
+			if (e->tag() == "npc") { marker(e->getComponent<CTransform>()->pos(), sf::Color::Red); }
+			return true;
+		});
+	}
+	else {
+		for (auto & npc : m_entityManager.getEntities("npc")) {
+			auto & pos = npc->getComponent<CTransform>()->pos();
+			if (areaBox.contains(AABB(pos, pos))) { marker(pos, sf::Color::Red); }
+		}
+	}
+	marker(m_player->getComponent<CTransform>()->pos(), sf::Color::White);
+}
+
+void GameState_Play::drawMap(RenderSnapshot & snapshot) {
+	// draw all Entity textures / animations through the render queue, so layering no longer
+	// depends on spawn order and sprites sharing a texture are drawn in one batch
 	if (m_drawTextures)
 	{
-		for (auto e : m_entityManager.getEntities())
-		{
-			auto transform = e->getComponent<CTransform>();
+		auto submit = [&](Entity * e) {
+			snapshot.sprites.submit(RenderLayer(e->tag()), e->id(), e->getComponent<CAnimation>()->animation.getSprite());
+		};
+
+		auto & view		= snapshot.view;
+		auto viewBox	= AABB::FromCenter(Vec2(view.getCenter().x, view.getCenter().y), Vec2(view.getSize().x, view.getSize().y) / 2);
+
+		// particles are drawn over the sprites, one vertex array per texture
+		m_particles.draw(viewBox, snapshot.particles, snapshot.particleBatches);
 
-			if (e->hasComponent<CAnimation>())
+		// tiles come from the tilemap cells under the view, their sprite is the type's placed at the cell
+		auto tileLayer	= RenderLayer("tile");
+		uint64_t depth	= 0;
+		m_tilemap.forEach(viewBox, [&](const GridCell & cell, const TileType & type) {
+			sf::Sprite sprite(type.animation.getSprite());
+			auto pos = m_tilemap.tileCenter(cell, type);
+			sprite.setPosition(pos.x, pos.y);
+			snapshot.sprites.submit(tileLayer, depth++, sprite);
+		});
+
+		if (m_broadPhase == BroadPhase::Tree)
+		{
+			// only queue what the view can see
+			m_tree.query(viewBox, [&](Entity * e) {
+				if (e->hasComponent<CAnimation>()) { submit(e); }
+				return true;
+			});
+		}
+		else
+		{
+			for (auto e : m_entityManager.getEntities())
 			{
-				auto animation = e->getComponent<CAnimation>()->animation;
-				animation.getSprite().setRotation(transform->angle);
-				animation.getSprite().setPosition(transform->pos.x, transform->pos.y);
-				animation.getSprite().setScale(transform->scale.x, transform->scale.y);
-				m_game.window().draw(animation.getSprite());
+				if (e->hasComponent<CAnimation>()) { submit(e.get()); }
 			}
 		}
 	}
 
-	// draw all Entity collision bounding boxes with a rectangleshape
+	// darken what the player cannot see, dimmer where the player has already been
+	if (m_drawFog)
+	{
+		auto & view		= snapshot.view;
+		auto viewBox	= AABB::FromCenter(Vec2(view.getCenter().x, view.getCenter().y), Vec2(view.getSize().x, view.getSize().y) / 2);
+		m_fieldOfView.drawFog(viewBox, snapshot.fog);
+	}
+
+	// draw all Entity collision bounding boxes as outlines, plus patrol points and follow targets
 	if (m_drawCollision)
 	{
-		sf::CircleShape dot(4);
-		dot.setFillColor(sf::Color::Black);
+		auto line = [&](float x1, float y1, float x2, float y2, const sf::Color & color) {
+			snapshot.lines.push_back(sf::Vertex(sf::Vector2f(x1, y1), color));
+			snapshot.lines.push_back(sf::Vertex(sf::Vector2f(x2, y2), color));
+		};
+		auto dot = [&](const Vec2 & pos) {
+			snapshot.quads.push_back(sf::Vertex(sf::Vector2f(pos.x, pos.y), sf::Color::Black));
+			snapshot.quads.push_back(sf::Vertex(sf::Vector2f(pos.x + 8, pos.y), sf::Color::Black));
+			snapshot.quads.push_back(sf::Vertex(sf::Vector2f(pos.x + 8, pos.y + 8), sf::Color::Black));
+			snapshot.quads.push_back(sf::Vertex(sf::Vector2f(pos.x, pos.y + 8), sf::Color::Black));
+		};
+
+		auto outline = [&](const Vec2 & pos, const Vec2 & halfSize, bool blockMove, bool blockVision) {
+			sf::Color color;
+
+			if (blockMove && blockVision) { color = sf::Color::Black; }
+			if (blockMove && !blockVision) { color = sf::Color::Blue; }
+			if (!blockMove && blockVision) { color = sf::Color::Red; }
+			if (!blockMove && !blockVision) { color = sf::Color::White; }
+
+			float left		= pos.x - halfSize.x;
+			float top		= pos.y - halfSize.y;
+			float right		= pos.x + halfSize.x;
+			float bottom	= pos.y + halfSize.y;
+			line(left, top, right, top, color);
+			line(right, top, right, bottom, color);
+			line(right, bottom, left, bottom, color);
+			line(left, bottom, left, top, color);
+		};
+
+		// tiles are no longer entities, their boxes come from the blocking cells under the view
+		auto & view		= snapshot.view;
+		auto viewBox	= AABB::FromCenter(Vec2(view.getCenter().x, view.getCenter().y), Vec2(view.getSize().x, view.getSize().y) / 2);
+		m_tilemap.forEach(viewBox, [&](const GridCell & cell, const TileType & type) {
+			if (type.blockMove || type.blockVision)
+			{
+				outline(m_tilemap.tileCenter(cell, type), type.halfSize, type.blockMove, type.blockVision);
+			}
+		});
+
 		for (auto e : m_entityManager.getEntities())
 		{
 			if (e->hasComponent<CBoundingBox>())
 			{
 				auto box = e->getComponent<CBoundingBox>();
-				auto transform = e->getComponent<CTransform>();
-				sf::RectangleShape rect;
-				rect.setSize(sf::Vector2f(box->size.x - 1, box->size.y - 1));
-				rect.setOrigin(sf::Vector2f(box->halfSize.x, box->halfSize.y));
-				rect.setPosition(transform->pos.x, transform->pos.y);
-				rect.setFillColor(sf::Color(0, 0, 0, 0));
-
-				if (box->blockMove && box->blockVision) { rect.setOutlineColor(sf::Color::Black); }
-				if (box->blockMove && !box->blockVision) { rect.setOutlineColor(sf::Color::Blue); }
-				if (!box->blockMove && box->blockVision) { rect.setOutlineColor(sf::Color::Red); }
-				if (!box->blockMove && !box->blockVision) { rect.setOutlineColor(sf::Color::White); }
-				rect.setOutlineThickness(1);
-				m_game.window().draw(rect);
+				outline(e->getComponent<CTransform>()->pos(), box->halfSize, box->blockMove, box->blockVision);
 			}
 
 			if (e->hasComponent<CPatrol>())
 			{
-				auto & patrol = e->getComponent<CPatrol>()->positions;
-				for (size_t p = 0; p < patrol.size(); p++)
+				for (auto & p : e->getComponent<CPatrol>()->positions)
 				{
-					dot.setPosition(patrol[p].x, patrol[p].y);
-					m_game.window().draw(dot);
+					dot(p);
 				}
 			}
 
 			if (e->hasComponent<CFollowPlayer>())
 			{
-				sf::VertexArray lines(sf::LinesStrip, 2);
-				lines[0].position.x = e->getComponent<CTransform>()->pos.x;
-				lines[0].position.y = e->getComponent<CTransform>()->pos.y;
-				lines[0].color = sf::Color::Black;
-				lines[1].position.x = m_player->getComponent<CTransform>()->pos.x;
-				lines[1].position.y = m_player->getComponent<CTransform>()->pos.y;
-				lines[1].color = sf::Color::Black;
-				m_game.window().draw(lines);
-				dot.setPosition(e->getComponent<CFollowPlayer>()->home.x, e->getComponent<CFollowPlayer>()->home.y);
-				m_game.window().draw(dot);
+				auto & pos = e->getComponent<CTransform>()->pos();
+				auto & player = m_player->getComponent<CTransform>()->pos();
+				line(pos.x, pos.y, player.x, player.y, sf::Color::Black);
+				dot(e->getComponent<CFollowPlayer>()->home);
 			}
 		}
 	}
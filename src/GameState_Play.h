@@ -5,46 +5,217 @@
 #include <map>
 #include <memory>
 #include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
 
 #include "EntityManager.h"
+#include "MemoryArena.h"
+#include "NavGrid.h"
+#include "AABBTree.h"
+#include "RenderSnapshot.h"
+#include "EventBus.h"
+#include "LevelParser.h"
+#include "FileWatcher.h"
+#include "ActivityGrid.h"
+#include "BehaviourScheduler.h"
+#include "ParticleSystem.h"
+#include "FieldOfView.h"
+#include "Tilemap.h"
 
 struct PlayerConfig 
 { 
     float X, Y, CX, CY, SPEED;
 };
 
+struct FrameMemoryStats
+{
+    size_t heapAllocations  = 0;    // global operator new calls during the last tick
+    size_t scratchBytes     = 0;    // bytes taken from the frame arena during the last update
+    size_t levelBytes       = 0;    // bytes held by the current level arena
+};
+
+// microseconds spent in each system during the last update, and in the last level load
+struct SystemTimes
+{
+    long long load      = 0;
+    long long activity  = 0;
+    long long ai        = 0;
+    long long movement  = 0;
+    long long lifespan  = 0;
+    long long collision = 0;
+    long long animation = 0;
+    long long particles = 0;
+    long long render    = 0;
+};
+
+// bodies and pairs the last sCollision looked at
+struct CollisionStats
+{
+    size_t bodies   = 0;    // player, swords and the NPCs around the player
+    size_t tests    = 0;    // pairs that passed the layer test and had their boxes compared
+    size_t contacts = 0;    // pairs whose boxes overlapped
+};
+
+// what one room of the level file spawned, so an edited file only re-instantiates the rooms whose lines changed;
+// its tiles are the tilemap cells inside the room
+struct LevelRoom
+{
+    size_t                              hash = 0;
+    std::vector<std::weak_ptr<Entity>>  entities;
+};
+
+// how systems find candidate entities: brute-force loops or the dynamic AABB tree
+enum class BroadPhase { Naive, Tree };
+
+// game events raised by one system and handled later in the tick (or on another thread)
+struct ReloadEvent          {};
+struct PlayerKilledEvent    { Vec2 pos; };
+struct NpcKilledEvent       { Vec2 pos; };
+
+// key events travel from the window thread, the rest stay on the simulation thread
+typedef EventBus<256, sf::Event, ReloadEvent, PlayerKilledEvent, NpcKilledEvent> GameEventBus;
+
 class GameState_Play : public GameState
 {
 
 protected:
 
+    // the arenas are declared first so they outlive every entity allocated from them
+    MemoryArena             m_levelArena;
+    MemoryArena             m_frameArena;
+    TransformPool           m_transforms;       // hot transform data of the player and NPCs
     EntityManager           m_entityManager;
     std::shared_ptr<Entity> m_player;
+    Tilemap                 m_tilemap;          // the level's static tiles, not entities
+    NavGrid                 m_navGrid;
+    AABBTree                m_tree;
+    ActivityGrid            m_activity;         // which NPCs are simulated this tick
+    BehaviourScheduler      m_behaviours;       // runs the patrol and follow scripts of those NPCs
+    ParticleSystem          m_particles;        // explosions and hit effects, not entities
+    FieldOfView             m_fieldOfView;      // what the player sees, the NPCs' line of sight and the fog
+    BroadPhase              m_broadPhase = BroadPhase::Tree;
     std::string             m_levelPath;
     PlayerConfig            m_playerConfig;
+    FrameMemoryStats        m_memoryStats;
+    SystemTimes             m_systemTimes;
+    CollisionStats          m_collisionStats;
+    LevelParseStats         m_parseStats;
     bool                    m_drawTextures = true;
     bool                    m_drawCollision = false;
     bool                    m_follow = false;
+    bool                    m_drawMinimap = true;
+    bool                    m_drawFog = true;
+    bool                    m_useFieldOfView = true;
+    bool                    m_deterministic = false;
+
+    // rooms of the level file, cleared before the level arena their entities live in
+    std::map<std::pair<int, int>, LevelRoom> m_levelRooms;
+
+    // static tile sprites per room for the minimap, built when the room is first shown and
+    // dropped when a tile in it changes or the player moves away, dropped queues are reused
+    std::vector<MinimapRoom>                    m_minimapRooms;
+    std::vector<std::shared_ptr<RenderQueue>>   m_minimapSpare;
+    std::vector<std::pair<int, int>>    m_changedTileRooms;    // rooms whose tiles changed since the last sMinimap
+
+    // the simulation thread publishes a snapshot per tick and the window thread
+    // draws it, key events travel the other way through m_events
+    SnapshotBuffer          m_snapshots;
+    GameEventBus            m_events;
+    RenderStats             m_renderStats;
+    Minimap                 m_minimap;          // window thread only
+    std::atomic<bool>       m_simRunning { false };
+    std::thread             m_simThread;
+
+    // hot reload and texture eviction: the window thread watches the asset and level files
+    // and, holding m_simMutex so no tick is running, reloads changed assets, evicts unused
+    // textures and queues the rest for the next tick
+    std::mutex              m_simMutex;
+    FileWatcher             m_watcher;          // window thread only
+    sf::Clock               m_watchClock;
+    std::vector<std::string> m_reloadedAnimations;
+    bool                    m_levelChanged = false;
     
     void init(const std::string & levelPath);
 
     void loadLevel(const std::string & filename);
+    void reloadLevel(const std::string & filename);
+    void spawnLevelRecord(const LevelRecord & record, const LevelChunk & chunk, LevelRoom & room);
+    void buildNavGrid(const Vec2 & cellSize);
+    void buildFieldOfView(const Vec2 & cellSize);
+    void roomCells(const std::pair<int, int> & room, GridCell & min, GridCell & max) const;
 
     void update();
     void spawnPlayer();
     void spawnSword(std::shared_ptr<Entity> entity);
     
+    void sActivity();
     void sMovement();
     void sAI();
+    bool canSeePlayer(Entity & npc, const ArenaVector<Entity *> & blockers);
     void sLifespan();
     void sUserInput();
+    void forwardInput();
+    void updateAssets();
+    void sHotReload();
+    void runSimulation();
     void sAnimation();
+    void sParticles();
     void sCollision();
+    void sEvents();
+    void sBroadPhase();
+    template <typename T> void moveEntities();
+    template <typename T> void resolveTileCollisions(Entity * entity);
+    bool entityBounds(Entity * entity, AABB & box);
     void sRender();
-	void drawMap();
+    void syncSpriteTransforms();
+	void drawMap(RenderSnapshot & snapshot);
+    void sMinimap(RenderSnapshot & snapshot);
 
 public:
 
     GameState_Play(GameEngine & game, const std::string & levelPath);
+    ~GameState_Play();
+
+    // run one simulation tick without reading input or rendering
+    void simulate();
+
+    // one tick of the simulation thread: simulate, read input and build the render snapshot
+    void tick();
+
+    // switching to the tree rebuilds it from every entity in the level
+    void setBroadPhase(BroadPhase broadPhase);
+
+    // with activity off every NPC in the level is simulated every tick
+    void setActivityEnabled(bool enabled);
+
+    // with the field of view off NPCs test their line of sight against every blocker as before
+    void setFieldOfViewEnabled(bool enabled);
+
+    // Deterministic mode moves, collides and steers every entity in 16.16 Fixed instead of
+    // float, so a run gives bit-identical positions whatever the compiler, flags or CPU; the
+    // floats only follow for drawing and the broad phase. Sight always uses the field of
+    // view's cell lookups. Switching reloads the level.
+    void setDeterministic(bool enabled);
+
+    // hold the player's directions and swing the sword without a window, for replays
+    void setPlayerInput(bool up, bool down, bool left, bool right, bool attack);
+
+    // hash of every entity's id and position, raw Fixed values in deterministic mode
+    uint64_t simulationHash();
+
+    // id and position of every entity with a transform, in id order
+    void entityPositions(std::vector<std::pair<size_t, Vec2>> & positions);
+
+    const FrameMemoryStats &    getMemoryStats() const;
+    const SystemTimes &         getSystemTimes() const;
+    const RenderStats &         getRenderStats() const;
+    const LevelParseStats &     getParseStats() const;
+    const ActivityStats &       getActivityStats() const;
+    const CollisionStats &      getCollisionStats() const;
+    const BehaviourStats &      getBehaviourStats() const;
+    const FieldOfViewStats &    getFieldOfViewStats() const;
+    TilemapStats                getTilemapStats() const;
+    size_t                      entityCount();
 
 };
\ No newline at end of file
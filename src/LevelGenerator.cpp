@@ -0,0 +1,156 @@
+#include "LevelGenerator.h"
+#include <random>
+
+namespace
+{
+    // cells inside a room: 0 free, 1 wall, 2 door approach, 3 player start
+    void BuildRoom(std::vector<char> & cells, int rx, int ry, const LevelConfig & config, std::mt19937 & rng)
+    {
+        int w = config.roomTilesX, h = config.roomTilesY;
+        std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+        cells.assign(w * h, 0);
+
+        float density = config.tileDensity;
+        if (config.denseRooms > 0 && chance(rng) < config.denseRooms)
+        {
+            density = config.denseTileDensity;
+        }
+
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                bool border = x == 0 || y == 0 || x == w - 1 || y == h - 1;
+                bool door   = (x == w / 2 || x == w / 2 - 1) || (y == h / 2 || y == h / 2 - 1);
+
+                if (border)                 { cells[y * w + x] = door ? 2 : 1; }
+                else if (door)              { cells[y * w + x] = 2; }
+                else if (chance(rng) < density)    { cells[y * w + x] = 1; }
+            }
+        }
+
+        // keep the player's start cell and its neighbours clear
+        if (rx == 0 && ry == 0)
+        {
+            for (int y = h / 2 - 2; y <= h / 2 + 1; y++)
+            {
+                for (int x = w / 2 - 2; x <= w / 2 + 1; x++)
+                {
+                    cells[y * w + x] = 3;
+                }
+            }
+        }
+    }
+
+    bool IsFree(const std::vector<char> & cells, int w, int x, int y)
+    {
+        return cells[y * w + x] != 1;
+    }
+}
+
+size_t LevelGenerator::Write(std::ostream & out, const LevelConfig & config)
+{
+    std::mt19937 rng(config.seed);
+    int w = config.roomTilesX, h = config.roomTilesY;
+    size_t entities = 0;
+
+    // same start as the shipped levels: the middle of room (0, 0) with 64 pixel tiles
+    out << "Player " << w * 64 / 2 << " " << h * 64 / 2 - 24 << " 48 48 5\n";
+
+    // rooms are generated in order and kept so NPCs can be placed on free cells
+    std::vector<std::vector<char>> rooms(config.roomsX * config.roomsY);
+    for (int ry = 0; ry < config.roomsY; ry++)
+    {
+        for (int rx = 0; rx < config.roomsX; rx++)
+        {
+            auto & cells = rooms[ry * config.roomsX + rx];
+            BuildRoom(cells, rx, ry, config, rng);
+
+            for (int y = 0; y < h; y++)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    if (cells[y * w + x] != 1) { continue; }
+                    bool border = x == 0 || y == 0 || x == w - 1 || y == h - 1;
+                    out << "Tile " << (border ? "RockBM" : (rng() % 2 ? "Bush" : "RockBM"))
+                        << " " << rx << " " << ry << " " << x << " " << y << " 1 1\n";
+                    entities++;
+                }
+            }
+        }
+    }
+
+    std::uniform_int_distribution<int> roomX(0, config.roomsX - 1), roomY(0, config.roomsY - 1);
+    std::uniform_int_distribution<int> cellX(1, w - 2), cellY(1, h - 2), speed(1, 3);
+
+    // door approaches are never walled, so a free cell always exists
+    auto freeCell = [&](int & rx, int & ry, int & x, int & y)
+    {
+        char cell;
+        do
+        {
+            rx = roomX(rng); ry = roomY(rng); x = cellX(rng); y = cellY(rng);
+            cell = rooms[ry * config.roomsX + rx][y * w + x];
+        } while (cell == 1 || cell == 3);
+    };
+
+    int rx, ry, x, y;
+    for (size_t i = 0; i < config.patrolNPCs; i++)
+    {
+        freeCell(rx, ry, x, y);
+
+        // patrol back and forth along the free run of cells in this row
+        auto & cells = rooms[ry * config.roomsX + rx];
+        int left = x, right = x;
+        while (left > 1 && IsFree(cells, w, left - 1, y))       { left--; }
+        while (right < w - 2 && IsFree(cells, w, right + 1, y)) { right++; }
+
+        out << "NPC Tektite " << rx << " " << ry << " " << left << " " << y << " 0 0 Patrol "
+            << speed(rng) << " 2 " << left << " " << y << " " << right << " " << y << "\n";
+        entities++;
+    }
+
+    for (size_t i = 0; i < config.followNPCs; i++)
+    {
+        freeCell(rx, ry, x, y);
+        out << "NPC Knight " << rx << " " << ry << " " << x << " " << y << " 0 0 Follow " << speed(rng) << "\n";
+        entities++;
+    }
+
+    return entities;
+}
+
+bool LevelGenerator::WriteFile(const std::string & path, const LevelConfig & config, size_t * entities)
+{
+    std::ofstream file(path);
+    if (!file.good())
+    {
+        std::cerr << "Could not write level file: " << path << std::endl;
+        return false;
+    }
+
+    size_t written = Write(file, config);
+    if (entities) { *entities = written; }
+    return file.good();
+}
+
+LevelConfig LevelGenerator::ForEntityCount(size_t entities, const LevelConfig & shape, float npcFraction)
+{
+    LevelConfig config  = shape;
+    float tileDensity   = config.tileDensity * (1.0f - config.denseRooms) + config.denseTileDensity * config.denseRooms;
+
+    // walls with doors plus the expected interior tiles of one room
+    int   w             = config.roomTilesX, h = config.roomTilesY;
+    float wallTiles     = 2.0f * (w + h) - 4 - 8;
+    float interiorTiles = (w - 2) * (h - 2) - 2 * (w - 2) - 2 * (h - 2) + 4;
+    float perRoom       = (wallTiles + interiorTiles * tileDensity) / (1.0f - npcFraction);
+
+    int rooms           = std::max(1, (int)(entities / perRoom + 0.5f));
+    config.roomsX       = std::max(1, (int)sqrtf((float)rooms));
+    config.roomsY       = std::max(1, (rooms + config.roomsX - 1) / config.roomsX);
+
+    size_t npcs         = (size_t)(entities * npcFraction);
+    config.patrolNPCs   = npcs / 2;
+    config.followNPCs   = npcs - npcs / 2;
+    return config;
+}
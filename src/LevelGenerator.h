@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Common.h"
+
+struct LevelConfig
+{
+    int         roomsX          = 4;        // rooms across, starting at room 0
+    int         roomsY          = 4;        // rooms down, starting at room 0
+    int         roomTilesX      = 20;       // tiles per room, must match window size / tile size
+    int         roomTilesY      = 12;
+    float       tileDensity     = 0.2f;     // chance that an interior cell holds a blocking tile
+    float       denseRooms      = 0.0f;     // fraction of rooms using denseTileDensity instead, for lumpy maps
+    float       denseTileDensity = 0.8f;
+    size_t      patrolNPCs      = 8;
+    size_t      followNPCs      = 8;
+    unsigned    seed            = 1;
+};
+
+// Emits stress levels in the same Tile / NPC / Player format the level loader reads.
+// Every room is walled with a door in the middle of each side so all rooms connect,
+// and the player starts in the middle of room (0, 0).
+namespace LevelGenerator
+{
+    // both return / report the number of entities (tiles + NPCs) written
+    size_t Write(std::ostream & out, const LevelConfig & config);
+    bool WriteFile(const std::string & path, const LevelConfig & config, size_t * entities = nullptr);
+
+    // resize the room grid and NPC counts of shape to yield roughly the requested number of entities
+    LevelConfig ForEntityCount(size_t entities, const LevelConfig & shape, float npcFraction);
+}
@@ -0,0 +1,408 @@
+#include "LevelParser.h"
+#include "Assets.h"
+#include "Components.h"
+#include <thread>
+#include <cstring>
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Read-only view of a whole file, memory-mapped where the platform allows it
+class MappedFile
+{
+    const char *    m_data  = nullptr;
+    size_t          m_size  = 0;
+#ifdef _WIN32
+    HANDLE          m_file      = INVALID_HANDLE_VALUE;
+    HANDLE          m_mapping   = nullptr;
+#else
+    int             m_file      = -1;
+#endif
+
+public:
+
+    MappedFile(const std::string & path)
+    {
+#ifdef _WIN32
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) { return; }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) { return; }
+
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_mapping) { return; }
+
+        m_data = static_cast<const char *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_data) { m_size = (size_t)size.QuadPart; }
+#else
+        m_file = open(path.c_str(), O_RDONLY);
+        if (m_file < 0) { return; }
+
+        struct stat info;
+        if (fstat(m_file, &info) != 0 || info.st_size == 0) { return; }
+
+        void * data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+        if (data == MAP_FAILED) { return; }
+
+        m_data = static_cast<const char *>(data);
+        m_size = (size_t)info.st_size;
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (m_data)                         { UnmapViewOfFile(m_data); }
+        if (m_mapping)                      { CloseHandle(m_mapping); }
+        if (m_file != INVALID_HANDLE_VALUE) { CloseHandle(m_file); }
+#else
+        if (m_data)                         { munmap(const_cast<char *>(m_data), m_size); }
+        if (m_file >= 0)                    { close(m_file); }
+#endif
+    }
+
+    bool isOpen() const
+    {
+#ifdef _WIN32
+        return m_file != INVALID_HANDLE_VALUE;
+#else
+        return m_file >= 0;
+#endif
+    }
+
+    const char *    data() const { return m_data; }
+    size_t          size() const { return m_size; }
+};
+
+// Whitespace-separated token reader over [pos, end)
+class TokenReader
+{
+    const char * m_pos;
+    const char * m_end;
+
+    static bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+    void skipSpace()
+    {
+        while (m_pos < m_end && IsSpace(*m_pos)) { m_pos++; }
+    }
+
+public:
+
+    TokenReader(const char * begin, const char * end) : m_pos(begin), m_end(end) {}
+
+    bool done()
+    {
+        skipSpace();
+        return m_pos >= m_end;
+    }
+
+    // next token as a pointer and length into the buffer
+    bool token(const char *& begin, size_t & length)
+    {
+        skipSpace();
+        begin = m_pos;
+        while (m_pos < m_end && !IsSpace(*m_pos)) { m_pos++; }
+        length = m_pos - begin;
+        return length > 0;
+    }
+
+    // tokens left before the end of the current line, without consuming them
+    size_t tokensOnLine() const
+    {
+        size_t count = 0;
+        for (const char * p = m_pos; p < m_end && *p != '\n';)
+        {
+            while (p < m_end && (*p == ' ' || *p == '\t' || *p == '\r')) { p++; }
+            if (p >= m_end || *p == '\n') { break; }
+            while (p < m_end && !IsSpace(*p)) { p++; }
+            count++;
+        }
+        return count;
+    }
+
+    // next token without consuming it
+    bool peek(const char *& begin, size_t & length)
+    {
+        const char * pos = m_pos;
+        bool found = token(begin, length);
+        m_pos = pos;
+        return found;
+    }
+
+    bool integer(int & value)
+    {
+        skipSpace();
+        bool negative = m_pos < m_end && *m_pos == '-';
+        if (negative || (m_pos < m_end && *m_pos == '+')) { m_pos++; }
+        if (m_pos >= m_end || *m_pos < '0' || *m_pos > '9') { return false; }
+
+        int result = 0;
+        while (m_pos < m_end && *m_pos >= '0' && *m_pos <= '9') { result = result * 10 + (*m_pos++ - '0'); }
+        value = negative ? -result : result;
+        return true;
+    }
+
+    // decimal floats with an optional fraction and exponent, which is all the level format uses
+    bool real(float & value)
+    {
+        skipSpace();
+        bool negative = m_pos < m_end && *m_pos == '-';
+        if (negative || (m_pos < m_end && *m_pos == '+')) { m_pos++; }
+
+        double result   = 0;
+        bool   digits   = false;
+        while (m_pos < m_end && *m_pos >= '0' && *m_pos <= '9') { result = result * 10 + (*m_pos++ - '0'); digits = true; }
+        if (m_pos < m_end && *m_pos == '.')
+        {
+            m_pos++;
+            double scale = 0.1;
+            while (m_pos < m_end && *m_pos >= '0' && *m_pos <= '9') { result += (*m_pos++ - '0') * scale; scale *= 0.1; digits = true; }
+        }
+        if (!digits) { return false; }
+
+        if (m_pos < m_end && (*m_pos == 'e' || *m_pos == 'E'))
+        {
+            m_pos++;
+            int exponent = 0;
+            if (!integer(exponent)) { return false; }
+            result *= pow(10.0, exponent);
+        }
+        value = (float)(negative ? -result : result);
+        return true;
+    }
+};
+
+static bool TokenIs(const char * token, size_t length, const char * word)
+{
+    return length == strlen(word) && memcmp(token, word, length) == 0;
+}
+
+// "Tile|Npc|5" to CollisionLayer bits, false on an unknown name
+static bool ParseLayers(const char * token, size_t length, uint32_t & layers)
+{
+    static const std::pair<const char *, uint32_t> names[] =
+    {
+        { "Tile", CollisionLayer::Tile }, { "Player", CollisionLayer::Player },
+        { "Npc", CollisionLayer::Npc }, { "Sword", CollisionLayer::Sword }
+    };
+
+    layers = CollisionLayer::None;
+    const char * end = token + length;
+    while (token < end)
+    {
+        const char * bar = static_cast<const char *>(memchr(token, '|', end - token));
+        size_t n = (bar ? bar : end) - token;
+
+        bool known = false;
+        for (auto & name : names)
+        {
+            if (TokenIs(token, n, name.first)) { layers |= name.second; known = true; }
+        }
+        if (!known)
+        {
+            int bit = 0;
+            TokenReader number(token, token + n);
+            if (!number.integer(bit) || !number.done() || bit < 0 || bit > 31) { return false; }
+            layers |= 1u << bit;
+        }
+        token += n + 1;
+    }
+    return true;
+}
+
+static bool StartsRecord(const char * p, const char * end)
+{
+    auto starts = [&](const char * word)
+    {
+        size_t n = strlen(word);
+        return (size_t)(end - p) > n && memcmp(p, word, n) == 0 && (p[n] == ' ' || p[n] == '\t');
+    };
+    return starts("Tile") || starts("NPC") || starts("Player");
+}
+
+static void ParseChunk(const char * begin, const char * end, const Assets & assets, LevelChunk & chunk)
+{
+    TokenReader reader(begin, end);
+    std::string name;
+    const char * token;
+    size_t length;
+
+    while (!reader.done() && reader.token(token, length))
+    {
+        if (TokenIs(token, length, "Player"))
+        {
+            auto & p = chunk.player;
+            chunk.hasPlayer = reader.real(p.x) && reader.real(p.y) && reader.real(p.cx) && reader.real(p.cy) && reader.real(p.speed);
+            continue;
+        }
+
+        bool tile = TokenIs(token, length, "Tile");
+        if (!tile && !TokenIs(token, length, "NPC")) { continue; }
+
+        // the fields shared by tiles and NPCs
+        LevelRecord record;
+        int blockMove = 0, blockVision = 0;
+        if (!reader.token(token, length)) { break; }
+        name.assign(token, length);
+        if (!reader.integer(record.roomX) || !reader.integer(record.roomY) || !reader.integer(record.tileX) || !reader.integer(record.tileY)
+            || !reader.integer(blockMove) || !reader.integer(blockVision))
+        {
+            std::cerr << "Malformed level record for " << name << std::endl;
+            continue;
+        }
+        record.type         = tile ? LevelRecord::Tile : LevelRecord::NPC;
+        record.animation    = assets.findAnimation(name);
+        record.blockMove    = blockMove != 0;
+        record.blockVision  = blockVision != 0;
+        record.layer        = tile ? (record.blockMove ? CollisionLayer::Tile : CollisionLayer::None) : CollisionLayer::Npc;
+        record.mask         = tile ? CollisionLayer::None : CollisionLayer::Tile;
+
+        // optional trailing fields, peeked so a line without them leaves the next record's keyword alone
+        while (reader.peek(token, length))
+        {
+            if (TokenIs(token, length, "Layer") || TokenIs(token, length, "Mask"))
+            {
+                bool layer = TokenIs(token, length, "Layer");
+                uint32_t bits = 0;
+                reader.token(token, length);
+                if (!reader.token(token, length) || !ParseLayers(token, length, bits))
+                {
+                    std::cerr << "Malformed collision layers for " << name << ": " << std::string(token, length) << std::endl;
+                    continue;
+                }
+                (layer ? record.layer : record.mask) = bits;
+            }
+            else if (!tile && TokenIs(token, length, "Patrol"))
+            {
+                reader.token(token, length);
+                int count = 0;
+                record.behaviour = LevelRecord::Patrol;
+                reader.real(record.speed);
+                reader.integer(count);
+
+                // a negative or overlong count (a half-saved file) is clamped to the points the line holds
+                int available = (int)(reader.tokensOnLine() / 2);
+                if (count < 0 || count > available)
+                {
+                    std::cerr << "Malformed patrol for " << name << ": " << count << " points, the line has " << available << std::endl;
+                    count = std::max(0, std::min(count, available));
+                }
+
+                record.patrolBegin = (uint32_t)chunk.patrol.size();
+                for (int i = 0; i < count; i++)
+                {
+                    Vec2 point;
+                    if (!reader.real(point.x) || !reader.real(point.y)) { break; }
+                    chunk.patrol.push_back(point);
+                }
+                record.patrolCount = (uint32_t)chunk.patrol.size() - record.patrolBegin;
+            }
+            else if (!tile && TokenIs(token, length, "Follow"))
+            {
+                reader.token(token, length);
+                record.behaviour = LevelRecord::Follow;
+                reader.real(record.speed);
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        if (!record.animation)
+        {
+            std::cerr << "Unknown animation in level: " << name << std::endl;
+            continue;
+        }
+        chunk.records.push_back(record);
+    }
+}
+
+double LevelParseStats::megabytesPerSecond() const
+{
+    return parseMicros > 0 ? (bytes / (1024.0 * 1024.0)) / (parseMicros / 1000000.0) : 0.0;
+}
+
+bool LevelParser::Parse(const std::string & path, const Assets & assets, std::vector<LevelChunk> & chunks, LevelParseStats * stats)
+{
+    sf::Clock clock;
+    chunks.clear();
+
+    MappedFile file(path);
+    if (!file.isOpen())
+    {
+        std::cerr << "Could not open level file: " << path << std::endl;
+        return false;
+    }
+
+    // small files are not worth a thread, large ones get one slice per core
+    const size_t minSlice   = 256 * 1024;
+    const char * data       = file.data();
+    const char * end        = data + file.size();
+    size_t cores            = std::max(1u, std::thread::hardware_concurrency());
+    size_t slices           = std::max<size_t>(1, std::min(cores, file.size() / minSlice));
+
+    // cut at the start of a line that begins a record, so no record is split between slices
+    std::vector<const char *> bounds(1, data);
+    for (size_t i = 1; i < slices; i++)
+    {
+        const char * p = std::max(bounds.back(), data + file.size() * i / slices);
+        while (p < end)
+        {
+            const char * line = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (!line) { p = end; break; }
+            p = line + 1;
+            if (StartsRecord(p, end)) { break; }
+        }
+        bounds.push_back(p);
+    }
+    bounds.push_back(end);
+
+    chunks.resize(bounds.size() - 1);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks.size(); i++)
+    {
+        workers.emplace_back(ParseChunk, bounds[i], bounds[i + 1], std::cref(assets), std::ref(chunks[i]));
+    }
+    if (data) { ParseChunk(bounds[0], bounds[1], assets, chunks[0]); }
+    for (auto & worker : workers) { worker.join(); }
+
+    if (stats)
+    {
+        stats->bytes        = file.size();
+        stats->threads      = chunks.size();
+        stats->parseMicros  = clock.getElapsedTime().asMicroseconds();
+    }
+    return true;
+}
+
+size_t LevelParser::HashCombine(size_t seed, size_t value)
+{
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+size_t LevelParser::Hash(const LevelRecord & record, const LevelChunk & chunk)
+{
+    // animations are compared by address, which is stable for as long as the assets are loaded
+    size_t hash = std::hash<const void *>()(record.animation);
+    int fields[] = { record.type, record.behaviour, record.blockMove, record.blockVision, (int)record.layer, (int)record.mask, record.roomX, record.roomY, record.tileX, record.tileY };
+    for (int field : fields) { hash = HashCombine(hash, std::hash<int>()(field)); }
+
+    hash = HashCombine(hash, std::hash<float>()(record.speed));
+    for (uint32_t i = 0; i < record.patrolCount; i++)
+    {
+        auto & point = chunk.patrol[record.patrolBegin + i];
+        hash = HashCombine(hash, std::hash<float>()(point.x));
+        hash = HashCombine(hash, std::hash<float>()(point.y));
+    }
+    return hash;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Common.h"
+#include "Animation.h"
+
+class Assets;
+
+// one Tile or NPC line of a level file, names already resolved to animations
+struct LevelRecord
+{
+    enum Type : unsigned char { Tile, NPC };
+    enum Behaviour : unsigned char { None, Patrol, Follow };
+
+    Type                type        = Tile;
+    Behaviour           behaviour   = None;
+    bool                blockMove   = false;
+    bool                blockVision = false;
+    const Animation *   animation   = nullptr;
+    int                 roomX = 0, roomY = 0;
+    int                 tileX = 0, tileY = 0;
+    float               speed       = 0;
+    uint32_t            layer       = 0;    // CollisionLayer bits, from the blockMove flag unless the line has Layer
+    uint32_t            mask        = 0;    // CollisionLayer bits, from the record type unless the line has Mask
+    uint32_t            patrolBegin = 0;    // index into LevelChunk::patrol
+    uint32_t            patrolCount = 0;
+};
+
+struct LevelPlayer
+{
+    float x = 0, y = 0, cx = 0, cy = 0, speed = 0;
+};
+
+// records parsed from one slice of the file, in file order
+struct LevelChunk
+{
+    std::vector<LevelRecord>    records;
+    std::vector<Vec2>           patrol;
+    bool                        hasPlayer = false;
+    LevelPlayer                 player;
+};
+
+struct LevelParseStats
+{
+    size_t      bytes       = 0;
+    size_t      threads     = 0;
+    long long   parseMicros = 0;
+
+    double megabytesPerSecond() const;
+};
+
+// Parses a level file on several threads.
+// Tile and NPC lines may end with "Layer <layers>" and "Mask <layers>", where <layers> is
+// one or more of Tile, Player, Npc, Sword or a bit number, joined by '|' (e.g. "Mask Tile|5").
+// The file is memory-mapped and cut into slices at record boundaries, each slice is
+// parsed into its own chunk with hand-rolled number parsing, and the chunks come back
+// in file order so the caller can create entities in one sequential pass.
+namespace LevelParser
+{
+    bool Parse(const std::string & path, const Assets & assets, std::vector<LevelChunk> & chunks, LevelParseStats * stats = nullptr);
+
+    // hash of everything a record spawns, combined per room to spot rooms whose lines changed
+    size_t Hash(const LevelRecord & record, const LevelChunk & chunk);
+    size_t HashCombine(size_t seed, size_t value);
+}
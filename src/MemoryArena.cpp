@@ -0,0 +1,255 @@
+#include "MemoryArena.h"
+#include <atomic>
+#include <cstdlib>
+#include <cassert>
+#include <algorithm>
+#include <iterator>
+
+#ifdef _WIN32
+    #include <malloc.h>
+#endif
+
+static std::atomic<size_t> s_heapAllocations(0);
+
+// replace the global allocation functions so every heap allocation is counted
+void * operator new(size_t size)
+{
+    s_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void * p = std::malloc(size ? size : 1);
+    if (!p) { throw std::bad_alloc(); }
+    return p;
+}
+
+void * operator new[](size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void * p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// the nothrow forms do not go through the throwing ones, so they are counted separately
+void * operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    s_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void * operator new[](size_t size, const std::nothrow_t & tag) noexcept
+{
+    return ::operator new(size, tag);
+}
+
+void operator delete(void * p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void * p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+#ifdef __cpp_aligned_new
+// From C++17 types aligned beyond max_align_t are allocated through these, and their memory
+// has to be given back with the matching aligned free
+static void * AlignedAlloc(size_t size, size_t alignment) noexcept
+{
+    s_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    void * p = nullptr;
+    return posix_memalign(&p, alignment < sizeof(void *) ? sizeof(void *) : alignment, size ? size : 1) == 0 ? p : nullptr;
+#endif
+}
+
+static void AlignedFree(void * p) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void * operator new(size_t size, std::align_val_t alignment)
+{
+    void * p = AlignedAlloc(size, (size_t)alignment);
+    if (!p) { throw std::bad_alloc(); }
+    return p;
+}
+
+void * operator new[](size_t size, std::align_val_t alignment)
+{
+    return ::operator new(size, alignment);
+}
+
+void * operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return AlignedAlloc(size, (size_t)alignment);
+}
+
+void * operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return AlignedAlloc(size, (size_t)alignment);
+}
+
+void operator delete(void * p, std::align_val_t) noexcept                           { AlignedFree(p); }
+void operator delete[](void * p, std::align_val_t) noexcept                         { AlignedFree(p); }
+void operator delete(void * p, size_t, std::align_val_t) noexcept                   { AlignedFree(p); }
+void operator delete[](void * p, size_t, std::align_val_t) noexcept                 { AlignedFree(p); }
+void operator delete(void * p, std::align_val_t, const std::nothrow_t &) noexcept   { AlignedFree(p); }
+void operator delete[](void * p, std::align_val_t, const std::nothrow_t &) noexcept { AlignedFree(p); }
+#endif
+
+size_t GetHeapAllocationCount()
+{
+    return s_heapAllocations.load(std::memory_order_relaxed);
+}
+
+MemoryArena::MemoryArena(size_t blockSize)
+    : m_blockSize(blockSize)
+{
+
+}
+
+MemoryArena::~MemoryArena()
+{
+    release();
+}
+
+void MemoryArena::addBlock(size_t minSize)
+{
+    size_t size = minSize > m_blockSize ? minSize : m_blockSize;
+    m_blocks.push_back({ static_cast<char *>(::operator new(size)), size });
+    m_bytesReserved += size;
+}
+
+bool MemoryArena::Recyclable(size_t bytes, size_t alignment)
+{
+    return bytes <= RecycleLimit && alignment <= RecycleStep;
+}
+
+void * MemoryArena::allocate(size_t bytes, size_t alignment)
+{
+    assert(alignment && (alignment & (alignment - 1)) == 0);
+
+    // small requests are rounded up to their size class and aligned alike, so any freed
+    // allocation of the class fits, and are served from its free list first
+    if (Recyclable(bytes, alignment))
+    {
+        bytes       = bytes ? (bytes + RecycleStep - 1) & ~(RecycleStep - 1) : RecycleStep;
+        alignment   = RecycleStep;
+
+        void *& head = m_recycled[bytes / RecycleStep - 1];
+        if (head)
+        {
+            void * p = head;
+            head = *static_cast<void **>(p);
+            m_bytesUsed += bytes;
+            m_allocations++;
+            return p;
+        }
+    }
+
+    // walk forward through the blocks until one can hold the request
+    // blocks kept from before the last reset are reused before growing
+    while (true)
+    {
+        if (m_currentBlock < m_blocks.size())
+        {
+            Block & block   = m_blocks[m_currentBlock];
+            size_t base     = reinterpret_cast<size_t>(block.data);
+            size_t aligned  = (base + m_offset + alignment - 1) & ~(alignment - 1);
+            size_t end      = aligned - base + bytes;
+
+            if (end <= block.size)
+            {
+                m_offset     = end;
+                m_bytesUsed += bytes;
+                m_allocations++;
+                return reinterpret_cast<void *>(aligned);
+            }
+
+            // an oversized request on a fresh block gets a dedicated block inserted here
+            if (m_offset == 0)
+            {
+                size_t size = bytes + alignment;
+                m_blocks.insert(m_blocks.begin() + m_currentBlock, { static_cast<char *>(::operator new(size)), size });
+                m_bytesReserved += size;
+                continue;
+            }
+
+            m_currentBlock++;
+            m_offset = 0;
+        }
+        else
+        {
+            addBlock(bytes + alignment);
+        }
+    }
+}
+
+void MemoryArena::deallocate(void * p, size_t bytes, size_t alignment)
+{
+    if (!p || !Recyclable(bytes, alignment)) { return; }
+
+    bytes = bytes ? (bytes + RecycleStep - 1) & ~(RecycleStep - 1) : RecycleStep;
+    void *& head = m_recycled[bytes / RecycleStep - 1];
+    *static_cast<void **>(p) = head;
+    head = p;
+    m_bytesUsed -= bytes;
+}
+
+void MemoryArena::reset()
+{
+    std::fill(std::begin(m_recycled), std::end(m_recycled), nullptr);
+    m_currentBlock  = 0;
+    m_offset        = 0;
+    m_allocations   = 0;
+    m_bytesUsed     = 0;
+}
+
+void MemoryArena::release()
+{
+    for (auto & block : m_blocks)
+    {
+        ::operator delete(block.data);
+    }
+    m_blocks.clear();
+    m_bytesReserved = 0;
+    reset();
+}
+
+size_t MemoryArena::allocationCount() const
+{
+    return m_allocations;
+}
+
+size_t MemoryArena::bytesUsed() const
+{
+    return m_bytesUsed;
+}
+
+size_t MemoryArena::bytesReserved() const
+{
+    return m_bytesReserved;
+}
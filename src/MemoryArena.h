@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <new>
+
+// total number of global operator new calls made by the process so far, in every form:
+// plain, array, nothrow and, from C++17, aligned
+// take the difference between two readings to count allocations over a frame
+size_t GetHeapAllocationCount();
+
+// Monotonic arena: memory is handed out from large blocks and individual
+// allocations are never returned to the heap. reset() rewinds the arena in one
+// shot but keeps the blocks, so an arena that is reset every frame stops touching
+// the heap once it has grown to its steady-state size. Small allocations given
+// back with deallocate() are reused by later ones of the same size class, so an
+// arena that outlives many short-lived entities stops growing too.
+class MemoryArena
+{
+    struct Block
+    {
+        char *  data;
+        size_t  size;
+    };
+
+    // small allocations come in whole steps of RecycleStep bytes, freed ones are kept in
+    // one list per step, linked through their own first bytes
+    static const size_t RecycleStep     = 16;
+    static const size_t RecycleLimit    = 1024;
+
+    std::vector<Block>  m_blocks;
+    size_t              m_blockSize     = 0;
+    size_t              m_currentBlock  = 0;
+    size_t              m_offset        = 0;
+    size_t              m_allocations   = 0;    // allocations since the last reset
+    size_t              m_bytesUsed     = 0;    // bytes handed out since the last reset and not given back
+    size_t              m_bytesReserved = 0;    // bytes held in blocks
+    void *              m_recycled[RecycleLimit / RecycleStep] = {};
+
+    void addBlock(size_t minSize);
+    static bool Recyclable(size_t bytes, size_t alignment);
+
+public:
+
+    MemoryArena(size_t blockSize = 64 * 1024);
+    ~MemoryArena();
+
+    MemoryArena(const MemoryArena &) = delete;
+    MemoryArena & operator = (const MemoryArena &) = delete;
+
+    void * allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T * allocateArray(size_t count)
+    {
+        return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // give an allocation back for reuse by a later one of the same size; only small ones
+    // are kept, larger ones wait for the next reset. Must not be called with memory
+    // allocated before the last reset.
+    void deallocate(void * p, size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    void deallocateArray(T * p, size_t count)
+    {
+        deallocate(p, sizeof(T) * count, alignof(T));
+    }
+
+    // rewind the arena, everything previously allocated from it is invalidated
+    void reset();
+
+    // rewind the arena and give its blocks back to the heap
+    void release();
+
+    size_t allocationCount()    const;
+    size_t bytesUsed()          const;
+    size_t bytesReserved()      const;
+};
+
+// STL allocator that draws from a MemoryArena, falling back to the heap when
+// no arena is given. Arena memory it deallocates is recycled by the arena, or
+// reclaimed when the arena is reset.
+template <typename T>
+class ArenaAllocator
+{
+    template <typename U> friend class ArenaAllocator;
+
+    MemoryArena * m_arena = nullptr;
+
+public:
+
+    typedef T value_type;
+
+    ArenaAllocator(MemoryArena * arena = nullptr) : m_arena(arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> & other) : m_arena(other.m_arena) {}
+
+    T * allocate(size_t count)
+    {
+        if (m_arena) { return m_arena->allocateArray<T>(count); }
+        return static_cast<T *>(::operator new(count * sizeof(T)));
+    }
+
+    void deallocate(T * p, size_t count)
+    {
+        if (m_arena)    { m_arena->deallocateArray(p, count); }
+        else            { ::operator delete(p); }
+    }
+
+    MemoryArena * arena() const { return m_arena; }
+
+    template <typename U>
+    bool operator == (const ArenaAllocator<U> & rhs) const { return m_arena == rhs.m_arena; }
+
+    template <typename U>
+    bool operator != (const ArenaAllocator<U> & rhs) const { return m_arena != rhs.m_arena; }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// STL allocator whose arrays start on a 64-byte cache line, so threads writing disjoint
+// 64-byte-multiple ranges of one array never share a line. Over-allocates from the heap
+// and keeps the original pointer just before the aligned one.
+template <typename T>
+class CacheLineAllocator
+{
+public:
+
+    typedef T value_type;
+
+    static const size_t LineSize = 64;
+
+    CacheLineAllocator() {}
+
+    template <typename U>
+    CacheLineAllocator(const CacheLineAllocator<U> &) {}
+
+    T * allocate(size_t count)
+    {
+        char * base     = static_cast<char *>(::operator new(count * sizeof(T) + LineSize + sizeof(void *)));
+        size_t aligned  = (reinterpret_cast<size_t>(base) + sizeof(void *) + LineSize - 1) & ~(LineSize - 1);
+        reinterpret_cast<void **>(aligned)[-1] = base;
+        return reinterpret_cast<T *>(aligned);
+    }
+
+    void deallocate(T * p, size_t)
+    {
+        ::operator delete(reinterpret_cast<void **>(p)[-1]);
+    }
+
+    template <typename U>
+    bool operator == (const CacheLineAllocator<U> &) const { return true; }
+
+    template <typename U>
+    bool operator != (const CacheLineAllocator<U> &) const { return false; }
+};
+
+template <typename T>
+using CacheLineVector = std::vector<T, CacheLineAllocator<T>>;
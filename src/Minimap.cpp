@@ -0,0 +1,99 @@
+#include "Minimap.h"
+#include <math.h>
+
+void MinimapFrame::clear()
+{
+    area = sf::FloatRect();
+    rooms.clear();
+    markers.clear();
+}
+
+Minimap::Minimap(const sf::Vector2u & roomSize, unsigned scale)
+    : m_roomSize(roomSize)
+    , m_scale(scale)
+{
+
+}
+
+Minimap::Baked & Minimap::bake(const MinimapRoom & room)
+{
+    Baked & baked = m_baked[std::make_pair(room.x, room.y)];
+    if (baked.source == room.tiles) { return baked; }
+
+    if (!baked.source && !baked.texture.create(m_roomSize.x / m_scale, m_roomSize.y / m_scale))
+    {
+        std::cerr << "Could not create minimap texture for room " << room.x << " " << room.y << "\n";
+    }
+
+    // draw the room at low resolution by giving the texture a view of the whole room
+    baked.texture.setView(sf::View(sf::FloatRect((float)room.x * m_roomSize.x, (float)room.y * m_roomSize.y, (float)m_roomSize.x, (float)m_roomSize.y)));
+    baked.texture.clear(sf::Color::Transparent);
+    room.tiles->flush(baked.texture);
+    baked.texture.display();
+
+    baked.source = room.tiles;
+    m_bakes++;
+    return baked;
+}
+
+void Minimap::draw(sf::RenderTarget & target, const MinimapFrame & frame)
+{
+    m_drawCalls = 0;
+    if (frame.area.width <= 0 || frame.area.height <= 0) { return; }
+
+    // a view of the area squeezed into the bottom-right corner of the target
+    auto targetSize = target.getSize();
+    float width     = frame.area.width / m_scale / targetSize.x;
+    float height    = frame.area.height / m_scale / targetSize.y;
+    sf::View view(frame.area);
+    view.setViewport(sf::FloatRect(1.0f - width - 0.02f, 1.0f - height - 0.02f, width, height));
+    target.setView(view);
+
+    // drop the rooms that are now too far from the shown area to come back soon
+    int centerX = (int)floor((frame.area.left + frame.area.width / 2) / m_roomSize.x);
+    int centerY = (int)floor((frame.area.top + frame.area.height / 2) / m_roomSize.y);
+    for (auto it = m_baked.begin(); it != m_baked.end();)
+    {
+        if (abs(it->first.first - centerX) > KeepRadius || abs(it->first.second - centerY) > KeepRadius)
+        {
+            it = m_baked.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // the markers start with the background quad, which goes under the rooms
+    if (frame.markers.size() >= 4)
+    {
+        target.draw(&frame.markers[0], 4, sf::Quads);
+        m_drawCalls++;
+    }
+
+    for (auto & room : frame.rooms)
+    {
+        auto & baked = bake(room);
+        m_sprite.setTexture(baked.texture.getTexture(), true);
+        m_sprite.setPosition((float)room.x * m_roomSize.x, (float)room.y * m_roomSize.y);
+        m_sprite.setScale((float)m_scale, (float)m_scale);
+        target.draw(m_sprite);
+        m_drawCalls++;
+    }
+
+    if (frame.markers.size() > 4)
+    {
+        target.draw(&frame.markers[4], frame.markers.size() - 4, sf::Quads);
+        m_drawCalls++;
+    }
+}
+
+size_t Minimap::bakeCount() const
+{
+    return m_bakes;
+}
+
+size_t Minimap::drawCalls() const
+{
+    return m_drawCalls;
+}
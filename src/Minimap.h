@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Common.h"
+#include "RenderQueue.h"
+#include <map>
+
+// one room of the minimap: the room's grid coordinates and its static tile sprites,
+// the tile queue is rebuilt whenever a tile in the room changes
+struct MinimapRoom
+{
+    int                             x = 0;
+    int                             y = 0;
+    std::shared_ptr<RenderQueue>    tiles;
+};
+
+// what the simulation hands over each frame to draw the minimap
+struct MinimapFrame
+{
+    sf::FloatRect               area;       // world rectangle shown, empty frame when hidden
+    std::vector<MinimapRoom>    rooms;      // rooms inside the area that have tiles
+    std::vector<sf::Vertex>     markers;    // background, npc and player quads in world coordinates
+
+    void clear();
+};
+
+// Draws the minimap in the bottom-right corner of the window.
+// Each room's tiles are baked once into a small render texture and only re-baked when
+// the simulation hands over a new tile queue for that room, so a frame costs one draw
+// per room in the area plus two for the background and markers, however large the map is.
+// Rooms further than KeepRadius rooms from the centre of the shown area are dropped, on
+// both threads, so the baked textures stay bounded however far the player travels.
+// Lives on the thread that owns the window, since baking needs its GL context.
+class Minimap
+{
+public:
+
+    static const int    KeepRadius  = 2;
+    static const size_t KeepCount   = (2 * KeepRadius + 1) * (2 * KeepRadius + 1);
+
+private:
+
+    struct Baked
+    {
+        std::shared_ptr<RenderQueue>    source;     // tile queue the texture was baked from
+        sf::RenderTexture               texture;
+    };
+
+    std::map<std::pair<int, int>, Baked>    m_baked;
+    sf::Vector2u    m_roomSize;
+    unsigned        m_scale;
+    sf::Sprite      m_sprite;
+    size_t          m_bakes     = 0;
+    size_t          m_drawCalls = 0;
+
+    Baked & bake(const MinimapRoom & room);
+
+public:
+
+    // scale is how many world pixels map onto one minimap pixel
+    Minimap(const sf::Vector2u & roomSize, unsigned scale = 16);
+
+    void draw(sf::RenderTarget & target, const MinimapFrame & frame);
+
+    size_t bakeCount() const;
+    size_t drawCalls() const;   // draw calls issued for the last frame
+};
@@ -0,0 +1,270 @@
+#include "NavGrid.h"
+#include <cstdlib>
+#include <math.h>
+
+static const int NeighbourX[8]  = { 1, -1, 0,  0, 1,  1, -1, -1 };
+static const int NeighbourY[8]  = { 0,  0, 1, -1, 1, -1,  1, -1 };
+static const int StepCost[8]    = { 10, 10, 10, 10, 14, 14, 14, 14 };
+
+static int FloorDiv(int a, int b)
+{
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+NavGrid::NavGrid()
+{
+
+}
+
+void NavGrid::build(const Vec2 & cellSize, const GridCell & roomCells, const std::vector<GridCell> & blockedCells)
+{
+    m_cellSize  = cellSize;
+    m_roomCells = roomCells;
+    m_flowValid = false;
+
+    if (blockedCells.empty())
+    {
+        m_width = m_height = 0;
+        m_blocked.clear();
+        return;
+    }
+
+    // cover whole rooms so every room that contains a tile is searchable end to end
+    GridCell minRoom = roomOf(blockedCells[0]), maxRoom = minRoom;
+    for (auto & c : blockedCells)
+    {
+        auto room = roomOf(c);
+        minRoom.x = std::min(minRoom.x, room.x); minRoom.y = std::min(minRoom.y, room.y);
+        maxRoom.x = std::max(maxRoom.x, room.x); maxRoom.y = std::max(maxRoom.y, room.y);
+    }
+
+    m_origin = GridCell(minRoom.x * m_roomCells.x, minRoom.y * m_roomCells.y);
+    m_width  = (maxRoom.x - minRoom.x + 1) * m_roomCells.x;
+    m_height = (maxRoom.y - minRoom.y + 1) * m_roomCells.y;
+    m_blocked.assign(m_width * m_height, 0);
+
+    for (auto & c : blockedCells)
+    {
+        m_blocked[index(c)] = 1;
+    }
+
+    m_flowDistance.assign(m_roomCells.x * m_roomCells.y, -1);
+    m_pathCost.assign(m_blocked.size(), 0);
+    m_pathParent.assign(m_blocked.size(), -1);
+    m_pathStamp.assign(m_blocked.size(), 0);
+    m_searchStamp = 0;
+}
+
+int NavGrid::index(const GridCell & c) const
+{
+    int x = c.x - m_origin.x;
+    int y = c.y - m_origin.y;
+    if (x < 0 || y < 0 || x >= m_width || y >= m_height) { return -1; }
+    return y * m_width + x;
+}
+
+int NavGrid::roomIndex(const GridCell & c) const
+{
+    return (c.y - m_flowRoom.y * m_roomCells.y) * m_roomCells.x + (c.x - m_flowRoom.x * m_roomCells.x);
+}
+
+bool NavGrid::inRoom(const GridCell & c, const GridCell & room) const
+{
+    return roomOf(c) == room;
+}
+
+const Vec2 & NavGrid::cellSize() const
+{
+    return m_cellSize;
+}
+
+GridCell NavGrid::cellOf(const Vec2 & pos) const
+{
+    return GridCell((int)floorf(pos.x / m_cellSize.x), (int)floorf(pos.y / m_cellSize.y));
+}
+
+GridCell NavGrid::roomOf(const GridCell & cell) const
+{
+    return GridCell(FloorDiv(cell.x, m_roomCells.x), FloorDiv(cell.y, m_roomCells.y));
+}
+
+Vec2 NavGrid::cellCenter(const GridCell & cell) const
+{
+    return Vec2((cell.x + 0.5f) * m_cellSize.x, (cell.y + 0.5f) * m_cellSize.y);
+}
+
+bool NavGrid::isBlocked(const GridCell & cell) const
+{
+    int i = index(cell);
+    return i >= 0 && m_blocked[i];
+}
+
+bool NavGrid::canStep(const GridCell & from, int dx, int dy) const
+{
+    if (isBlocked(GridCell(from.x + dx, from.y + dy))) { return false; }
+
+    // diagonal steps may not cut the corner of a blocked cell
+    if (dx != 0 && dy != 0)
+    {
+        return !isBlocked(GridCell(from.x + dx, from.y)) && !isBlocked(GridCell(from.x, from.y + dy));
+    }
+    return true;
+}
+
+bool NavGrid::updateFlowField(const Vec2 & target)
+{
+    auto cell = cellOf(target);
+    if (m_flowValid && cell == m_flowTarget) { return false; }
+
+    m_flowTarget    = cell;
+    m_flowRoom      = roomOf(cell);
+    buildFlowField();
+    return true;
+}
+
+void NavGrid::buildFlowField()
+{
+    // breadth-first search outward from the target, restricted to the target's room
+    m_flowDistance.assign(m_roomCells.x * m_roomCells.y, -1);
+    m_flowQueue.clear();
+    m_flowValid = true;
+    m_flowBuilds++;
+
+    m_flowDistance[roomIndex(m_flowTarget)] = 0;
+    m_flowQueue.push_back(roomIndex(m_flowTarget));
+
+    for (size_t head = 0; head < m_flowQueue.size(); head++)
+    {
+        int current = m_flowQueue[head];
+        GridCell cell(m_flowRoom.x * m_roomCells.x + current % m_roomCells.x, m_flowRoom.y * m_roomCells.y + current / m_roomCells.x);
+
+        for (int n = 0; n < 8; n++)
+        {
+            GridCell next(cell.x + NeighbourX[n], cell.y + NeighbourY[n]);
+            if (!inRoom(next, m_flowRoom) || !canStep(cell, NeighbourX[n], NeighbourY[n])) { continue; }
+
+            int ni = roomIndex(next);
+            if (m_flowDistance[ni] < 0)
+            {
+                m_flowDistance[ni] = m_flowDistance[current] + 1;
+                m_flowQueue.push_back(ni);
+            }
+        }
+    }
+}
+
+bool NavGrid::flowWaypoint(const Vec2 & pos, Vec2 & waypoint) const
+{
+    auto cell = cellOf(pos);
+    if (!m_flowValid || cell == m_flowTarget || !inRoom(cell, m_flowRoom)) { return false; }
+
+    int distance = m_flowDistance[roomIndex(cell)];
+    if (distance < 0) { return false; }
+
+    // step to the neighbour closest to the target, breaking ties by straight-line distance
+    auto  targetCenter  = cellCenter(m_flowTarget);
+    bool  found         = false;
+    int   bestDistance  = distance;
+    float bestDist      = 0;
+    for (int n = 0; n < 8; n++)
+    {
+        GridCell next(cell.x + NeighbourX[n], cell.y + NeighbourY[n]);
+        if (!inRoom(next, m_flowRoom) || !canStep(cell, NeighbourX[n], NeighbourY[n])) { continue; }
+
+        int d = m_flowDistance[roomIndex(next)];
+        if (d < 0) { continue; }
+
+        auto  center = cellCenter(next);
+        float dist   = center.distSq(targetCenter);   // only compared, so no square root
+        if (d < bestDistance || (found && d == bestDistance && dist < bestDist))
+        {
+            found           = true;
+            bestDistance    = d;
+            bestDist        = dist;
+            waypoint        = center;
+        }
+    }
+    return found;
+}
+
+bool NavGrid::findPath(const Vec2 & from, const Vec2 & to, std::vector<Vec2> & path) const
+{
+    // room for any path within one room up front, so a longer walk home later does not grow it
+    path.clear();
+    path.reserve((size_t)(m_roomCells.x * m_roomCells.y) + 1);
+
+    auto start  = cellOf(from);
+    auto goal   = cellOf(to);
+    int  si     = index(start);
+    int  gi     = index(goal);
+    if (si < 0 || gi < 0 || m_blocked[gi]) { return false; }
+
+    if (start == goal)
+    {
+        path.push_back(to);
+        return true;
+    }
+
+    // octile distance heuristic, consistent with the 10 / 14 step costs
+    auto heuristic = [&goal](const GridCell & c)
+    {
+        int dx = abs(c.x - goal.x), dy = abs(c.y - goal.y);
+        return 10 * (dx + dy) - 6 * std::min(dx, dy);
+    };
+    auto compare = [](const OpenNode & a, const OpenNode & b) { return a.cost > b.cost; };
+
+    m_searchStamp++;
+    m_pathOpen.clear();
+    m_pathStamp[si]     = m_searchStamp;
+    m_pathCost[si]      = 0;
+    m_pathParent[si]    = -1;
+    m_pathOpen.push_back({ heuristic(start), si });
+
+    bool reached = false;
+    while (!m_pathOpen.empty())
+    {
+        std::pop_heap(m_pathOpen.begin(), m_pathOpen.end(), compare);
+        OpenNode node = m_pathOpen.back();
+        m_pathOpen.pop_back();
+
+        if (node.index == gi) { reached = true; break; }
+
+        GridCell cell(m_origin.x + node.index % m_width, m_origin.y + node.index / m_width);
+
+        // skip stale heap entries that were superseded by a cheaper route
+        if (node.cost - heuristic(cell) > m_pathCost[node.index]) { continue; }
+
+        for (int n = 0; n < 8; n++)
+        {
+            GridCell next(cell.x + NeighbourX[n], cell.y + NeighbourY[n]);
+            int ni = index(next);
+            if (ni < 0 || !canStep(cell, NeighbourX[n], NeighbourY[n])) { continue; }
+
+            int cost = m_pathCost[node.index] + StepCost[n];
+            if (m_pathStamp[ni] != m_searchStamp || cost < m_pathCost[ni])
+            {
+                m_pathStamp[ni]     = m_searchStamp;
+                m_pathCost[ni]      = cost;
+                m_pathParent[ni]    = node.index;
+                m_pathOpen.push_back({ cost + heuristic(next), ni });
+                std::push_heap(m_pathOpen.begin(), m_pathOpen.end(), compare);
+            }
+        }
+    }
+
+    if (!reached) { return false; }
+
+    // walk back from the goal, the start cell itself is not a waypoint
+    for (int i = m_pathParent[gi]; i != si && i >= 0; i = m_pathParent[i])
+    {
+        path.push_back(cellCenter(GridCell(m_origin.x + i % m_width, m_origin.y + i / m_width)));
+    }
+    std::reverse(path.begin(), path.end());
+    path.push_back(to);
+    return true;
+}
+
+size_t NavGrid::flowFieldBuilds() const
+{
+    return m_flowBuilds;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Common.h"
+
+struct GridCell
+{
+    int x = 0;
+    int y = 0;
+
+    GridCell() {}
+    GridCell(int xin, int yin) : x(xin), y(yin) {}
+
+    bool operator == (const GridCell & rhs) const { return x == rhs.x && y == rhs.y; }
+    bool operator != (const GridCell & rhs) const { return !(*this == rhs); }
+};
+
+// Navigation grid built from the level's movement-blocking tiles.
+// Cells are one tile in size and rooms are a fixed number of cells, so any
+// world position maps directly to a cell and a room.
+class NavGrid
+{
+    Vec2                        m_cellSize      = { 64, 64 };
+    GridCell                    m_roomCells     = { 20, 12 };   // size of one room in cells
+    GridCell                    m_origin;                       // cell at index 0 of m_blocked
+    int                         m_width         = 0;
+    int                         m_height        = 0;
+    std::vector<unsigned char>  m_blocked;
+
+    // flow field over the target's room, rebuilt only when the target changes cell
+    GridCell                    m_flowRoom;
+    GridCell                    m_flowTarget;
+    bool                        m_flowValid     = false;
+    std::vector<int>            m_flowDistance;
+    std::vector<int>            m_flowQueue;
+    size_t                      m_flowBuilds    = 0;
+
+    // A* scratch space, stamped per search so nothing has to be cleared
+    struct OpenNode { int cost; int index; };
+    mutable std::vector<int>        m_pathCost;
+    mutable std::vector<int>        m_pathParent;
+    mutable std::vector<unsigned>   m_pathStamp;
+    mutable std::vector<OpenNode>   m_pathOpen;
+    mutable unsigned                m_searchStamp   = 0;
+
+    int  index(const GridCell & c) const;
+    int  roomIndex(const GridCell & c) const;
+    bool inRoom(const GridCell & c, const GridCell & room) const;
+    bool canStep(const GridCell & from, int dx, int dy) const;
+    void buildFlowField();
+
+public:
+
+    NavGrid();
+
+    // (re)build the grid from the cells occupied by movement-blocking tiles
+    void build(const Vec2 & cellSize, const GridCell & roomCells, const std::vector<GridCell> & blockedCells);
+
+    const Vec2 & cellSize() const;
+    GridCell cellOf(const Vec2 & pos) const;
+    GridCell roomOf(const GridCell & cell) const;
+    Vec2     cellCenter(const GridCell & cell) const;
+    bool     isBlocked(const GridCell & cell) const;
+
+    // move the flow field target, returns true if the field had to be rebuilt
+    bool updateFlowField(const Vec2 & target);
+
+    // next waypoint from pos following the flow field toward its target
+    // returns false when pos is outside the field's room, unreachable, or already in the target cell
+    bool flowWaypoint(const Vec2 & pos, Vec2 & waypoint) const;
+
+    // A* from one position to another, path receives the cell centers to visit
+    // with the exact goal position as its final waypoint
+    bool findPath(const Vec2 & from, const Vec2 & to, std::vector<Vec2> & path) const;
+
+    size_t flowFieldBuilds() const;
+};
@@ -0,0 +1,222 @@
+#include "ParticleSystem.h"
+#include <math.h>
+
+// SSE2 is part of every x64 target, 32-bit builds opt in with /arch:SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define PARTICLES_SSE2 1
+#endif
+
+const size_t ParticleSystem::PoolReserve;
+
+void ParticleSystem::Pool::push(float px, float py, float pvx, float pvy, float plife, float prate, float pdrag, float pscale)
+{
+    x.push_back(px);
+    y.push_back(py);
+    vx.push_back(pvx);
+    vy.push_back(pvy);
+    life.push_back(plife);
+    frame.push_back(0);
+    rate.push_back(prate);
+    drag.push_back(pdrag);
+    scale.push_back(pscale);
+}
+
+void ParticleSystem::Pool::removeDead()
+{
+    // the last particle takes the place of a dead one, draw order within a pool does not matter
+    size_t n = size();
+    for (size_t i = 0; i < n;)
+    {
+        if (life[i] > 0) { i++; continue; }
+
+        n--;
+        x[i]        = x[n];
+        y[i]        = y[n];
+        vx[i]       = vx[n];
+        vy[i]       = vy[n];
+        life[i]     = life[n];
+        frame[i]    = frame[n];
+        rate[i]     = rate[n];
+        drag[i]     = drag[n];
+        scale[i]    = scale[n];
+    }
+
+    for (auto field : { &x, &y, &vx, &vy, &life, &frame, &rate, &drag, &scale })
+    {
+        field->resize(n);
+    }
+}
+
+void ParticleSystem::UpdateScalar(Pool & pool, size_t begin)
+{
+    size_t n = pool.size();
+    for (size_t i = begin; i < n; i++)
+    {
+        pool.x[i]       += pool.vx[i];
+        pool.y[i]       += pool.vy[i];
+        pool.vx[i]      *= pool.drag[i];
+        pool.vy[i]      *= pool.drag[i];
+        pool.life[i]    -= 1.0f;
+        pool.frame[i]   += pool.rate[i];
+    }
+}
+
+size_t ParticleSystem::UpdateVectorized(Pool & pool)
+{
+#ifdef PARTICLES_SSE2
+    // whole groups of four, the scalar kernel finishes the tail
+    size_t n = pool.size() & ~(size_t)3;
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (size_t i = 0; i < n; i += 4)
+    {
+        __m128 vx   = _mm_loadu_ps(&pool.vx[i]);
+        __m128 vy   = _mm_loadu_ps(&pool.vy[i]);
+        __m128 drag = _mm_loadu_ps(&pool.drag[i]);
+
+        _mm_storeu_ps(&pool.x[i],       _mm_add_ps(_mm_loadu_ps(&pool.x[i]), vx));
+        _mm_storeu_ps(&pool.y[i],       _mm_add_ps(_mm_loadu_ps(&pool.y[i]), vy));
+        _mm_storeu_ps(&pool.vx[i],      _mm_mul_ps(vx, drag));
+        _mm_storeu_ps(&pool.vy[i],      _mm_mul_ps(vy, drag));
+        _mm_storeu_ps(&pool.life[i],    _mm_sub_ps(_mm_loadu_ps(&pool.life[i]), one));
+        _mm_storeu_ps(&pool.frame[i],   _mm_add_ps(_mm_loadu_ps(&pool.frame[i]), _mm_loadu_ps(&pool.rate[i])));
+    }
+    return n;
+#else
+    (void)pool;
+    return 0;
+#endif
+}
+
+float ParticleSystem::random(float min, float max)
+{
+    // xorshift, so a replayed tick sprays the same particles
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return min + (max - min) * ((m_seed >> 8) / 16777216.0f);
+}
+
+ParticleSystem::Pool & ParticleSystem::pool(const Animation & animation)
+{
+    for (auto & pool : m_pools)
+    {
+        if (pool.animation.getTexture() == animation.getTexture())
+        {
+            pool.animation.setTextureHandle(animation.getTextureHandle());
+            return pool;
+        }
+    }
+
+    m_pools.emplace_back();
+    auto & pool         = m_pools.back();
+    pool.animation      = animation;
+    pool.frameCount     = std::max<size_t>(1, animation.getFrameCount());
+    for (auto field : { &pool.x, &pool.y, &pool.vx, &pool.vy, &pool.life, &pool.frame, &pool.rate, &pool.drag, &pool.scale })
+    {
+        field->reserve(PoolReserve);
+    }
+    return pool;
+}
+
+void ParticleSystem::emit(const Animation & animation, const Vec2 & pos, const ParticleEmitter & emitter)
+{
+    auto & pool     = this->pool(animation);
+    float frames    = (float)pool.frameCount;
+    float once      = frames * std::max<size_t>(1, animation.getSpeed());
+
+    for (size_t i = 0; i < emitter.count; i++)
+    {
+        float angle = random(0, 6.2831853f);
+        float speed = random(emitter.speedMin, emitter.speedMax);
+        float life  = emitter.lifeMax > 0 ? random(emitter.lifeMin, emitter.lifeMax) : once;
+        pool.push(pos.x, pos.y, cosf(angle) * speed, sinf(angle) * speed, life, frames / life, emitter.drag, random(emitter.scaleMin, emitter.scaleMax));
+    }
+}
+
+void ParticleSystem::update()
+{
+    sf::Clock clock;
+    m_stats.live    = 0;
+    m_stats.pools   = 0;
+
+    for (auto & pool : m_pools)
+    {
+        UpdateScalar(pool, m_vectorized ? UpdateVectorized(pool) : 0);
+        pool.removeDead();
+        m_stats.live += pool.size();
+
+        // a pool without particles lets go of its texture but keeps its arrays for the next burst
+        if (pool.size() == 0) { pool.animation.setTextureHandle(nullptr); }
+        else { m_stats.pools++; }
+    }
+
+    m_stats.updateMicros    = clock.getElapsedTime().asMicroseconds();
+}
+
+void ParticleSystem::draw(const AABB & view, std::vector<sf::Vertex> & vertices, std::vector<ParticleBatch> & batches)
+{
+    // room for as many quads as the pools have room for particles, so the snapshot's
+    // arrays only grow when a pool did
+    size_t capacity = 0;
+    for (auto & pool : m_pools) { capacity += pool.x.capacity(); }
+    vertices.reserve(vertices.size() + 4 * capacity);
+    batches.reserve(batches.size() + m_pools.size());
+
+    m_stats.drawn = 0;
+    for (auto & pool : m_pools)
+    {
+        ParticleBatch batch;
+        batch.texture   = pool.animation.getTexture();
+        batch.begin     = vertices.size();
+
+        // room for every particle, written through a pointer and trimmed to the visible ones
+        vertices.resize(batch.begin + 4 * pool.size());
+        sf::Vertex * out = vertices.data() + batch.begin;
+
+        auto size = pool.animation.getSize();
+        for (size_t i = 0; i < pool.size(); i++)
+        {
+            float halfX = size.x * pool.scale[i] / 2;
+            float halfY = size.y * pool.scale[i] / 2;
+            float left  = pool.x[i] - halfX, right  = pool.x[i] + halfX;
+            float top   = pool.y[i] - halfY, bottom = pool.y[i] + halfY;
+            if (right < view.min.x || left > view.max.x || bottom < view.min.y || top > view.max.y) { continue; }
+
+            float u = (float)std::min((size_t)pool.frame[i], pool.frameCount - 1) * size.x;
+            out[0].position = sf::Vector2f(left, top);      out[0].texCoords = sf::Vector2f(u, 0);
+            out[1].position = sf::Vector2f(right, top);     out[1].texCoords = sf::Vector2f(u + size.x, 0);
+            out[2].position = sf::Vector2f(right, bottom);  out[2].texCoords = sf::Vector2f(u + size.x, size.y);
+            out[3].position = sf::Vector2f(left, bottom);   out[3].texCoords = sf::Vector2f(u, size.y);
+            out += 4;
+        }
+
+        batch.count = out - (vertices.data() + batch.begin);
+        vertices.resize(batch.begin + batch.count);
+        m_stats.drawn += batch.count / 4;
+        if (batch.count > 0) { batches.push_back(batch); }
+    }
+}
+
+void ParticleSystem::clear()
+{
+    m_pools.clear();
+    m_stats = ParticleStats();
+}
+
+void ParticleSystem::setVectorized(bool vectorized)
+{
+    m_vectorized = vectorized;
+}
+
+size_t ParticleSystem::live() const
+{
+    size_t live = 0;
+    for (auto & pool : m_pools) { live += pool.size(); }
+    return live;
+}
+
+const ParticleStats & ParticleSystem::getStats() const
+{
+    return m_stats;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Common.h"
+#include "Animation.h"
+#include "AABBTree.h"
+#include <cstdint>
+
+// what one emit() call sprays out, ranges are picked uniformly per particle
+struct ParticleEmitter
+{
+    size_t  count       = 1;
+    float   speedMin    = 0, speedMax    = 0;   // pixels per tick, in a random direction
+    float   lifeMin     = 0, lifeMax     = 0;   // ticks, 0 plays the animation once at its own speed
+    float   scaleMin    = 1, scaleMax    = 1;
+    float   drag        = 1;                    // velocity is multiplied by this every tick
+};
+
+// the quads of one texture in RenderSnapshot::particles, drawn with one call
+struct ParticleBatch
+{
+    const sf::Texture * texture = nullptr;
+    size_t              begin   = 0;
+    size_t              count   = 0;
+};
+
+struct ParticleStats
+{
+    size_t      live        = 0;
+    size_t      pools       = 0;
+    size_t      drawn       = 0;    // particles inside the view during the last draw
+    long long   updateMicros = 0;
+};
+
+// Short-lived effects that are not entities.
+// Particles live in one pool per texture, each field in its own float array, so a tick is
+// a straight pass over plain floats: four particles per instruction where SSE2 is available
+// and the same arithmetic one at a time elsewhere. Dead particles are swapped out with the
+// last one, and every pool's visible particles become a single textured quad array.
+class ParticleSystem
+{
+    struct Pool
+    {
+        Animation           animation;      // frame layout, and the handle keeping its texture resident
+        size_t              frameCount = 1;
+        std::vector<float>  x, y, vx, vy;
+        std::vector<float>  life;           // ticks left
+        std::vector<float>  frame;          // current frame, advances by rate every tick
+        std::vector<float>  rate;
+        std::vector<float>  drag;
+        std::vector<float>  scale;
+
+        size_t size() const { return x.size(); }
+        void push(float px, float py, float pvx, float pvy, float plife, float prate, float pdrag, float pscale);
+        void removeDead();
+    };
+
+    // particles a new pool has room for, so bursts after the first one do not touch the heap
+    static const size_t PoolReserve = 1024;
+
+    std::vector<Pool>   m_pools;
+    uint32_t            m_seed          = 0x9e3779b9;
+    bool                m_vectorized    = true;
+    ParticleStats       m_stats;
+
+    float random(float min, float max);
+    Pool & pool(const Animation & animation);
+
+    static void UpdateScalar(Pool & pool, size_t begin);
+    static size_t UpdateVectorized(Pool & pool);
+
+public:
+
+    void emit(const Animation & animation, const Vec2 & pos, const ParticleEmitter & emitter);
+
+    // move, age and animate every particle, then drop the ones whose life ran out
+    void update();
+
+    // append the quads of the particles touching the view, one batch per texture
+    void draw(const AABB & view, std::vector<sf::Vertex> & vertices, std::vector<ParticleBatch> & batches);
+
+    void clear();
+
+    // the scalar path, for comparing against the vectorized kernel
+    void setVectorized(bool vectorized);
+
+    size_t                  live() const;
+    const ParticleStats &   getStats() const;
+};
@@ -1,61 +1,53 @@
 #include "Physics.h"
 #include "Components.h"
+#include "Fixed.h"
+#include <limits>
 
 Vec2 Physics::GetOverlap(std::shared_ptr<Entity> a, std::shared_ptr<Entity> b)
 {
-	auto a_pos = a->getComponent<CTransform>()->pos;
-	auto b_pos = b->getComponent<CTransform>()->pos;
-
-	float delta_x = abs(a_pos.x - b_pos.x);
-	float delta_y = abs(a_pos.y - b_pos.y);
+	return GetOverlap(a.get(), b.get());
+}
 
-	float overlap_x = a->getComponent<CBoundingBox>()->halfSize.x + b->getComponent<CBoundingBox>()->halfSize.x - delta_x;
-	float overlap_y = a->getComponent<CBoundingBox>()->halfSize.y + b->getComponent<CBoundingBox>()->halfSize.y - delta_y;
+Vec2 Physics::GetOverlap(Entity * a, Entity * b)
+{
+	auto a_pos = a->getComponent<CTransform>()->pos();
+	auto b_pos = b->getComponent<CTransform>()->pos();
 
-	return Vec2(overlap_x, overlap_y);
+	return Overlap(a_pos, a->getComponent<CBoundingBox>()->halfSize, b_pos, b->getComponent<CBoundingBox>()->halfSize);
 }
 
 Vec2 Physics::GetPreviousOverlap(std::shared_ptr<Entity> a, std::shared_ptr<Entity> b)
 {
-	auto a_pos = a->getComponent<CTransform>()->pos;
-	auto b_pos = b->getComponent<CTransform>()->prevPos;
-
-	float delta_x = abs(a_pos.x - b_pos.x);
-	float delta_y = abs(a_pos.y - b_pos.y);
+	return GetPreviousOverlap(a.get(), b.get());
+}
 
-	float overlap_x = a->getComponent<CBoundingBox>()->halfSize.x + b->getComponent<CBoundingBox>()->halfSize.x - delta_x;
-	float overlap_y = a->getComponent<CBoundingBox>()->halfSize.y + b->getComponent<CBoundingBox>()->halfSize.y - delta_y;
+Vec2 Physics::GetPreviousOverlap(Entity * a, Entity * b)
+{
+	auto a_pos = a->getComponent<CTransform>()->pos();
+	auto b_pos = b->getComponent<CTransform>()->prevPos();
 
-	return Vec2(overlap_x, overlap_y);
+	return Overlap(a_pos, a->getComponent<CBoundingBox>()->halfSize, b_pos, b->getComponent<CBoundingBox>()->halfSize);
 }
 
-Intersect Physics::LineIntersect(const Vec2 & a, const Vec2 & b, const Vec2 & c, const Vec2 & d)
-{   
-	Vec2 r		= b - a;
-	Vec2 s		= d - c;
-	Vec2 cma	= c - a;
-	float rxs	= r.cross(s);
-	float t		= cma.cross(s) / rxs;
-	float u		= cma.cross(r) / rxs;
-
-	if (t >= 0 && t <= 1 && u >= 0 && u <= 1) {
-		return { true, Vec2(a.x + t * r.x, a.y + t * r.y) };
-	}
-	else {
-		return { false, Vec2(0,0) };
-	}
+bool Physics::EntityIntersect(const Vec2 & a, const Vec2 & b, std::shared_ptr<Entity> e)
+{
+	return EntityIntersect(a, b, e.get());
 }
 
-bool Physics::EntityIntersect(const Vec2 & a, const Vec2 & b, std::shared_ptr<Entity> e)
+bool Physics::EntityIntersect(const Vec2 & a, const Vec2 & b, Entity * e)
 {
-	auto position	= e->getComponent<CTransform>()->pos;
-	auto halfSize	= e->getComponent<CBoundingBox>()->halfSize;
-	std::vector<Vec2> points;
+	return BoxIntersect(a, b, e->getComponent<CTransform>()->pos(), e->getComponent<CBoundingBox>()->halfSize);
+}
 
-	points.push_back(Vec2(position.x - halfSize.x, position.y + halfSize.y));
-	points.push_back(position + halfSize);
-	points.push_back(position - halfSize);
-	points.push_back(Vec2(position.x + halfSize.x, position.y - halfSize.y));
+bool Physics::BoxIntersect(const Vec2 & a, const Vec2 & b, const Vec2 & position, const Vec2 & halfSize)
+{
+	std::array<Vec2, 4> points =
+	{
+		Vec2(position.x - halfSize.x, position.y + halfSize.y),
+		position + halfSize,
+		position - halfSize,
+		Vec2(position.x + halfSize.x, position.y - halfSize.y)
+	};
 
 	for (int i = 0; i < 4; i++) {
 		if (LineIntersect(a, b, points[i], points[(i + 1) % 4]).result) {
@@ -66,3 +58,92 @@ bool Physics::EntityIntersect(const Vec2 & a, const Vec2 & b, std::shared_ptr<En
 
     return false;
 }
+
+template <typename T>
+TVec2<T> Physics::Overlap(const TVec2<T> & aPos, const TVec2<T> & aHalfSize, const TVec2<T> & bPos, const TVec2<T> & bHalfSize)
+{
+	return aHalfSize + bHalfSize - (aPos - bPos).abs();
+}
+
+template <typename T>
+TIntersect<T> Physics::LineIntersect(const TVec2<T> & a, const TVec2<T> & b, const TVec2<T> & c, const TVec2<T> & d)
+{
+	TVec2<T> r		= b - a;
+	TVec2<T> s		= d - c;
+	TVec2<T> cma	= c - a;
+	T rxs			= r.cross(s);
+
+	// parallel: float used to get inf or nan here and fail the range test, fixed point must not divide
+	if (rxs == T(0)) {
+		return { false, TVec2<T>() };
+	}
+
+	T t		= cma.cross(s) / rxs;
+	T u		= cma.cross(r) / rxs;
+
+	if (t >= T(0) && t <= T(1) && u >= T(0) && u <= T(1)) {
+		return { true, TVec2<T>(a.x + t * r.x, a.y + t * r.y) };
+	}
+	else {
+		return { false, TVec2<T>() };
+	}
+}
+
+template <typename T>
+TSweep<T> Physics::SweepAABB(const TVec2<T> & aPos, const TVec2<T> & aHalfSize, const TVec2<T> & delta, const TVec2<T> & bPos, const TVec2<T> & bHalfSize)
+{
+	// the largest values stand in for infinity, which fixed point does not have
+	const T lowest	= std::numeric_limits<T>::lowest();
+	const T highest	= std::numeric_limits<T>::max();
+	TSweep<T> none	= { false, T(1), TVec2<T>() };
+	TVec2<T> sum	= aHalfSize + bHalfSize;
+
+	// Slab test of a's center against b grown by a's half size: find when each axis starts and stops overlapping
+	T entryX, exitX, entryY, exitY;
+	if (delta.x > T(0)) {
+		entryX	= (bPos.x - sum.x - aPos.x) / delta.x;
+		exitX	= (bPos.x + sum.x - aPos.x) / delta.x;
+	}
+	else if (delta.x < T(0)) {
+		entryX	= (bPos.x + sum.x - aPos.x) / delta.x;
+		exitX	= (bPos.x - sum.x - aPos.x) / delta.x;
+	}
+	else {
+		// not moving on this axis: it has to overlap for the whole step
+		if (Abs(aPos.x - bPos.x) >= sum.x) { return none; }
+		entryX	= lowest;
+		exitX	= highest;
+	}
+
+	if (delta.y > T(0)) {
+		entryY	= (bPos.y - sum.y - aPos.y) / delta.y;
+		exitY	= (bPos.y + sum.y - aPos.y) / delta.y;
+	}
+	else if (delta.y < T(0)) {
+		entryY	= (bPos.y + sum.y - aPos.y) / delta.y;
+		exitY	= (bPos.y - sum.y - aPos.y) / delta.y;
+	}
+	else {
+		if (Abs(aPos.y - bPos.y) >= sum.y) { return none; }
+		entryY	= lowest;
+		exitY	= highest;
+	}
+
+	T entry	= std::max(entryX, entryY);
+	T exit	= std::min(exitX, exitY);
+
+	if (entry >= exit || entry < T(0) || entry > T(1)) { return none; }
+
+	// the axis that started overlapping last is the one that was hit
+	if (entryX > entryY) {
+		return { true, entry, TVec2<T>(delta.x > T(0) ? T(-1) : T(1), T(0)) };
+	}
+	return { true, entry, TVec2<T>(T(0), delta.y > T(0) ? T(-1) : T(1)) };
+}
+
+template Vec2 Physics::Overlap(const Vec2 &, const Vec2 &, const Vec2 &, const Vec2 &);
+template FixedVec2 Physics::Overlap(const FixedVec2 &, const FixedVec2 &, const FixedVec2 &, const FixedVec2 &);
+template Intersect Physics::LineIntersect(const Vec2 &, const Vec2 &, const Vec2 &, const Vec2 &);
+template TIntersect<Fixed> Physics::LineIntersect(const FixedVec2 &, const FixedVec2 &, const FixedVec2 &, const FixedVec2 &);
+template Sweep Physics::SweepAABB(const Vec2 &, const Vec2 &, const Vec2 &, const Vec2 &, const Vec2 &);
+template TSweep<Fixed> Physics::SweepAABB(const FixedVec2 &, const FixedVec2 &, const FixedVec2 &, const FixedVec2 &, const FixedVec2 &);
@@ -3,12 +3,69 @@
 #include "Common.h"
 #include "Entity.h"
 
-struct Intersect { bool result; Vec2 pos; };
+template <typename T> struct TIntersect { bool result; TVec2<T> pos; };
+template <typename T> struct TSweep { bool hit; T time; TVec2<T> normal; };
+typedef TIntersect<float> Intersect;
+typedef TSweep<float> Sweep;
 
 namespace Physics
 {
     Vec2 GetOverlap(std::shared_ptr<Entity> a, std::shared_ptr<Entity> b);
+    Vec2 GetOverlap(Entity * a, Entity * b);
     Vec2 GetPreviousOverlap(std::shared_ptr<Entity> a, std::shared_ptr<Entity> b);
-    Intersect LineIntersect(const Vec2 & a, const Vec2 & b, const Vec2 & c, const Vec2 & d);
+    Vec2 GetPreviousOverlap(Entity * a, Entity * b);
     bool EntityIntersect(const Vec2 & a, const Vec2 & b, std::shared_ptr<Entity> e);
+    bool EntityIntersect(const Vec2 & a, const Vec2 & b, Entity * e);
+
+    // whether segment ab crosses an edge of the box
+    bool BoxIntersect(const Vec2 & a, const Vec2 & b, const Vec2 & pos, const Vec2 & halfSize);
+
+    // The pure math below is templated on the scalar so the deterministic Fixed mode runs the
+    // same code as the game; float and Fixed are instantiated in Physics.cpp.
+
+    // overlap of two boxes on each axis, positive on both axes when they intersect
+    template <typename T>
+    TVec2<T> Overlap(const TVec2<T> & aPos, const TVec2<T> & aHalfSize, const TVec2<T> & bPos, const TVec2<T> & bHalfSize);
+
+    // intersection of segments ab and cd, parallel segments never intersect
+    template <typename T>
+    TIntersect<T> LineIntersect(const TVec2<T> & a, const TVec2<T> & b, const TVec2<T> & c, const TVec2<T> & d);
+
+    // time of impact in [0, 1] of box a moving by delta against static box b, and the contact normal
+    // boxes that already overlap, only touch, or never meet during the move report no hit
+    template <typename T>
+    TSweep<T> SweepAABB(const TVec2<T> & aPos, const TVec2<T> & aHalfSize, const TVec2<T> & delta, const TVec2<T> & bPos, const TVec2<T> & bHalfSize);
+
+    // Move a box from start by delta, stopping at the earliest blocking box and sliding the rest
+    // of the move along its face, up to three times, and return where the box ends up.
+    // forEachBlocker(from, to, visit) calls visit(pos, halfSize) for every blocking box that could
+    // touch the box on its way from center from to center to.
+    template <typename T, typename F>
+    TVec2<T> SlideMove(TVec2<T> start, const TVec2<T> & halfSize, TVec2<T> delta, F && forEachBlocker)
+    {
+        const T skin = T(0.01f);
+
+        for (int slide = 0; slide < 3 && (delta.x != T(0) || delta.y != T(0)); slide++)
+        {
+            TSweep<T> first = { false, T(1), TVec2<T>() };
+            forEachBlocker(start, start + delta, [&](const TVec2<T> & pos, const TVec2<T> & size)
+            {
+                auto sweep = SweepAABB(start, halfSize, delta, pos, size);
+                if (sweep.hit && (!first.hit || sweep.time < first.time)) { first = sweep; }
+            });
+
+            if (!first.hit)
+            {
+                start += delta;
+                break;
+            }
+
+            // stop just short of the contact and keep only the motion along the face
+            start   += delta * first.time + first.normal * skin;
+            delta   = delta * (T(1) - first.time);
+            if (first.normal.x != T(0)) { delta.x = T(0); } else { delta.y = T(0); }
+        }
+
+        return start;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "RenderQueue.h"
+#include <cassert>
+#include <algorithm>
+#include <math.h>
+
+uint64_t RenderQueue::MakeKey(unsigned layer, unsigned texture, uint64_t depth)
+{
+    assert(layer < (1u << LayerBits) && texture < (1u << TextureBits));
+    return ((uint64_t)layer << (TextureBits + DepthBits))
+         | ((uint64_t)texture << DepthBits)
+         | (depth & ((1ull << DepthBits) - 1));
+}
+
+// Fibonacci hashing spreads neighbouring addresses, whose low bits are mostly alignment
+static size_t Hash(const sf::Texture * texture)
+{
+    return (size_t)(((uint64_t)reinterpret_cast<uintptr_t>(texture) * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+void RenderQueue::growSlots(size_t textures)
+{
+    if (m_slots.size() >= textures * 2) { return; }
+
+    size_t size = m_slots.empty() ? 64 : m_slots.size();
+    while (size < textures * 2) { size *= 2; }
+
+    m_slots.assign(size, Slot { nullptr, 0 });
+    for (uint32_t i = 0; i < m_textures.size(); i++)
+    {
+        size_t slot = Hash(m_textures[i]) & (m_slots.size() - 1);
+        while (m_slots[slot].texture) { slot = (slot + 1) & (m_slots.size() - 1); }
+        m_slots[slot] = { m_textures[i], i };
+    }
+}
+
+uint32_t RenderQueue::textureIndex(const sf::Texture * texture)
+{
+    // indices are handed out in first-seen order, which follows the deterministic submit order
+    // the table stays at most half full, and is only rebuilt when the textures outgrow it
+    growSlots(m_textures.size() + 1);
+
+    size_t slot = Hash(texture) & (m_slots.size() - 1);
+    while (m_slots[slot].texture)
+    {
+        if (m_slots[slot].texture == texture) { return m_slots[slot].index; }
+        slot = (slot + 1) & (m_slots.size() - 1);
+    }
+
+    uint32_t index = (uint32_t)m_textures.size();
+    m_slots[slot] = { texture, index };
+    m_textures.push_back(texture);
+    return index;
+}
+
+void RenderQueue::clear()
+{
+    m_items.clear();
+    m_quads.clear();
+    m_textures.clear();
+    std::fill(m_slots.begin(), m_slots.end(), Slot { nullptr, 0 });
+}
+
+void RenderQueue::reserve(size_t sprites, size_t textures)
+{
+    m_items.reserve(sprites);
+    m_quads.reserve(sprites * 4);
+    m_textures.reserve(textures);
+    growSlots(textures);
+}
+
+bool RenderQueue::empty() const
+{
+    return m_items.empty();
+}
+
+void RenderQueue::submit(unsigned layer, uint64_t depth, const sf::Sprite & sprite)
+{
+    // textures past the last id share the overflow id, and flush tells them apart by index
+    uint32_t texture = textureIndex(sprite.getTexture());
+    unsigned id      = texture < OverflowId ? texture : OverflowId;
+    m_items.push_back({ MakeKey(layer, id, depth), (uint32_t)m_quads.size(), texture });
+
+    // same quad the sprite would build itself, transformed on the cpu
+    auto & transform    = sprite.getTransform();
+    auto   rect         = sprite.getTextureRect();
+    auto   color        = sprite.getColor();
+    float  width        = (float)abs(rect.width);
+    float  height       = (float)abs(rect.height);
+    float  left         = (float)rect.left;
+    float  top          = (float)rect.top;
+    float  right        = left + rect.width;
+    float  bottom       = top + rect.height;
+
+    m_quads.push_back(sf::Vertex(transform.transformPoint(0, 0),          color, sf::Vector2f(left, top)));
+    m_quads.push_back(sf::Vertex(transform.transformPoint(width, 0),      color, sf::Vector2f(right, top)));
+    m_quads.push_back(sf::Vertex(transform.transformPoint(width, height), color, sf::Vector2f(right, bottom)));
+    m_quads.push_back(sf::Vertex(transform.transformPoint(0, height),     color, sf::Vector2f(left, bottom)));
+}
+
+void RenderQueue::radixSort()
+{
+    // least significant byte first, each pass is a stable counting sort
+    m_scratch.resize(m_items.size());
+    for (unsigned shift = 0; shift < 64; shift += 8)
+    {
+        size_t count[256] = { 0 };
+        for (auto & item : m_items)
+        {
+            count[(item.key >> shift) & 0xFF]++;
+        }
+
+        // every key shares this byte, the pass would not move anything
+        if (count[(m_items[0].key >> shift) & 0xFF] == m_items.size()) { continue; }
+
+        size_t offset = 0;
+        for (size_t b = 0; b < 256; b++)
+        {
+            size_t c = count[b];
+            count[b] = offset;
+            offset  += c;
+        }
+
+        for (auto & item : m_items)
+        {
+            m_scratch[count[(item.key >> shift) & 0xFF]++] = item;
+        }
+        m_items.swap(m_scratch);
+    }
+}
+
+void RenderQueue::flush(sf::RenderTarget & target)
+{
+    m_stats = RenderStats();
+    m_stats.sprites = m_items.size();
+    if (m_items.empty()) { return; }
+
+    sf::Clock clock;
+    radixSort();
+    m_stats.sortMicros = clock.getElapsedTime().asMicroseconds();
+
+    auto draw = [&](const sf::Texture * texture)
+    {
+        if (m_vertices.empty()) { return; }
+        target.draw(&m_vertices[0], m_vertices.size(), sf::Quads, sf::RenderStates(texture));
+        m_vertices.clear();
+        m_stats.batches++;
+    };
+
+    uint32_t current = m_items[0].texture;
+    for (auto & item : m_items)
+    {
+        if (item.texture != current)
+        {
+            draw(m_textures[current]);
+            current = item.texture;
+        }
+        m_vertices.insert(m_vertices.end(), m_quads.begin() + item.quad, m_quads.begin() + item.quad + 4);
+    }
+    draw(m_textures[current]);
+}
+
+const RenderStats & RenderQueue::stats() const
+{
+    return m_stats;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Common.h"
+#include <cstdint>
+
+struct RenderStats
+{
+    size_t      sprites     = 0;    // sprites submitted during the last frame
+    size_t      batches     = 0;    // draw calls issued for them, one per run of the same texture
+    long long   sortMicros  = 0;    // time spent sorting the queue
+};
+
+// Per-frame sprite queue.
+// Each sprite is submitted with a 64-bit key packing its layer, texture and depth,
+// so one radix sort gives a deterministic draw order that also groups sprites by
+// texture within a layer. Flushing then turns every run of the same texture into
+// a single vertex array draw.
+// Submitting copies the sprite's transformed quad, so a filled queue no longer
+// refers to any entity and can be flushed on another thread.
+// Texture ids only live until the next clear; past the last id every further texture
+// shares the overflow id, and those sprites still draw right, just in smaller batches.
+class RenderQueue
+{
+    struct Item
+    {
+        uint64_t    key;
+        uint32_t    quad;       // index of the sprite's first vertex in m_quads
+        uint32_t    texture;    // index of the sprite's texture in m_textures
+    };
+
+    // open addressing table from texture to its index in m_textures, cleared without freeing
+    struct Slot
+    {
+        const sf::Texture * texture;
+        uint32_t            index;
+    };
+
+    std::vector<Item>       m_items;
+    std::vector<Item>       m_scratch;
+    std::vector<sf::Vertex> m_quads;
+    std::vector<sf::Vertex> m_vertices;
+    std::vector<const sf::Texture *> m_textures;    // in first-submitted order since the last clear
+    std::vector<Slot>       m_slots;
+    RenderStats             m_stats;
+
+    void     growSlots(size_t textures);
+    uint32_t textureIndex(const sf::Texture * texture);
+    void     radixSort();
+
+public:
+
+    static const unsigned LayerBits     = 8;
+    static const unsigned TextureBits   = 16;
+    static const unsigned DepthBits     = 64 - LayerBits - TextureBits;
+    static const unsigned OverflowId    = (1u << TextureBits) - 1;
+
+    static uint64_t MakeKey(unsigned layer, unsigned texture, uint64_t depth);
+
+    void clear();
+    bool empty() const;
+
+    // make room for this many sprites and textures, so filling the queue up to them never allocates
+    void reserve(size_t sprites, size_t textures);
+
+    // lower layers draw first, depth orders sprites of the same layer and texture
+    void submit(unsigned layer, uint64_t depth, const sf::Sprite & sprite);
+
+    // sort the queue and draw it
+    void flush(sf::RenderTarget & target);
+
+    const RenderStats & stats() const;
+};
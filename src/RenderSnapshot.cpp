@@ -0,0 +1,47 @@
+#include "RenderSnapshot.h"
+
+void RenderSnapshot::clear()
+{
+    sprites.clear();
+    particles.clear();
+    particleBatches.clear();
+    fog.clear();
+    lines.clear();
+    quads.clear();
+    minimap.clear();
+}
+
+void RenderSnapshot::draw(sf::RenderTarget & target)
+{
+    target.setView(view);
+    target.clear(clearColor);
+    sprites.flush(target);
+
+    for (auto & batch : particleBatches)
+    {
+        target.draw(&particles[batch.begin], batch.count, sf::Quads, sf::RenderStates(batch.texture));
+    }
+
+    if (!fog.empty()) { target.draw(&fog[0], fog.size(), sf::Quads); }
+    if (!quads.empty()) { target.draw(&quads[0], quads.size(), sf::Quads); }
+    if (!lines.empty()) { target.draw(&lines[0], lines.size(), sf::Lines); }
+}
+
+RenderSnapshot & SnapshotBuffer::back()
+{
+    return m_snapshots[m_back];
+}
+
+void SnapshotBuffer::publish()
+{
+    m_back = m_shared.exchange(m_back | Fresh, std::memory_order_acq_rel) & Index;
+}
+
+RenderSnapshot & SnapshotBuffer::front()
+{
+    if (m_shared.load(std::memory_order_relaxed) & Fresh)
+    {
+        m_front = m_shared.exchange(m_front, std::memory_order_acq_rel) & Index;
+    }
+    return m_snapshots[m_front];
+}
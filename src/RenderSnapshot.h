@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Common.h"
+#include "RenderQueue.h"
+#include "Minimap.h"
+#include "ParticleSystem.h"
+#include <atomic>
+
+// Everything needed to draw one frame, copied out of the simulation at the end of a tick.
+// Nothing in it points back at entities, so the render thread can draw it while the
+// simulation is already running the next tick.
+struct RenderSnapshot
+{
+    sf::View                view;
+    sf::Color               clearColor;
+    RenderQueue             sprites;
+    std::vector<sf::Vertex> particles;  // particle quads over the sprites, one batch per texture
+    std::vector<ParticleBatch> particleBatches;
+    std::vector<sf::Vertex> fog;        // quads darkening what the player cannot see, over the particles
+    std::vector<sf::Vertex> lines;      // untextured debug lines, drawn over the sprites
+    std::vector<sf::Vertex> quads;      // untextured debug markers
+    MinimapFrame            minimap;
+
+    void clear();
+    void draw(sf::RenderTarget & target);
+};
+
+// Hands snapshots from the simulation thread to the render thread without locking.
+// The simulation fills back() while the renderer draws front(); publishing swaps the
+// back buffer with a third shared slot, and the renderer takes that slot only when it
+// holds a newer frame. Neither side ever waits: a slow renderer skips frames and a
+// slow simulation has its last frame drawn again.
+class SnapshotBuffer
+{
+    static const int Index = 3;     // low bits of m_shared, the slot index
+    static const int Fresh = 4;     // set while the shared slot holds an undrawn snapshot
+
+    RenderSnapshot      m_snapshots[3];
+    int                 m_back      = 0;    // owned by the simulation thread
+    int                 m_front     = 1;    // owned by the render thread
+    std::atomic<int>    m_shared    { 2 };
+
+public:
+
+    // simulation side
+    RenderSnapshot & back();
+    void publish();
+
+    // render side, the most recently published snapshot
+    RenderSnapshot & front();
+};
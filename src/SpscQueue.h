@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+// Fixed-size lock-free queue for exactly one producer thread and one consumer thread.
+// The producer only writes m_tail and the consumer only writes m_head, so neither
+// side ever waits on the other; a full queue simply rejects the push.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    std::array<T, Capacity>         m_items;
+    alignas(64) std::atomic<size_t> m_head { 0 };   // next slot to read, written by the consumer
+    alignas(64) std::atomic<size_t> m_tail { 0 };   // next slot to write, written by the producer
+
+public:
+
+    // producer side, returns false if the queue is full
+    bool push(const T & item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity) { return false; }
+
+        m_items[tail & (Capacity - 1)] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, returns false if the queue is empty
+    bool pop(T & item)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) { return false; }
+
+        item = m_items[head & (Capacity - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+};
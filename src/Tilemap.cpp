@@ -0,0 +1,292 @@
+#include "Tilemap.h"
+#include "Physics.h"
+#include <math.h>
+#include <assert.h>
+
+Tilemap::TileId Tilemap::Chunk::get(int i) const
+{
+    if (!tiles.empty()) { return tiles[i]; }
+    if (runs.empty())   { return 0; }
+    return std::upper_bound(runs.begin(), runs.end(), i, [](int cell, const Run & r) { return cell < r.end; })->id;
+}
+
+void Tilemap::Chunk::expand()
+{
+    if (!tiles.empty()) { return; }
+
+    tiles.assign(ChunkCells, 0);
+    int i = 0;
+    for (auto & run : runs)
+    {
+        std::fill(tiles.begin() + i, tiles.begin() + run.end, run.id);
+        i = run.end;
+    }
+    runs.clear();
+    runs.shrink_to_fit();
+}
+
+void Tilemap::Chunk::compress()
+{
+    if (tiles.empty()) { return; }
+
+    size_t count = 1;
+    for (int i = 1; i < ChunkCells; i++) { count += tiles[i] != tiles[i - 1]; }
+
+    // a blank chunk keeps nothing, and runs only replace the ids when they are smaller
+    if (count == 1 && tiles[0] == 0)
+    {
+        tiles.clear();
+        tiles.shrink_to_fit();
+        return;
+    }
+    if (count * sizeof(Run) >= ChunkCells * sizeof(TileId)) { return; }
+
+    runs.reserve(count);
+    for (int i = 1; i <= ChunkCells; i++)
+    {
+        if (i == ChunkCells || tiles[i] != tiles[i - 1]) { runs.push_back({ tiles[i - 1], (uint16_t)i }); }
+    }
+    tiles.clear();
+    tiles.shrink_to_fit();
+}
+
+size_t Tilemap::Chunk::bytes() const
+{
+    return sizeof(Chunk) + tiles.capacity() * sizeof(TileId) + runs.capacity() * sizeof(Run);
+}
+
+double TilemapStats::bytesPerTile() const
+{
+    return tiles ? (double)bytes / tiles : 0.0;
+}
+
+Tilemap::Tilemap()
+{
+    clear();
+}
+
+int Tilemap::FloorDiv(int a, int b)
+{
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+void Tilemap::clear()
+{
+    m_cellSize  = Vec2(64, 64);
+    m_reach     = Vec2(0, 0);
+    m_chunkMin  = GridCell();
+    m_chunksX   = m_chunksY = 0;
+    m_tiles     = 0;
+    m_chunks.clear();
+    m_typeIds.clear();
+    m_types.assign(1, TileType());
+}
+
+Tilemap::TileId Tilemap::findType(const std::string & animation, bool blockMove, bool blockVision, uint32_t layer, uint32_t mask) const
+{
+    auto found = m_typeIds.find(std::make_tuple(animation, blockMove, blockVision, layer, mask));
+    return found != m_typeIds.end() ? found->second : 0;
+}
+
+Tilemap::TileId Tilemap::addType(const Animation & animation, bool blockMove, bool blockVision, uint32_t layer, uint32_t mask)
+{
+    if (m_types.size() > 0xffff)
+    {
+        std::cerr << "Too many tile types, " << animation.getName() << " is not added" << std::endl;
+        assert(false);
+        return 0;
+    }
+
+    // the first type sets the cell size, larger tiles reach into the cells after their own
+    if (m_types.size() == 1) { m_cellSize = animation.getSize(); }
+    m_reach.x = std::max(m_reach.x, animation.getSize().x - m_cellSize.x);
+    m_reach.y = std::max(m_reach.y, animation.getSize().y - m_cellSize.y);
+
+    TileType type;
+    type.animation      = animation;
+    type.halfSize       = animation.getSize() / 2;
+    type.blockMove      = blockMove;
+    type.blockVision    = blockVision;
+    type.layer          = layer;
+    type.mask           = mask;
+    m_types.push_back(type);
+
+    TileId id = (TileId)(m_types.size() - 1);
+    m_typeIds[std::make_tuple(animation.getName(), blockMove, blockVision, layer, mask)] = id;
+    return id;
+}
+
+void Tilemap::grow(const GridCell & chunk)
+{
+    GridCell min = chunk, max = chunk;
+    if (!m_chunks.empty())
+    {
+        min = GridCell(std::min(chunk.x, m_chunkMin.x), std::min(chunk.y, m_chunkMin.y));
+        max = GridCell(std::max(chunk.x, m_chunkMin.x + m_chunksX - 1), std::max(chunk.y, m_chunkMin.y + m_chunksY - 1));
+    }
+
+    int width = max.x - min.x + 1, height = max.y - min.y + 1;
+    std::vector<Chunk> chunks(width * height);
+    for (int y = 0; y < m_chunksY; y++)
+    {
+        for (int x = 0; x < m_chunksX; x++)
+        {
+            chunks[(y + m_chunkMin.y - min.y) * width + (x + m_chunkMin.x - min.x)] = std::move(m_chunks[y * m_chunksX + x]);
+        }
+    }
+
+    m_chunks    = std::move(chunks);
+    m_chunkMin  = min;
+    m_chunksX   = width;
+    m_chunksY   = height;
+}
+
+int Tilemap::chunkIndex(const GridCell & cell, int & i) const
+{
+    GridCell chunk(FloorDiv(cell.x, ChunkSize), FloorDiv(cell.y, ChunkSize));
+    int x = chunk.x - m_chunkMin.x, y = chunk.y - m_chunkMin.y;
+    if (m_chunks.empty() || x < 0 || y < 0 || x >= m_chunksX || y >= m_chunksY) { return -1; }
+
+    i = (cell.y - chunk.y * ChunkSize) * ChunkSize + (cell.x - chunk.x * ChunkSize);
+    return y * m_chunksX + x;
+}
+
+void Tilemap::set(const GridCell & cell, TileId id)
+{
+    int i = 0;
+    int index = chunkIndex(cell, i);
+    if (index < 0)
+    {
+        if (id == 0) { return; }
+        grow(GridCell(FloorDiv(cell.x, ChunkSize), FloorDiv(cell.y, ChunkSize)));
+        index = chunkIndex(cell, i);
+    }
+
+    auto & chunk = m_chunks[index];
+    TileId old = chunk.get(i);
+    if (old == id) { return; }
+
+    chunk.expand();
+    chunk.tiles[i] = id;
+    m_tiles = m_tiles + (id != 0) - (old != 0);
+}
+
+Tilemap::TileId Tilemap::get(const GridCell & cell) const
+{
+    int i = 0;
+    int index = chunkIndex(cell, i);
+    return index < 0 ? 0 : m_chunks[index].get(i);
+}
+
+void Tilemap::clear(const GridCell & min, const GridCell & max)
+{
+    for (int y = min.y; y <= max.y; y++)
+    {
+        for (int x = min.x; x <= max.x; x++)
+        {
+            set(GridCell(x, y), 0);
+        }
+    }
+}
+
+void Tilemap::compress()
+{
+    for (auto & chunk : m_chunks)
+    {
+        chunk.compress();
+    }
+}
+
+void Tilemap::update()
+{
+    for (size_t id = 1; id < m_types.size(); id++)
+    {
+        m_types[id].animation.update();
+    }
+}
+
+bool Tilemap::reloadAnimation(const std::string & name, const Animation & animation)
+{
+    bool reloaded = false;
+    for (size_t id = 1; id < m_types.size(); id++)
+    {
+        if (m_types[id].animation.getName() == name)
+        {
+            m_types[id].animation = animation;
+            reloaded = true;
+        }
+    }
+    return reloaded;
+}
+
+const Vec2 & Tilemap::cellSize() const
+{
+    return m_cellSize;
+}
+
+GridCell Tilemap::cellOf(const Vec2 & pos) const
+{
+    return GridCell((int)floor(pos.x / m_cellSize.x), (int)floor(pos.y / m_cellSize.y));
+}
+
+const TileType & Tilemap::type(TileId id) const
+{
+    return m_types[id];
+}
+
+size_t Tilemap::typeCount() const
+{
+    return m_types.size();
+}
+
+Vec2 Tilemap::tileCenter(const GridCell & cell, const TileType & type) const
+{
+    return Vec2(cell.x * m_cellSize.x, cell.y * m_cellSize.y) + type.halfSize;
+}
+
+bool Tilemap::blocksVision(const Vec2 & a, const Vec2 & b) const
+{
+    // Walk the cells the segment passes through and test the tiles around the piece of the
+    // segment inside each one, which also finds tiles it only grazes along a cell edge
+    Vec2 d      = b - a;
+    GridCell cell = cellOf(a), end = cellOf(b);
+    int stepX   = d.x > 0 ? 1 : -1;
+    int stepY   = d.y > 0 ? 1 : -1;
+    float nextX = d.x != 0 ? ((cell.x + (stepX > 0)) * m_cellSize.x - a.x) / d.x : INFINITY;
+    float nextY = d.y != 0 ? ((cell.y + (stepY > 0)) * m_cellSize.y - a.y) / d.y : INFINITY;
+    float cellX = d.x != 0 ? m_cellSize.x / fabsf(d.x) : INFINITY;
+    float cellY = d.y != 0 ? m_cellSize.y / fabsf(d.y) : INFINITY;
+
+    bool blocked = false;
+    float enter = 0;
+    for (int steps = abs(end.x - cell.x) + abs(end.y - cell.y); steps >= 0 && !blocked; steps--)
+    {
+        float exit = std::min(1.0f, std::min(nextX, nextY));
+        Vec2 p0 = a + d * enter, p1 = a + d * exit;
+        AABB piece(Vec2(std::min(p0.x, p1.x), std::min(p0.y, p1.y)), Vec2(std::max(p0.x, p1.x), std::max(p0.y, p1.y)));
+        forEach(piece, [&](const GridCell & tile, const TileType & type)
+        {
+            blocked = blocked || (type.blockVision && Physics::BoxIntersect(a, b, tileCenter(tile, type), type.halfSize));
+        });
+        enter = exit;
+
+        if (nextX < nextY)  { cell.x += stepX; nextX += cellX; }
+        else                { cell.y += stepY; nextY += cellY; }
+    }
+    return blocked;
+}
+
+TilemapStats Tilemap::stats() const
+{
+    TilemapStats stats;
+    stats.tiles     = m_tiles;
+    stats.chunks    = m_chunks.size();
+    stats.bytes     = m_chunks.capacity() * sizeof(Chunk);
+    for (auto & chunk : m_chunks)
+    {
+        stats.denseChunks   += !chunk.tiles.empty();
+        stats.runChunks     += !chunk.runs.empty();
+        stats.bytes         += chunk.bytes() - sizeof(Chunk);
+    }
+    return stats;
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "Common.h"
+#include "Animation.h"
+#include "AABBTree.h"
+#include "NavGrid.h"
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <math.h>
+
+// one kind of tile: how it looks and what it blocks, shared by every cell holding its id
+struct TileType
+{
+    Animation   animation;              // frame layout, and the handle keeping its texture resident
+    Vec2        halfSize;
+    bool        blockMove   = false;
+    bool        blockVision = false;
+    uint32_t    layer       = 0;        // CollisionLayer bits
+    uint32_t    mask        = 0;
+};
+
+struct TilemapStats
+{
+    size_t  tiles       = 0;    // cells holding a tile
+    size_t  chunks      = 0;    // chunks inside the map's bounds, empty ones included
+    size_t  denseChunks = 0;    // chunks storing one id per cell
+    size_t  runChunks   = 0;    // chunks storing runs of equal ids
+    size_t  bytes       = 0;    // chunk storage including the chunk headers
+
+    double bytesPerTile() const;
+};
+
+// The level's static tiles, stored as ids instead of entities.
+// The world is cut into ChunkSize x ChunkSize chunks of uint16 tile ids indexing a table of
+// tile types, so a cell costs two bytes instead of an entity with its components and copied
+// animation. compress() turns chunks that are mostly runs of one id (walls, floors, empty
+// space) into run lists, and an all-empty chunk holds nothing at all; writing into a
+// compressed chunk expands it again. A tile sits at the corner of its cell and reaches over
+// neighbouring cells when its animation is larger than one cell.
+class Tilemap
+{
+public:
+
+    typedef uint16_t TileId;                // 0 is no tile
+    static const int ChunkSize = 32;
+    static const int ChunkCells = ChunkSize * ChunkSize;
+
+private:
+
+    struct Run
+    {
+        TileId      id;
+        uint16_t    end;                    // one past the run's last cell, row-major in the chunk
+    };
+
+    struct Chunk
+    {
+        std::vector<TileId> tiles;          // ChunkCells ids when dense
+        std::vector<Run>    runs;           // the whole chunk as runs when compressed, both empty when blank
+
+        TileId  get(int i) const;
+        void    expand();
+        void    compress();
+        size_t  bytes() const;
+
+        // call fn(x, id) for every tile in columns [x0, x1] of one row
+        template <typename F>
+        void forEachInRow(int row, int x0, int x1, F && fn) const
+        {
+            int i = row * ChunkSize + x0, end = row * ChunkSize + x1 + 1;
+            if (!tiles.empty())
+            {
+                for (; i < end; i++)
+                {
+                    if (tiles[i]) { fn(i - row * ChunkSize, tiles[i]); }
+                }
+                return;
+            }
+
+            auto run = std::upper_bound(runs.begin(), runs.end(), i, [](int cell, const Run & r) { return cell < r.end; });
+            for (; run != runs.end() && i < end; ++run)
+            {
+                int stop = std::min<int>(run->end, end);
+                if (!run->id) { i = stop; continue; }
+                for (; i < stop; i++) { fn(i - row * ChunkSize, run->id); }
+            }
+        }
+    };
+
+    typedef std::tuple<std::string, bool, bool, uint32_t, uint32_t> TypeKey;
+
+    Vec2                        m_cellSize      = { 64, 64 };
+    Vec2                        m_reach;        // how far the largest tile extends past its cell
+    GridCell                    m_chunkMin;     // chunk at index 0 of m_chunks
+    int                         m_chunksX       = 0;
+    int                         m_chunksY       = 0;
+    std::vector<Chunk>          m_chunks;
+    std::vector<TileType>       m_types;        // indexed by TileId, 0 is a placeholder
+    std::map<TypeKey, TileId>   m_typeIds;
+    size_t                      m_tiles         = 0;
+
+    static int FloorDiv(int a, int b);
+    int     chunkIndex(const GridCell & cell, int & i) const;     // -1 outside the map
+    void    grow(const GridCell & chunk);
+
+public:
+
+    Tilemap();
+
+    // forget every tile and type, the cell size comes from the first type added
+    void clear();
+
+    // id of the type playing the named animation with these flags, 0 when there is none yet
+    TileId  findType(const std::string & animation, bool blockMove, bool blockVision, uint32_t layer, uint32_t mask) const;
+
+    // add a type to the table, the animation should hold a texture handle
+    TileId  addType(const Animation & animation, bool blockMove, bool blockVision, uint32_t layer, uint32_t mask);
+
+    void    set(const GridCell & cell, TileId id);
+    TileId  get(const GridCell & cell) const;
+
+    // remove every tile in the cells from min to max inclusive
+    void    clear(const GridCell & min, const GridCell & max);
+
+    // turn chunks into runs where that is smaller, call after a batch of set() calls
+    void    compress();
+
+    // advance the animation of every tile type, all tiles of a type share its frame
+    void    update();
+
+    // give the types playing the named animation the new copy, true if any did
+    bool    reloadAnimation(const std::string & name, const Animation & animation);
+
+    const Vec2 &        cellSize() const;
+    GridCell            cellOf(const Vec2 & pos) const;
+    const TileType &    type(TileId id) const;
+    size_t              typeCount() const;
+    Vec2                tileCenter(const GridCell & cell, const TileType & type) const;
+
+    // true when the segment crosses an edge of a vision-blocking tile
+    bool    blocksVision(const Vec2 & a, const Vec2 & b) const;
+
+    TilemapStats stats() const;
+
+    // call fn(cell, type) for every tile anchored in the cells from min to max inclusive
+    template <typename F>
+    void forEach(const GridCell & min, const GridCell & max, F && fn) const
+    {
+        if (m_chunks.empty()) { return; }
+
+        int x0 = std::max(min.x, m_chunkMin.x * ChunkSize), x1 = std::min(max.x, (m_chunkMin.x + m_chunksX) * ChunkSize - 1);
+        int y0 = std::max(min.y, m_chunkMin.y * ChunkSize), y1 = std::min(max.y, (m_chunkMin.y + m_chunksY) * ChunkSize - 1);
+        if (x0 > x1 || y0 > y1) { return; }
+
+        for (int cy = FloorDiv(y0, ChunkSize); cy <= FloorDiv(y1, ChunkSize); cy++)
+        {
+            for (int cx = FloorDiv(x0, ChunkSize); cx <= FloorDiv(x1, ChunkSize); cx++)
+            {
+                auto & chunk = m_chunks[(cy - m_chunkMin.y) * m_chunksX + (cx - m_chunkMin.x)];
+                if (chunk.tiles.empty() && chunk.runs.empty()) { continue; }
+
+                int left = cx * ChunkSize, top = cy * ChunkSize;
+                int lx0 = std::max(x0 - left, 0), lx1 = std::min(x1 - left, ChunkSize - 1);
+                int ly0 = std::max(y0 - top, 0),  ly1 = std::min(y1 - top, ChunkSize - 1);
+                for (int y = ly0; y <= ly1; y++)
+                {
+                    chunk.forEachInRow(y, lx0, lx1, [&](int x, TileId id)
+                    {
+                        fn(GridCell(left + x, top + y), m_types[id]);
+                    });
+                }
+            }
+        }
+    }
+
+    // call fn(cell, type) for every tile whose box could touch the area, including the ones
+    // whose edge only touches it, since a sweep ending exactly on a face still stops there
+    template <typename F>
+    void forEach(const AABB & area, F && fn) const
+    {
+        GridCell min((int)ceil((area.min.x - m_reach.x) / m_cellSize.x) - 1, (int)ceil((area.min.y - m_reach.y) / m_cellSize.y) - 1);
+        forEach(min, cellOf(area.max), fn);
+    }
+
+    // call fn(cell, type) for every tile of the map
+    template <typename F>
+    void forEach(F && fn) const
+    {
+        forEach(GridCell(m_chunkMin.x * ChunkSize, m_chunkMin.y * ChunkSize),
+                GridCell((m_chunkMin.x + m_chunksX) * ChunkSize - 1, (m_chunkMin.y + m_chunksY) * ChunkSize - 1), fn);
+    }
+};
@@ -0,0 +1,118 @@
+#include "TransformPool.h"
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+const size_t TransformPool::ChunkSize;
+
+TransformPool::TransformPool()
+    : m_arena(16 * sizeof(Chunk))
+{
+
+}
+
+uint32_t TransformPool::allocate()
+{
+    uint32_t slot;
+    if (!m_free.empty())
+    {
+        slot = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        if (m_size == m_chunks.size() * ChunkSize)
+        {
+            m_chunks.push_back(new (m_arena.allocate(sizeof(Chunk), 64)) Chunk);
+            if (m_fixed) { m_fixedChunks.push_back(new (m_arena.allocate(sizeof(FixedChunk), 64)) FixedChunk); }
+        }
+        slot = (uint32_t)m_size++;
+    }
+
+    // zero speed keeps a fresh or released slot still while it is integrated
+    pos(slot) = prevPos(slot) = speed(slot) = Vec2(0, 0);
+    if (m_fixed) { fixedPos(slot) = fixedPrevPos(slot) = fixedSpeed(slot) = FixedVec2(); }
+    m_live++;
+    return slot;
+}
+
+void TransformPool::release(uint32_t slot)
+{
+    assert(slot < m_size && m_live > 0);
+    speed(slot) = Vec2(0, 0);
+    if (m_fixed) { fixedSpeed(slot) = FixedVec2(); }
+    m_free.push_back(slot);
+    m_live--;
+}
+
+void TransformPool::integrate()
+{
+    for (size_t c = 0; c < m_chunks.size(); c++)
+    {
+        Chunk & chunk   = *m_chunks[c];
+        size_t  count   = 2 * std::min<size_t>(ChunkSize, m_size - c * ChunkSize);
+
+        std::memcpy(chunk.prevPos, chunk.pos, count * sizeof(float));
+        if (!m_fixed)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                chunk.pos[i] += chunk.speed[i];
+            }
+            continue;
+        }
+
+        // integer adds that saturate like Fixed's, then the same conversion as Fixed::toFloat
+        // so both copies agree; generated levels reach past the +-32768 px range
+        FixedChunk & fixed = *m_fixedChunks[c];
+        std::memcpy(fixed.prevPos, fixed.pos, count * sizeof(int32_t));
+        for (size_t i = 0; i < count; i++)
+        {
+            int64_t sum     = (int64_t)fixed.pos[i] + fixed.speed[i];
+            fixed.pos[i]    = (int32_t)std::max<int64_t>(-INT32_MAX, std::min<int64_t>(INT32_MAX, sum));
+            chunk.pos[i]    = (float)fixed.pos[i] / Fixed::One;
+        }
+    }
+}
+
+void TransformPool::clear()
+{
+    if (m_live != 0)
+    {
+        std::cerr << "TransformPool cleared with " << m_live << " transforms still alive\n";
+        assert(m_live == 0);
+        return;
+    }
+
+    m_chunks.clear();
+    m_fixedChunks.clear();
+    m_free.clear();
+    m_size = 0;
+    m_arena.reset();
+}
+
+void TransformPool::setFixed(bool fixed)
+{
+    if (m_size != 0)
+    {
+        std::cerr << "TransformPool switched to " << (fixed ? "fixed" : "float") << " point while holding slots\n";
+        assert(m_size == 0);
+        return;
+    }
+    m_fixed = fixed;
+}
+
+bool TransformPool::isFixed() const
+{
+    return m_fixed;
+}
+
+size_t TransformPool::live() const
+{
+    return m_live;
+}
+
+size_t TransformPool::bytesPerSlot() const
+{
+    return 6 * sizeof(float) + (m_fixed ? 6 * sizeof(int32_t) : 0);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Common.h"
+#include "MemoryArena.h"
+#include "Fixed.h"
+#include <cstdint>
+#include <cassert>
+
+// Hot transform data (position, previous position, speed) for entities that move,
+// stored structure-of-arrays in fixed-size, cache-aligned chunks.
+// Each field is its own contiguous float array of interleaved x and y, so integrating
+// every mover is one straight pass over plain floats that the compiler can vectorize,
+// and it touches 24 bytes per entity instead of whole component objects.
+// Chunks never move, and a CTransform only keeps its pool and slot; the accessors below are
+// inline so reaching a transform's hot data is a shift, a mask and two loads.
+// A fixed-point pool (deterministic mode) also keeps the same three fields as 16.16 raw
+// integers in a second set of chunks; those are integrated and the floats follow them.
+class TransformPool
+{
+public:
+
+    static const size_t ChunkSize = 1024;
+
+    struct Chunk
+    {
+        alignas(64) float pos[2 * ChunkSize];
+        alignas(64) float prevPos[2 * ChunkSize];
+        alignas(64) float speed[2 * ChunkSize];
+    };
+
+    struct FixedChunk
+    {
+        alignas(64) int32_t pos[2 * ChunkSize];
+        alignas(64) int32_t prevPos[2 * ChunkSize];
+        alignas(64) int32_t speed[2 * ChunkSize];
+    };
+
+private:
+
+    MemoryArena             m_arena;        // chunk storage, kept across clear()
+    std::vector<Chunk *>    m_chunks;
+    std::vector<FixedChunk *> m_fixedChunks;  // parallel to m_chunks in a fixed-point pool
+    bool                    m_fixed = false;
+    std::vector<uint32_t>   m_free;
+    size_t                  m_size = 0;     // slots handed out so far, free or not
+    size_t                  m_live = 0;
+
+public:
+
+    TransformPool();
+
+    // a zeroed slot, released slots are reused first
+    uint32_t allocate();
+    void     release(uint32_t slot);
+
+    Vec2 & pos(uint32_t slot);
+    Vec2 & prevPos(uint32_t slot);
+    Vec2 & speed(uint32_t slot);
+
+    // the fixed-point fields of a slot, only in a fixed-point pool (assert)
+    FixedVec2 & fixedPos(uint32_t slot);
+    FixedVec2 & fixedPrevPos(uint32_t slot);
+    FixedVec2 & fixedSpeed(uint32_t slot);
+
+    // prevPos = pos, pos += speed for every slot, in fixed point with the floats
+    // converted from the result when the pool is fixed-point
+    void integrate();
+
+    // drop every slot, only valid once no transform refers to the pool any more
+    void clear();
+
+    // choose whether slots also hold fixed-point fields, only valid on an empty pool
+    void setFixed(bool fixed);
+    bool isFixed() const;
+
+    size_t live() const;
+    size_t bytesPerSlot() const;
+};
+
+// slots are Vec2 views over the interleaved x, y floats
+inline Vec2 & TransformPool::pos(uint32_t slot)
+{
+    return reinterpret_cast<Vec2 *>(m_chunks[slot / ChunkSize]->pos)[slot % ChunkSize];
+}
+
+inline Vec2 & TransformPool::prevPos(uint32_t slot)
+{
+    return reinterpret_cast<Vec2 *>(m_chunks[slot / ChunkSize]->prevPos)[slot % ChunkSize];
+}
+
+inline Vec2 & TransformPool::speed(uint32_t slot)
+{
+    return reinterpret_cast<Vec2 *>(m_chunks[slot / ChunkSize]->speed)[slot % ChunkSize];
+}
+
+inline FixedVec2 & TransformPool::fixedPos(uint32_t slot)
+{
+    assert(m_fixed);
+    return reinterpret_cast<FixedVec2 *>(m_fixedChunks[slot / ChunkSize]->pos)[slot % ChunkSize];
+}
+
+inline FixedVec2 & TransformPool::fixedPrevPos(uint32_t slot)
+{
+    assert(m_fixed);
+    return reinterpret_cast<FixedVec2 *>(m_fixedChunks[slot / ChunkSize]->prevPos)[slot % ChunkSize];
+}
+
+inline FixedVec2 & TransformPool::fixedSpeed(uint32_t slot)
+{
+    assert(m_fixed);
+    return reinterpret_cast<FixedVec2 *>(m_fixedChunks[slot / ChunkSize]->speed)[slot % ChunkSize];
+}
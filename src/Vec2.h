@@ -1,30 +1,115 @@
 #pragma once
 
-class Vec2
+#include <math.h>
+#include <stddef.h>
+
+// Header-only so every operation inlines into the systems without link-time optimisation.
+// Everything but the square roots is constexpr. The scalar is a template parameter so the
+// same math runs on float (Vec2) or on the deterministic Fixed type (FixedVec2, Fixed.h).
+inline float Sqrt(float value) noexcept { return sqrtf(value); }
+inline float Abs(float value) noexcept { return fabsf(value); }
+
+template <typename T>
+class TVec2
 {
 public:
 
-    float x = 0;
-    float y = 0;
-
-    Vec2();
-    Vec2(float xin, float yin);
- 
-    bool operator == (const Vec2 & rhs) const;
-    bool operator != (const Vec2 & rhs) const;
-
-    Vec2 operator + (const Vec2 & rhs) const;
-    Vec2 operator - (const Vec2 & rhs) const;
-    Vec2 operator / (const float & val) const;
-    Vec2 operator * (const float & val) const;
-    float operator * (const Vec2 & rhs) const;
-
-    void operator += (const Vec2 & rhs);
-    void operator -= (const Vec2 & rhs);
-    void operator *= (const float & val);
-    void operator /= (const float & val);
-
-    Vec2 abs() const;
-	float cross(const Vec2 & rhs) const;
-    float dist(const Vec2 & rhs) const;
-};
\ No newline at end of file
+    T x = T(0);
+    T y = T(0);
+
+    constexpr TVec2() noexcept {}
+    constexpr TVec2(T xin, T yin) noexcept : x(xin), y(yin) {}
+
+    constexpr bool operator == (const TVec2 & rhs) const noexcept { return x == rhs.x && y == rhs.y; }
+    constexpr bool operator != (const TVec2 & rhs) const noexcept { return !(*this == rhs); }
+
+    constexpr TVec2 operator + (const TVec2 & rhs) const noexcept { return TVec2(x + rhs.x, y + rhs.y); }
+    constexpr TVec2 operator - (const TVec2 & rhs) const noexcept { return TVec2(x - rhs.x, y - rhs.y); }
+    constexpr TVec2 operator / (const T & val) const noexcept { return TVec2(x / val, y / val); }
+    constexpr TVec2 operator * (const T & val) const noexcept { return TVec2(x * val, y * val); }
+    constexpr T     operator * (const TVec2 & rhs) const noexcept { return x * rhs.y - rhs.x * y; }
+
+    constexpr void operator += (const TVec2 & rhs) noexcept { x += rhs.x; y += rhs.y; }
+    constexpr void operator -= (const TVec2 & rhs) noexcept { x -= rhs.x; y -= rhs.y; }
+    constexpr void operator *= (const T & val) noexcept { x *= val; y *= val; }
+    constexpr void operator /= (const T & val) noexcept { x /= val; y /= val; }
+
+    constexpr TVec2 abs() const noexcept { return TVec2(x < T(0) ? -x : x, y < T(0) ? -y : y); }
+    constexpr T     cross(const TVec2 & rhs) const noexcept { return (x * rhs.y) - (y * rhs.x); }
+    constexpr T     dot(const TVec2 & rhs) const noexcept { return x * rhs.x + y * rhs.y; }
+
+    // squared lengths are enough for comparing against a radius, so prefer them to dist
+    constexpr T lengthSq() const noexcept { return x * x + y * y; }
+    constexpr T distSq(const TVec2 & rhs) const noexcept { return (x - rhs.x) * (x - rhs.x) + (y - rhs.y) * (y - rhs.y); }
+    T length() const noexcept { return Sqrt(lengthSq()); }
+    T dist(const TVec2 & rhs) const noexcept { return Sqrt(distSq(rhs)); }
+
+    // per component
+    constexpr TVec2 min(const TVec2 & rhs) const noexcept { return TVec2(x < rhs.x ? x : rhs.x, y < rhs.y ? y : rhs.y); }
+    constexpr TVec2 max(const TVec2 & rhs) const noexcept { return TVec2(x > rhs.x ? x : rhs.x, y > rhs.y ? y : rhs.y); }
+    constexpr TVec2 clamp(const TVec2 & lo, const TVec2 & hi) const noexcept { return max(lo).min(hi); }
+    constexpr TVec2 sign() const noexcept { return TVec2(T((x > T(0)) - (x < T(0))), T((y > T(0)) - (y < T(0)))); }
+};
+
+typedef TVec2<float> Vec2;
+
+// Batch operations over contiguous arrays of Vec2.
+// Plain indexed loops without branches or calls, which compilers vectorise at -O2 / /O2;
+// out may alias the first input.
+namespace Vec2Batch
+{
+    // out[i] = a[i] + b[i]
+    template <typename T>
+    void Add(TVec2<T> * out, const TVec2<T> * a, const TVec2<T> * b, size_t count) noexcept
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i].x = a[i].x + b[i].x;
+            out[i].y = a[i].y + b[i].y;
+        }
+    }
+
+    // out[i] = a[i] + b[i] * scale
+    template <typename T>
+    void MulAdd(TVec2<T> * out, const TVec2<T> * a, const TVec2<T> * b, T scale, size_t count) noexcept
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i].x = a[i].x + b[i].x * scale;
+            out[i].y = a[i].y + b[i].y * scale;
+        }
+    }
+
+    // out[i] = a[i] clamped to the box [lo, hi]
+    template <typename T>
+    void Clamp(TVec2<T> * out, const TVec2<T> * a, const TVec2<T> & lo, const TVec2<T> & hi, size_t count) noexcept
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = a[i].clamp(lo, hi);
+        }
+    }
+
+    // out[i] = squared distance from a[i] to b[i]
+    template <typename T>
+    void DistSq(T * out, const TVec2<T> * a, const TVec2<T> * b, size_t count) noexcept
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = a[i].distSq(b[i]);
+        }
+    }
+
+    // number of points within radius of center
+    template <typename T>
+    size_t CountWithin(const TVec2<T> * points, size_t count, const TVec2<T> & center, T radius) noexcept
+    {
+        T      radiusSq    = radius * radius;
+        size_t within      = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            within += points[i].distSq(center) <= radiusSq;
+        }
+        return within;
+    }
+}
@@ -7,9 +7,176 @@
 #include <SFML/Graphics.hpp>
 
 #include "GameEngine.h"
+#include "LevelGenerator.h"
+#include "Benchmark.h"
 
-int main()
+// usage:
+//   SFMLGame
+//   SFMLGame --generate <out.txt> <roomsX> <roomsY> <tileDensity> <patrolNPCs> <followNPCs> [seed]
+//   SFMLGame --benchmark [out.csv] [ticks] [entities ...] [--maps uniform,sparse,dense,lumpy] [--broadphase naive,tree] [--activity on,off] [--vision segment,fov]
+//   SFMLGame --benchmark-events [events]
+//   SFMLGame --benchmark-components [entities] [iterations]
+//   SFMLGame --benchmark-transforms [entities] [ticks]
+//   SFMLGame --benchmark-vec2 [points] [iterations]
+//   SFMLGame --benchmark-determinism [ticks] [levels ...]
+//   SFMLGame --benchmark-allocations [warm-up ticks] [ticks] [levels ...]
+//   SFMLGame --benchmark-behaviours [behaviours] [ticks]
+//   SFMLGame --benchmark-commands [entities per tick] [threads] [ticks]
+//   SFMLGame --benchmark-particles [particles] [ticks]
+//   SFMLGame --benchmark-batch [worlds] [ticks] [level]
+//   SFMLGame --benchmark-tilemap [width] [height]
+//   SFMLGame --benchmark-sweep [cases]
+int main(int argc, char * argv[])
 {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    if (!args.empty() && args[0] == "--generate")
+    {
+        if (args.size() < 7)
+        {
+            std::cerr << "usage: --generate <out.txt> <roomsX> <roomsY> <tileDensity> <patrolNPCs> <followNPCs> [seed]" << std::endl;
+            return 1;
+        }
+
+        LevelConfig config;
+        config.roomsX       = std::stoi(args[2]);
+        config.roomsY       = std::stoi(args[3]);
+        config.tileDensity  = std::stof(args[4]);
+        config.patrolNPCs   = std::stoul(args[5]);
+        config.followNPCs   = std::stoul(args[6]);
+        if (args.size() > 7) { config.seed = std::stoul(args[7]); }
+
+        return LevelGenerator::WriteFile(args[1], config) ? 0 : 1;
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-events")
+    {
+        return Benchmark::RunEvents(args.size() > 1 ? std::stoul(args[1]) : 10000000);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-components")
+    {
+        return Benchmark::RunComponents(args.size() > 1 ? std::stoul(args[1]) : 100000, args.size() > 2 ? std::stoul(args[2]) : 100);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-transforms")
+    {
+        return Benchmark::RunTransforms(args.size() > 1 ? std::stoul(args[1]) : 100000, args.size() > 2 ? std::stoul(args[2]) : 100);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-vec2")
+    {
+        return Benchmark::RunVec2(args.size() > 1 ? std::stoul(args[1]) : 100000, args.size() > 2 ? std::stoul(args[2]) : 100);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-behaviours")
+    {
+        return Benchmark::RunBehaviours(args.size() > 1 ? std::stoul(args[1]) : 100000, args.size() > 2 ? std::stoul(args[2]) : 100);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-commands")
+    {
+        return Benchmark::RunCommands(args.size() > 1 ? std::stoul(args[1]) : 200000,
+                                      args.size() > 2 ? std::stoul(args[2]) : std::max(std::thread::hardware_concurrency(), 2u),
+                                      args.size() > 3 ? std::stoul(args[3]) : 10);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-particles")
+    {
+        return Benchmark::RunParticles(args.size() > 1 ? std::stoul(args[1]) : 100000, args.size() > 2 ? std::stoul(args[2]) : 300);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-batch")
+    {
+        return Benchmark::RunBatch(args.size() > 3 ? args[3] : "level1.txt",
+                                   args.size() > 1 ? std::stoul(args[1]) : 4096,
+                                   args.size() > 2 ? std::stoul(args[2]) : 600);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-tilemap")
+    {
+        return Benchmark::RunTilemap(args.size() > 1 ? std::stoul(args[1]) : 1000, args.size() > 2 ? std::stoul(args[2]) : 1000);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-sweep")
+    {
+        return Benchmark::RunSweep(args.size() > 1 ? std::stoul(args[1]) : 100000);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-allocations")
+    {
+        std::vector<std::string> levels(args.begin() + std::min<size_t>(args.size(), 3), args.end());
+        if (levels.empty()) { levels = { "level1.txt", "level2.txt", "level3.txt" }; }
+        return Benchmark::RunAllocations(levels, args.size() > 1 ? std::stoul(args[1]) : 7200, args.size() > 2 ? std::stoul(args[2]) : 3600);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark-determinism")
+    {
+        std::vector<std::string> levels(args.begin() + std::min<size_t>(args.size(), 2), args.end());
+        if (levels.empty()) { levels = { "level1.txt", "level2.txt", "level3.txt" }; }
+        return Benchmark::RunDeterminism(levels, args.size() > 1 ? std::stoul(args[1]) : 3600);
+    }
+
+    if (!args.empty() && args[0] == "--benchmark")
+    {
+        BenchmarkConfig config;
+        std::vector<std::string> positional;
+        auto split = [](const std::string & list)
+        {
+            std::vector<std::string> items;
+            std::stringstream stream(list);
+            std::string item;
+            while (std::getline(stream, item, ',')) { items.push_back(item); }
+            return items;
+        };
+
+        for (size_t i = 1; i < args.size(); i++)
+        {
+            if (args[i] == "--maps" && i + 1 < args.size())
+            {
+                config.maps = split(args[++i]);
+            }
+            else if (args[i] == "--broadphase" && i + 1 < args.size())
+            {
+                config.broadPhases.clear();
+                for (auto & name : split(args[++i]))
+                {
+                    config.broadPhases.push_back(name == "naive" ? BroadPhase::Naive : BroadPhase::Tree);
+                }
+            }
+            else if (args[i] == "--activity" && i + 1 < args.size())
+            {
+                config.activity.clear();
+                for (auto & name : split(args[++i]))
+                {
+                    config.activity.push_back(name != "off");
+                }
+            }
+            else if (args[i] == "--vision" && i + 1 < args.size())
+            {
+                config.fieldOfView.clear();
+                for (auto & name : split(args[++i]))
+                {
+                    config.fieldOfView.push_back(name != "segment");
+                }
+            }
+            else
+            {
+                positional.push_back(args[i]);
+            }
+        }
+
+        if (positional.size() > 0) { config.csvPath = positional[0]; }
+        if (positional.size() > 1) { config.ticks = std::stoul(positional[1]); }
+        if (positional.size() > 2)
+        {
+            config.sizes.clear();
+            for (size_t i = 2; i < positional.size(); i++) { config.sizes.push_back(std::stoul(positional[i])); }
+        }
+
+        return Benchmark::Run(config);
+    }
+
     GameEngine g("assets.txt");
     g.run();
 }
\ No newline at end of file